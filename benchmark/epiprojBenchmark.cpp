@@ -0,0 +1,262 @@
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "itkMultiThreaderBase.h"
+#include "itkDepthMapArgMax.h"
+#include "itkVolumeToDepthMapFilter.h"
+#include "itkMultiscaleVolumeToDepthMapFilter.h"
+#include "itkDepthMapProjectionFilter.h"
+#include "itkVarianceImageFilter.h"
+#include "epiprojSyntheticVolume.h"
+
+/** Parameters of the benchmark. */
+struct Parameters
+{
+  SyntheticVolumeParameters volume;
+  unsigned int repetitions = 3;
+  std::vector<unsigned int> threads;
+  std::string outputFileName = "";
+};
+
+/** Timing of one benchmark case, in the layout of Google Benchmark JSON reports. */
+struct Result
+{
+  std::string name;
+  unsigned int threads;
+  unsigned int iterations;
+  double meanTime; // ms
+  double minTime;  // ms
+  double voxels;
+};
+
+/** Time the repeated runs of a case, the filter being created, and its input
+ * information updated, by the setup function outside of the timing. */
+Result
+Measure(const std::string &name, unsigned int threads, unsigned int repetitions, double voxels,
+        const std::function<itk::ProcessObject::Pointer()> &setup)
+{
+  Result result = {name, threads, repetitions, 0, 0, voxels};
+  for (unsigned int r = 0; r < repetitions; r++)
+  {
+    itk::ProcessObject::Pointer filter = setup();
+    filter->SetNumberOfWorkUnits(threads);
+    filter->UpdateOutputInformation();
+    const auto start = std::chrono::steady_clock::now();
+    filter->Update();
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    result.meanTime += elapsed.count() / repetitions;
+    result.minTime = r == 0 ? elapsed.count() : std::min(result.minTime, elapsed.count());
+  }
+  std::cerr << name << "/threads:" << threads << "\t" << result.meanTime << " ms\t";
+  std::cerr << voxels / result.meanTime * 1e-3 << " Mvoxels/s" << std::endl;
+  return result;
+}
+
+/** JSON report, one entry per case and thread count. */
+void
+WriteReport(std::ostream &os, const Parameters &parameters, const std::vector<Result> &results)
+{
+  char date[32];
+  const std::time_t now = std::time(nullptr);
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+  os << "{\n";
+  os << "  \"context\": {\n";
+  os << "    \"date\": \"" << date << "\",\n";
+  os << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n";
+  os << "    \"instruction_set\": " << itk::DepthMapArgMax::GetSupportedInstructionSet() << ",\n";
+  os << "    \"volume_size\": [" << parameters.volume.size[0] << ", " << parameters.volume.size[1] << ", "
+     << parameters.volume.size[2] << "],\n";
+  os << "    \"repetitions\": " << parameters.repetitions << "\n";
+  os << "  },\n";
+  os << "  \"benchmarks\": [\n";
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const Result &result = results[i];
+    os << "    {\n";
+    os << "      \"name\": \"" << result.name << "/threads:" << result.threads << "\",\n";
+    os << "      \"run_name\": \"" << result.name << "\",\n";
+    os << "      \"threads\": " << result.threads << ",\n";
+    os << "      \"iterations\": " << result.iterations << ",\n";
+    os << "      \"real_time\": " << result.meanTime << ",\n";
+    os << "      \"min_time\": " << result.minTime << ",\n";
+    os << "      \"time_unit\": \"ms\",\n";
+    os << "      \"items_per_second\": " << result.voxels / result.meanTime * 1e3 << "\n";
+    os << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  os << "  ]\n";
+  os << "}\n";
+}
+
+int Run(const Parameters &parameters)
+{
+  /*
+   *  Define typedef.
+   */
+  const unsigned int Dimension = 3;
+  using InputImageType = itk::Image<unsigned short, Dimension>;
+  using MapImageType = itk::Image<float, Dimension - 1>;
+  using ProjectionImageType = itk::Image<unsigned short, Dimension - 1>;
+  using VarianceImageType = itk::Image<float, Dimension>;
+  using DepthMapFilterType = itk::VolumeToDepthMapFilter<InputImageType, MapImageType>;
+  using MultiscaleFilterType = itk::MultiscaleVolumeToDepthMapFilter<InputImageType, MapImageType>;
+  using ProjectionFilterType = itk::DepthMapProjectionFilter<InputImageType, MapImageType, ProjectionImageType>;
+  using VarianceFilterType = itk::VarianceImageFilter<InputImageType, VarianceImageType>;
+
+  /*
+   *  Synthetic volume, and its surface as initialisation and projection map.
+   */
+  InputImageType::Pointer volume = GenerateSyntheticVolume<InputImageType>(parameters.volume);
+  MapImageType::Pointer surface = GenerateSyntheticSurface<MapImageType>(parameters.volume);
+  const double voxels = volume->GetLargestPossibleRegion().GetNumberOfPixels();
+  const unsigned int repetitions = parameters.repetitions;
+
+  std::vector<Result> results;
+  for (unsigned int threads : parameters.threads)
+  {
+    itk::MultiThreaderBase::SetGlobalDefaultNumberOfThreads(threads);
+
+    // Depth search, for each peak mode, on the whole columns or around the surface.
+    const char *peakNames[3] = {"max", "first", "last"};
+    for (unsigned int peak = 0; peak < 3; peak++)
+    {
+      for (unsigned int initialisation = 0; initialisation < 2; initialisation++)
+      {
+        const std::string name = std::string("VolumeToDepthMap/") + peakNames[peak] + (initialisation ? "/init" : "");
+        results.push_back(Measure(name, threads, repetitions, voxels, [&]() {
+          DepthMapFilterType::Pointer filter = DepthMapFilterType::New();
+          filter->SetInput(volume);
+          filter->SetPeak(peak);
+          filter->SetEngine(1);
+          if (initialisation)
+          {
+            DepthMapFilterType::ArrayType range;
+            range.Fill(5);
+            filter->SetRange(range);
+            filter->SetInitialisation(surface);
+          }
+          return itk::ProcessObject::Pointer(filter);
+        }));
+      }
+    }
+
+    // Multiscale depth search, for each number of levels.
+    for (unsigned int levels = 1; levels <= 5; levels++)
+    {
+      const std::string name = "MultiscaleVolumeToDepthMap/levels:" + std::to_string(levels);
+      results.push_back(Measure(name, threads, repetitions, voxels, [&]() {
+        MultiscaleFilterType::Pointer filter = MultiscaleFilterType::New();
+        filter->SetInput(volume);
+        filter->SetNumberOfLevels(levels);
+        return itk::ProcessObject::Pointer(filter);
+      }));
+    }
+
+    // Block pyramid, level by level or as a tile wavefront.
+    for (unsigned int wavefront = 0; wavefront < 2; wavefront++)
+    {
+      const std::string name = std::string("MultiscaleVolumeToDepthMap/block") + (wavefront ? "/wavefront" : "");
+      results.push_back(Measure(name, threads, repetitions, voxels, [&]() {
+        MultiscaleFilterType::Pointer filter = MultiscaleFilterType::New();
+        filter->SetInput(volume);
+        filter->SetPyramid(1);
+        filter->SetWavefront(wavefront != 0);
+        return itk::ProcessObject::Pointer(filter);
+      }));
+    }
+
+    // Projection of the band around the surface.
+    for (const std::string type : {"max", "avg"})
+    {
+      results.push_back(Measure("DepthMapProjection/" + type, threads, repetitions, voxels, [&]() {
+        ProjectionFilterType::Pointer filter = ProjectionFilterType::New();
+        ProjectionFilterType::ArrayType range;
+        range.Fill(2);
+        filter->SetInput(volume);
+        filter->SetMap(surface);
+        filter->SetType(type);
+        filter->SetRange(range);
+        return itk::ProcessObject::Pointer(filter);
+      }));
+    }
+
+    // Local variance of the volume, as the variance preprocessing of epiproj.
+    results.push_back(Measure("Variance/radius:3", threads, repetitions, voxels, [&]() {
+      VarianceFilterType::Pointer filter = VarianceFilterType::New();
+      VarianceFilterType::InputSizeType radius;
+      radius.Fill(3);
+      radius[Dimension - 1] = 1;
+      filter->SetInput(volume);
+      filter->SetRadius(radius);
+      return itk::ProcessObject::Pointer(filter);
+    }));
+  }
+
+  if (parameters.outputFileName.empty())
+  {
+    WriteReport(std::cout, parameters, results);
+    return EXIT_SUCCESS;
+  }
+  std::ofstream file(parameters.outputFileName);
+  if (!file)
+  {
+    std::cerr << "Error: Can not write " << parameters.outputFileName << std::endl;
+    return EXIT_FAILURE;
+  }
+  WriteReport(file, parameters, results);
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc >= 2 && std::string(argv[1]).compare("-h") == 0)
+  {
+    std::cerr << "Usage: " << argv[0] << std::endl;
+    std::cerr << "\tSizeX (int)       - Size of the synthetic volume along X. (=512)" << std::endl;
+    std::cerr << "\tSizeY (int)       - Size of the synthetic volume along Y. (=512)" << std::endl;
+    std::cerr << "\tSizeZ (int)       - Size of the synthetic volume along Z. (=64)" << std::endl;
+    std::cerr << "\tRepetitions (int) - Number of runs of each case. (=3)" << std::endl;
+    std::cerr << "\tThreads (string)  - Comma separated thread counts. (=1,all)" << std::endl;
+    std::cerr << "\tOutput (string)   - JSON report file, standard output if empty. (=\"\")" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Parameters parameters;
+  for (int i = 1; i <= 3 && i < argc; i++)
+  {
+    parameters.volume.size[i - 1] = std::atoi(argv[i]);
+  }
+  if (argc >= 5)
+  {
+    parameters.repetitions = std::max(std::atoi(argv[4]), 1);
+  }
+  if (argc >= 6)
+  {
+    std::stringstream list(argv[5]);
+    std::string threads;
+    while (std::getline(list, threads, ','))
+    {
+      parameters.threads.push_back(std::max(std::atoi(threads.c_str()), 1));
+    }
+  }
+  else
+  {
+    parameters.threads.push_back(1);
+    parameters.threads.push_back(itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads());
+  }
+  if (argc >= 7)
+  {
+    parameters.outputFileName = argv[6];
+  }
+
+  return Run(parameters);
+}
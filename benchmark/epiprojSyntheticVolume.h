@@ -0,0 +1,100 @@
+#ifndef __epiprojSyntheticVolume_h
+#define __epiprojSyntheticVolume_h
+
+#include <cmath>
+#include <random>
+
+#include "itkImage.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkNumericTraits.h"
+
+/*
+ *  Synthetic epithelium.
+ *  A bright curved sheet, a Gaussian profile along Z centred on a smooth
+ *  surface, over a noisy background, with a dimmer secondary sheet below it
+ *  so that the first and last peak modes differ from the maximum. The volume
+ *  is deterministic for a given seed.
+ */
+
+/** Parameters of the synthetic volume. */
+struct SyntheticVolumeParameters
+{
+  unsigned int size[3] = {512, 512, 64};
+  float thickness = 1.5;     // standard deviation of the sheet profile, in planes
+  float amplitude = 0.25;    // surface amplitude, as a fraction of the depth
+  float periods = 1.5;       // surface undulations across the XY plane
+  float secondary = 0.5;     // intensity of the secondary sheet, relative to the main one
+  float secondaryShift = 8;  // depth of the secondary sheet below the main one, in planes
+  float background = 0.05;   // background level, relative to the main sheet
+  float noise = 0.05;        // standard deviation of the noise, relative to the main sheet
+  unsigned int seed = 42;
+};
+
+/** Depth of the main sheet at (x, y). */
+inline float
+GetSyntheticSurface(const SyntheticVolumeParameters &parameters, float x, float y)
+{
+  const float pi = 3.14159265f;
+  const float u = 2 * pi * parameters.periods * x / parameters.size[0];
+  const float v = 2 * pi * parameters.periods * y / parameters.size[1];
+  const float center = 0.4f * (parameters.size[2] - 1);
+  return center + parameters.amplitude * (parameters.size[2] - 1) * std::sin(u) * std::cos(v);
+}
+
+/** Synthetic volume, of intensities scaled to the pixel type (to 1000 for float). */
+template <class TImage>
+typename TImage::Pointer
+GenerateSyntheticVolume(const SyntheticVolumeParameters &parameters)
+{
+  using PixelType = typename TImage::PixelType;
+  const double peak = itk::NumericTraits<PixelType>::is_integer ? 0.8 * itk::NumericTraits<PixelType>::max() : 1000;
+
+  typename TImage::RegionType region;
+  for (unsigned int i = 0; i < 3; i++)
+    {
+    region.SetSize(i, parameters.size[i]);
+    }
+  typename TImage::Pointer volume = TImage::New();
+  volume->SetRegions(region);
+  volume->Allocate();
+
+  std::mt19937 generator(parameters.seed);
+  std::normal_distribution<double> noise(0, parameters.noise);
+  const double variance = 2 * parameters.thickness * parameters.thickness;
+  itk::ImageRegionIteratorWithIndex<TImage> ite(volume, region);
+  for (; !ite.IsAtEnd(); ++ite)
+    {
+    const typename TImage::IndexType index = ite.GetIndex();
+    const double surface = GetSyntheticSurface(parameters, index[0], index[1]);
+    const double main = index[2] - surface;
+    const double second = main - parameters.secondaryShift;
+    double value = parameters.background + std::exp(-main * main / variance) +
+                   parameters.secondary * std::exp(-second * second / variance) + noise(generator);
+    value = std::min(std::max(value * peak, 0.0), static_cast<double>(itk::NumericTraits<PixelType>::max()));
+    ite.Set(static_cast<PixelType>(value));
+    }
+  return volume;
+}
+
+/** Depth map of the main sheet, of the XY size of the volume. */
+template <class TMap>
+typename TMap::Pointer
+GenerateSyntheticSurface(const SyntheticVolumeParameters &parameters)
+{
+  typename TMap::RegionType region;
+  region.SetSize(0, parameters.size[0]);
+  region.SetSize(1, parameters.size[1]);
+  typename TMap::Pointer map = TMap::New();
+  map->SetRegions(region);
+  map->Allocate();
+
+  itk::ImageRegionIteratorWithIndex<TMap> ite(map, region);
+  for (; !ite.IsAtEnd(); ++ite)
+    {
+    const typename TMap::IndexType index = ite.GetIndex();
+    ite.Set(static_cast<typename TMap::PixelType>(std::round(GetSyntheticSurface(parameters, index[0], index[1]))));
+    }
+  return map;
+}
+
+#endif // __epiprojSyntheticVolume_h
@@ -0,0 +1,369 @@
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "itkImageIOBase.h"
+#include "itkImageFileReader.h"
+
+#include "itkMultiscaleVolumeToDepthMapFilter.h"
+#include "itkDepthMapSmoother.h"
+#include "itkDepthMapProjectionFilter.h"
+#include "itkDepthMapPlaneVariance.h"
+#include "epiprojMappedImage.h"
+#include "epiprojProfile.h"
+#include "epiprojImageWriter.h"
+
+/** Parameters of the depth map and of the projection. */
+struct Parameters
+{
+  std::string inputFileName;
+  std::string outputFileName;
+  float sigma;
+  std::string processing = "max";
+  unsigned int scalingFactor = 5;
+  unsigned int peak = 0;
+  float tolerance = 0.1;
+  unsigned int delta = 1;
+  unsigned int radius = 0;
+  std::string projection = "max";
+  unsigned int upperRange = 1;
+  unsigned int lowerRange = 1;
+  unsigned int shift = 0;
+  std::string depthFileName = "";
+  std::string profileFileName = "";
+  bool adaptiveRange = false;
+  WriterOptions writerOptions;
+};
+
+/** Depth map and projection of a volume of pixel type TPixel, the depth map being
+ * computed on the input itself, or on its local variance computed plane by plane. */
+template <typename TPixel>
+int Run(itk::ImageIOBase::Pointer imageIO, const Parameters &parameters)
+{
+  const std::string &inputFileName = parameters.inputFileName;
+  const std::string &outputFileName = parameters.outputFileName;
+  const float sigma = parameters.sigma;
+  const std::string &processing = parameters.processing;
+  const unsigned int scalingFactor = parameters.scalingFactor;
+  const unsigned int peak = parameters.peak;
+  const float tolerance = parameters.tolerance;
+  const unsigned int delta = parameters.delta;
+  const unsigned int radius = parameters.radius;
+  const std::string &projection = parameters.projection;
+  const unsigned int upperRange = parameters.upperRange;
+  const unsigned int lowerRange = parameters.lowerRange;
+  const unsigned int shift = parameters.shift;
+  const std::string &depthFileName = parameters.depthFileName;
+  Profile profile(parameters.profileFileName);
+
+  /*
+   *  Define typedef.
+   */
+  const unsigned int Dimension = 3;
+  using InputImageType = itk::Image<TPixel, Dimension>;
+  using InternatImageType = itk::Image<float, Dimension - 1>;
+  using DepthMapImageType = itk::Image<unsigned short, Dimension - 1>;
+  using OutputImageType = itk::Image<TPixel, Dimension - 1>;
+  using ImageReaderType = itk::ImageFileReader<InputImageType>;
+  using PlaneVarianceType = itk::DepthMapPlaneVariance<InputImageType>;
+  using DepthMapImageFilterType = itk::MultiscaleVolumeToDepthMapFilter<InputImageType, InternatImageType>;
+  using SmootherType = itk::DepthMapSmoother<InternatImageType, DepthMapImageType>;
+  using DepthMapProjectionFilterType = itk::DepthMapProjectionFilter<InputImageType, DepthMapImageType, OutputImageType>;
+  using ArrayType = typename DepthMapProjectionFilterType::ArrayType;
+
+  /*
+   *  Filters declaration.
+   */
+  typename ImageReaderType::Pointer reader = ImageReaderType::New();
+  typename DepthMapImageFilterType::Pointer depthMapFilter = DepthMapImageFilterType::New();
+  SmootherType::Pointer smoother = SmootherType::New();
+  typename DepthMapProjectionFilterType::Pointer projectionFilter = DepthMapProjectionFilterType::New();
+
+  /*
+   *  Read the volume once, it feeds both the depth map and the projection.
+   *  Uncompressed volumes are mapped rather than read.
+   */
+  Profile::Clock clock = profile.Start();
+  typename InputImageType::Pointer volume = MapImage<InputImageType>(inputFileName, imageIO);
+  const bool mapped = volume.IsNotNull();
+  if (!mapped)
+  {
+    reader->SetFileName(inputFileName);
+    reader->SetImageIO(imageIO);
+    try
+    {
+      reader->Update();
+    }
+    catch (itk::ExceptionObject &excp)
+    {
+      std::cerr << excp << std::endl;
+      return EXIT_FAILURE;
+    }
+    volume = reader->GetOutput();
+  }
+  const size_t volumePixels = volume->GetLargestPossibleRegion().GetNumberOfPixels();
+  profile.Stop(clock, "read", volumePixels, mapped ? 0 : volumePixels * sizeof(TPixel));
+
+  /*
+   *  Depth map pipeline.
+   */
+  depthMapFilter->SetInput(volume);
+  if (processing.compare("var") == 0)
+  {
+    // The local variance is computed plane by plane by the depth search.
+    typename PlaneVarianceType::Pointer planeVariance = PlaneVarianceType::New();
+    typename PlaneVarianceType::SizeType kernel;
+    kernel.Fill(15);
+    kernel[Dimension - 1] = 0;
+    planeVariance->SetRadius(kernel);
+    depthMapFilter->SetPlaneOperator(planeVariance.GetPointer());
+  }
+  depthMapFilter->SetNumberOfLevels(scalingFactor);
+  depthMapFilter->SetSigma(delta);
+  depthMapFilter->SetPeak(peak);
+  depthMapFilter->SetTolerance(tolerance);
+  depthMapFilter->SetAdaptiveRange(parameters.adaptiveRange);
+  depthMapFilter->SetProfiling(profile.IsEnabled());
+
+  // Smoothing in physical units, written as unsigned short in the same pass.
+  smoother->SetVariance(sigma >= 1 ? sigma * sigma : 0);
+  smoother->UseImageSpacingOn();
+
+  // The map is kept in memory as unsigned short, as if written and read back by
+  // epiprojDepthMapGenerator and epiprojDepthMapProjector. The depth search is
+  // updated alone first to be timed apart from the smoothing.
+  DepthMapImageType::Pointer depthMap = DepthMapImageType::New();
+  try
+  {
+    clock = profile.Start();
+    depthMapFilter->Update();
+    const size_t mapPixels = depthMapFilter->GetOutput()->GetLargestPossibleRegion().GetNumberOfPixels();
+    profile.Stop(clock, "depthmap", volumePixels, mapPixels * sizeof(float));
+    profile.AddFilterProfile(depthMapFilter.GetPointer());
+    clock = profile.Start();
+    depthMap->CopyInformation(depthMapFilter->GetOutput());
+    depthMap->SetRegions(depthMapFilter->GetOutput()->GetLargestPossibleRegion());
+    depthMap->Allocate();
+    smoother->Smooth(depthMapFilter->GetOutput(), depthMap);
+    profile.Stop(clock, "smoothing", mapPixels, mapPixels * sizeof(unsigned short) + smoother->GetNumberOfBytes());
+  }
+  catch (itk::ExceptionObject &excp)
+  {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+  }
+  const size_t mapPixels = depthMap->GetLargestPossibleRegion().GetNumberOfPixels();
+
+  if (!depthFileName.empty())
+  {
+    try
+    {
+      clock = profile.Start();
+      WriteDepthMap(depthMap.GetPointer(), depthFileName, volume->GetLargestPossibleRegion().GetSize(Dimension - 1),
+                    parameters.writerOptions);
+      profile.Stop(clock, "write depthmap", mapPixels, 0);
+    }
+    catch (itk::ExceptionObject &excp)
+    {
+      std::cerr << excp << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  /*
+   *  Projection pipeline, the median being only computed for the voxels of the band.
+   */
+  typename InputImageType::SizeType kernel;
+  kernel.Fill(radius);
+  projectionFilter->SetInput(volume);
+  projectionFilter->SetMedianRadius(kernel);
+  projectionFilter->SetMap(depthMap);
+  projectionFilter->SetType(projection);
+  projectionFilter->SetShift(shift);
+  ArrayType rangeArray;
+  rangeArray[0] = upperRange;
+  rangeArray[1] = lowerRange;
+  projectionFilter->SetRange(rangeArray);
+
+  /*
+   *  Update and execute pipeline, the projection being updated alone first to be timed,
+   *  unless it is computed band by band as it is written.
+   */
+  const bool streamed = parameters.writerOptions.streams > 1;
+  try
+  {
+    if (!streamed)
+    {
+      clock = profile.Start();
+      projectionFilter->Update();
+      profile.Stop(clock, "projection", mapPixels * (upperRange + lowerRange + 1), mapPixels * sizeof(TPixel));
+    }
+    clock = profile.Start();
+    WriteImage<TPixel>(projectionFilter->GetOutput(), outputFileName, parameters.writerOptions);
+    profile.Stop(clock, streamed ? "projection and write" : "write", mapPixels, 0);
+  }
+  catch (itk::ExceptionObject &excp)
+  {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!profile.Write())
+  {
+    std::cerr << "Error: Can not write the profile " << parameters.profileFileName << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** That's all folks! **/
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+  /*
+   * Named options, removed from the positional parameters.
+   */
+  std::string profileFileName = "";
+  bool adaptiveRange = false;
+  WriterOptions writerOptions;
+  std::vector<char *> arguments;
+  for (int i = 0; i < argc; i++)
+  {
+    if (std::string(argv[i]).compare("--adaptive-range") == 0)
+    {
+      adaptiveRange = true;
+      continue;
+    }
+    if (std::string(argv[i]).compare("--profile") == 0 && i + 1 < argc)
+    {
+      profileFileName = argv[++i];
+      continue;
+    }
+    const WriterOptionStatus writerOption = ParseWriterOption(argc, argv, i, writerOptions);
+    if (writerOption == WriterOptionStatus::Invalid)
+    {
+      return EXIT_FAILURE;
+    }
+    if (writerOption == WriterOptionStatus::Parsed)
+    {
+      continue;
+    }
+    arguments.push_back(argv[i]);
+  }
+  argc = static_cast<int>(arguments.size());
+  argv = arguments.data();
+
+  if (argc < 4)
+  {
+    std::cerr << "Epiproj - Stephane Rigaud {stephane.rigaud@pasteur.fr}";
+    std::cerr << ", Compiled : " << __DATE__ << " at " << __TIME__ << std::endl;
+    std::cerr << "Usage: " << argv[0] << std::endl;
+    std::cerr << "\tInputFileName  (string) - path to input file." << std::endl;
+    std::cerr << "\tOutputFileName (string) - path to output projection file." << std::endl;
+    std::cerr << "\tSigma (float)           - depth map smoothing parameters." << std::endl;
+    std::cerr << "Options: " << std::endl;
+    std::cerr << "\tType (string)      - Depth map on maximum (max) or variance (var) intensity. (=max)" << std::endl;
+    std::cerr << "\tLevel (int)        - Number of scaling level. (=5)" << std::endl;
+    std::cerr << "\tPeak (int)         - Detecting peak. (=0)" << std::endl;
+    std::cerr << "\tTolerance (float)  - Intensity ratio (=0.1)." << std::endl;
+    std::cerr << "\tDelta (int)        - Degree of freedom per step. (=1)" << std::endl;
+    std::cerr << "\tMedian (int)       - Median radius kernel before projection. (=0)" << std::endl;
+    std::cerr << "\tProjection (string) - Projection type, max, min, sum, avg, std, median or gauss intensity. (=max)" << std::endl;
+    std::cerr << "\tupperRange (int)   - Upper range band. (=1)" << std::endl;
+    std::cerr << "\tlowerRange (int)   - Lower range band. (=1)" << std::endl;
+    std::cerr << "\tshift (int)        - Depth shift. (=0)" << std::endl;
+    std::cerr << "\tDepthFileName (string) - path to depth map side output file. (=none)" << std::endl;
+    std::cerr << "\t--profile (string)  - path to a JSON file timing each stage of the run. (=none)" << std::endl;
+    std::cerr << "\t--adaptive-range    - Search band of each column adapted to the previous level. (=off)" << std::endl;
+    std::cerr << "\t--tile (int)        - TIFF outputs in square tiles of this size, multiple of 16. (=strips)" << std::endl;
+    std::cerr << "\t--compress          - Lossless Deflate compression of the TIFF outputs, across threads. (=off)" << std::endl;
+    std::cerr << "\t--streams (int)     - Number of bands the outputs are computed and written in. (=1)" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /*
+   * Parameters
+   */
+  Parameters parameters;
+  parameters.inputFileName = argv[1];
+  parameters.outputFileName = argv[2];
+  parameters.sigma = std::atoi(argv[3]);
+  parameters.profileFileName = profileFileName;
+  parameters.adaptiveRange = adaptiveRange;
+  parameters.writerOptions = writerOptions;
+
+  /*
+   * Optional parameters
+   */
+  if (argc >= 5)
+  {
+    parameters.processing = argv[4];
+  }
+  if (argc >= 6)
+  {
+    parameters.scalingFactor = std::atoi(argv[5]);
+  }
+  if (argc >= 7)
+  {
+    parameters.peak = std::atoi(argv[6]);
+  }
+  if (argc >= 8)
+  {
+    parameters.tolerance = std::atoi(argv[7]);
+  }
+  if (argc >= 9)
+  {
+    parameters.delta = std::atoi(argv[8]);
+  }
+  if (argc >= 10)
+  {
+    parameters.radius = std::atoi(argv[9]);
+  }
+  if (argc >= 11)
+  {
+    parameters.projection = argv[10];
+  }
+  if (argc >= 12)
+  {
+    parameters.upperRange = std::atoi(argv[11]);
+  }
+  if (argc >= 13)
+  {
+    parameters.lowerRange = std::atoi(argv[12]);
+  }
+  if (argc >= 14)
+  {
+    parameters.shift = std::atoi(argv[13]);
+  }
+  if (argc >= 15)
+  {
+    parameters.depthFileName = argv[14];
+  }
+
+  /*
+   * Input verification.
+   */
+  const unsigned int Dimension = 3;
+  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(parameters.inputFileName.c_str(), itk::ImageIOFactory::ReadMode);
+  imageIO->SetFileName(parameters.inputFileName);
+  imageIO->ReadImageInformation();
+  if (imageIO->GetNumberOfDimensions() != Dimension)
+  {
+    std::cerr << "Error: Expected input should be of dimension " << Dimension;
+    std::cerr << ", instead of dimension " << imageIO->GetNumberOfDimensions() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /*
+   *  Run the pipeline of the input pixel type.
+   */
+  switch (imageIO->GetComponentType())
+  {
+    case itk::ImageIOBase::UCHAR:
+      return Run<unsigned char>(imageIO, parameters);
+    case itk::ImageIOBase::USHORT:
+      return Run<unsigned short>(imageIO, parameters);
+    default:
+      return Run<float>(imageIO, parameters);
+  }
+}
@@ -0,0 +1,356 @@
+
+#include <cstdint>
+#include <exception>
+#include <string>
+
+#include "itkImportImageFilter.h"
+
+#include "itkMultiscaleVolumeToDepthMapFilter.h"
+#include "itkDepthMapSmoother.h"
+#include "itkDepthMapProjectionFilter.h"
+#include "itkDepthMapProjectionReducer.h"
+#include "itkDepthMapPlaneVariance.h"
+#include "epiprojApi.h"
+
+namespace
+{
+
+/** Message of the last error of each thread. */
+thread_local std::string lastError;
+
+/** Error exception, thrown by the checks and returned by the API functions. */
+struct Error
+{
+  epiproj_status status;
+  std::string message;
+};
+
+size_t
+GetPixelSize(epiproj_pixel_type pixelType)
+{
+  switch (pixelType)
+  {
+    case EPIPROJ_UINT8:
+      return sizeof(uint8_t);
+    case EPIPROJ_UINT16:
+      return sizeof(uint16_t);
+    case EPIPROJ_FLOAT32:
+      return sizeof(float);
+  }
+  return 0;
+}
+
+/** Check that a buffer of a given dimension is set, of a known pixel type, and
+ * contiguous, x varying fastest. */
+void
+CheckBuffer(const epiproj_buffer *buffer, unsigned int dimension, const std::string &name)
+{
+  if (buffer == nullptr || buffer->data == nullptr)
+  {
+    throw Error{EPIPROJ_ERROR_ARGUMENT, "No " + name + " buffer."};
+  }
+  const size_t pixelSize = GetPixelSize(buffer->pixel_type);
+  if (pixelSize == 0)
+  {
+    throw Error{EPIPROJ_ERROR_ARGUMENT, "Unknown pixel type of the " + name + " buffer."};
+  }
+  ptrdiff_t stride = static_cast<ptrdiff_t>(pixelSize);
+  for (unsigned int i = 0; i < dimension; i++)
+  {
+    if (buffer->size[i] == 0)
+    {
+      throw Error{EPIPROJ_ERROR_ARGUMENT, "Empty " + name + " buffer."};
+    }
+    if (buffer->stride[i] != 0 && buffer->stride[i] != stride)
+    {
+      throw Error{EPIPROJ_ERROR_LAYOUT, "The " + name + " buffer is not contiguous along dimension "
+                                          + std::to_string(i) + ", expected a stride of "
+                                          + std::to_string(stride) + " bytes."};
+    }
+    stride *= static_cast<ptrdiff_t>(buffer->size[i]);
+  }
+}
+
+/** Image of a buffer, its pixels being those of the caller: neither copied nor
+ * released with the image. */
+template <typename TImage>
+typename TImage::Pointer
+ImportBuffer(const epiproj_buffer *buffer)
+{
+  using PixelType = typename TImage::PixelType;
+  using ImportFilterType = itk::ImportImageFilter<PixelType, TImage::ImageDimension>;
+
+  typename ImportFilterType::SizeType size;
+  typename ImportFilterType::IndexType index;
+  typename ImportFilterType::SpacingType spacing;
+  for (unsigned int i = 0; i < TImage::ImageDimension; i++)
+  {
+    size[i] = buffer->size[i];
+    index[i] = 0;
+    spacing[i] = buffer->spacing[i] > 0 ? buffer->spacing[i] : 1.0;
+  }
+  typename ImportFilterType::RegionType region(index, size);
+
+  typename ImportFilterType::Pointer importFilter = ImportFilterType::New();
+  importFilter->SetRegion(region);
+  importFilter->SetSpacing(spacing);
+  importFilter->SetImportPointer(static_cast<PixelType *>(buffer->data), region.GetNumberOfPixels(), false);
+  importFilter->Update();
+  typename TImage::Pointer image = importFilter->GetOutput();
+  image->DisconnectPipeline();
+  return image;
+}
+
+/** Depth map of a volume of pixel type TPixel into a map of pixel type TMapPixel,
+ * as computed by epiprojDepthMapGenerator. */
+template <typename TPixel, typename TMapPixel>
+void
+ComputeDepthMap(const epiproj_buffer *volume, const epiproj_depthmap_parameters *parameters,
+                epiproj_buffer *depthmap, unsigned int numberOfThreads)
+{
+  const unsigned int Dimension = 3;
+  using InputImageType = itk::Image<TPixel, Dimension>;
+  using InternatImageType = itk::Image<float, Dimension - 1>;
+  using DepthMapImageType = itk::Image<TMapPixel, Dimension - 1>;
+  using PlaneVarianceType = itk::DepthMapPlaneVariance<InputImageType>;
+  using DepthMapImageFilterType = itk::MultiscaleVolumeToDepthMapFilter<InputImageType, InternatImageType>;
+  using SmootherType = itk::DepthMapSmoother<InternatImageType, DepthMapImageType>;
+
+  typename DepthMapImageFilterType::Pointer depthMapFilter = DepthMapImageFilterType::New();
+  depthMapFilter->SetInput(ImportBuffer<InputImageType>(volume));
+  if (parameters->variance)
+  {
+    typename PlaneVarianceType::Pointer planeVariance = PlaneVarianceType::New();
+    typename PlaneVarianceType::SizeType kernel;
+    kernel.Fill(parameters->variance_radius);
+    kernel[Dimension - 1] = 0;
+    planeVariance->SetRadius(kernel);
+    depthMapFilter->SetPlaneOperator(planeVariance.GetPointer());
+  }
+  depthMapFilter->SetNumberOfLevels(parameters->levels);
+  depthMapFilter->SetSigma(parameters->delta);
+  depthMapFilter->SetPeak(parameters->peak);
+  depthMapFilter->SetTolerance(parameters->tolerance);
+  depthMapFilter->SetAdaptiveRange(parameters->adaptive_range != 0);
+
+  // Smoothing in physical units, written directly into the map of the caller.
+  typename SmootherType::Pointer smoother = SmootherType::New();
+  smoother->SetVariance(parameters->sigma >= 1 ? parameters->sigma * parameters->sigma : 0);
+  smoother->UseImageSpacingOn();
+  if (numberOfThreads > 0)
+  {
+    depthMapFilter->SetNumberOfWorkUnits(numberOfThreads);
+    smoother->SetNumberOfWorkUnits(numberOfThreads);
+  }
+
+  depthMapFilter->UpdateLargestPossibleRegion();
+  typename DepthMapImageType::Pointer depthMap = ImportBuffer<DepthMapImageType>(depthmap);
+  smoother->Smooth(depthMapFilter->GetOutput(), depthMap);
+}
+
+/** Projection of a volume of pixel type TPixel along a map of pixel type TMapPixel,
+ * as computed by epiprojDepthMapProjector. */
+template <typename TPixel, typename TMapPixel>
+void
+ComputeProjection(const epiproj_buffer *volume, const epiproj_buffer *depthmap,
+                  const epiproj_projection_parameters *parameters, epiproj_buffer *projection,
+                  unsigned int numberOfThreads)
+{
+  const unsigned int Dimension = 3;
+  using InputImageType = itk::Image<TPixel, Dimension>;
+  using DepthMapImageType = itk::Image<TMapPixel, Dimension - 1>;
+  using OutputImageType = itk::Image<TPixel, Dimension - 1>;
+  using DepthMapProjectionFilterType = itk::DepthMapProjectionFilter<InputImageType, DepthMapImageType, OutputImageType>;
+  using ArrayType = typename DepthMapProjectionFilterType::ArrayType;
+
+  typename DepthMapProjectionFilterType::Pointer projectionFilter = DepthMapProjectionFilterType::New();
+  typename InputImageType::SizeType kernel;
+  kernel.Fill(parameters->median_radius);
+  projectionFilter->SetInput(ImportBuffer<InputImageType>(volume));
+  projectionFilter->SetMap(ImportBuffer<DepthMapImageType>(depthmap));
+  projectionFilter->SetMedianRadius(kernel);
+  projectionFilter->SetType(parameters->type);
+  projectionFilter->SetShift(parameters->shift);
+  ArrayType rangeArray;
+  rangeArray[0] = parameters->upper_range;
+  rangeArray[1] = parameters->lower_range;
+  projectionFilter->SetRange(rangeArray);
+  if (numberOfThreads > 0)
+  {
+    projectionFilter->SetNumberOfWorkUnits(numberOfThreads);
+  }
+
+  // The output holds the pixels of the caller. Its data not being released before
+  // the update, the allocation of the output keeps this container, of the size of
+  // the projection, and the filter writes into it.
+  typename OutputImageType::Pointer output = ImportBuffer<OutputImageType>(projection);
+  projectionFilter->GetOutput()->SetPixelContainer(output->GetPixelContainer());
+  projectionFilter->ReleaseDataBeforeUpdateFlagOff();
+  projectionFilter->UpdateLargestPossibleRegion();
+  if (projectionFilter->GetOutput()->GetBufferPointer() != projection->data)
+  {
+    throw Error{EPIPROJ_ERROR_COMPUTATION, "The projection was not written into the output buffer."};
+  }
+}
+
+template <typename TPixel>
+void
+ComputeDepthMap(const epiproj_buffer *volume, const epiproj_depthmap_parameters *parameters,
+                epiproj_buffer *depthmap, unsigned int numberOfThreads)
+{
+  switch (depthmap->pixel_type)
+  {
+    case EPIPROJ_UINT16:
+      return ComputeDepthMap<TPixel, unsigned short>(volume, parameters, depthmap, numberOfThreads);
+    case EPIPROJ_FLOAT32:
+      return ComputeDepthMap<TPixel, float>(volume, parameters, depthmap, numberOfThreads);
+    default:
+      throw Error{EPIPROJ_ERROR_ARGUMENT, "The depth map pixel type should be EPIPROJ_UINT16 or EPIPROJ_FLOAT32."};
+  }
+}
+
+template <typename TPixel>
+void
+ComputeProjection(const epiproj_buffer *volume, const epiproj_buffer *depthmap,
+                  const epiproj_projection_parameters *parameters, epiproj_buffer *projection,
+                  unsigned int numberOfThreads)
+{
+  switch (depthmap->pixel_type)
+  {
+    case EPIPROJ_UINT16:
+      return ComputeProjection<TPixel, unsigned short>(volume, depthmap, parameters, projection, numberOfThreads);
+    case EPIPROJ_FLOAT32:
+      return ComputeProjection<TPixel, float>(volume, depthmap, parameters, projection, numberOfThreads);
+    default:
+      throw Error{EPIPROJ_ERROR_ARGUMENT, "The depth map pixel type should be EPIPROJ_UINT16 or EPIPROJ_FLOAT32."};
+  }
+}
+
+/** Check that a map has the x and y size of a volume. */
+void
+CheckMapSize(const epiproj_buffer *volume, const epiproj_buffer *map, const std::string &name)
+{
+  if (map->size[0] != volume->size[0] || map->size[1] != volume->size[1])
+  {
+    throw Error{EPIPROJ_ERROR_ARGUMENT, "The " + name + " size should be the x and y size of the volume."};
+  }
+}
+
+/** Run an API function, its errors being kept as the last error of the thread. */
+template <typename TFunction>
+epiproj_status
+Call(const TFunction &function)
+{
+  lastError.clear();
+  try
+  {
+    function();
+    return EPIPROJ_SUCCESS;
+  }
+  catch (const Error &error)
+  {
+    lastError = error.message;
+    return error.status;
+  }
+  catch (itk::ExceptionObject &excp)
+  {
+    lastError = excp.GetDescription();
+  }
+  catch (std::exception &excp)
+  {
+    lastError = excp.what();
+  }
+  catch (...)
+  {
+    lastError = "Unknown error.";
+  }
+  return EPIPROJ_ERROR_COMPUTATION;
+}
+
+} // namespace
+
+void
+epiproj_depthmap_parameters_init(epiproj_depthmap_parameters *parameters)
+{
+  parameters->sigma = 0;
+  parameters->variance = 0;
+  parameters->variance_radius = 15;
+  parameters->levels = 5;
+  parameters->peak = 0;
+  parameters->tolerance = 0.1;
+  parameters->delta = 1;
+  parameters->adaptive_range = 0;
+}
+
+void
+epiproj_projection_parameters_init(epiproj_projection_parameters *parameters)
+{
+  parameters->type = "max";
+  parameters->upper_range = 1;
+  parameters->lower_range = 1;
+  parameters->shift = 0;
+  parameters->median_radius = 0;
+}
+
+epiproj_status
+epiproj_depthmap(const epiproj_buffer *volume, const epiproj_depthmap_parameters *parameters,
+                 epiproj_buffer *depthmap, unsigned int number_of_threads)
+{
+  return Call([&]() -> void {
+    CheckBuffer(volume, 3, "volume");
+    CheckBuffer(depthmap, 2, "depth map");
+    CheckMapSize(volume, depthmap, "depth map");
+    if (parameters == nullptr)
+    {
+      throw Error{EPIPROJ_ERROR_ARGUMENT, "No depth map parameters."};
+    }
+    switch (volume->pixel_type)
+    {
+      case EPIPROJ_UINT8:
+        return ComputeDepthMap<unsigned char>(volume, parameters, depthmap, number_of_threads);
+      case EPIPROJ_UINT16:
+        return ComputeDepthMap<unsigned short>(volume, parameters, depthmap, number_of_threads);
+      case EPIPROJ_FLOAT32:
+        return ComputeDepthMap<float>(volume, parameters, depthmap, number_of_threads);
+    }
+  });
+}
+
+epiproj_status
+epiproj_project(const epiproj_buffer *volume, const epiproj_buffer *depthmap,
+                const epiproj_projection_parameters *parameters, epiproj_buffer *projection,
+                unsigned int number_of_threads)
+{
+  return Call([&]() -> void {
+    CheckBuffer(volume, 3, "volume");
+    CheckBuffer(depthmap, 2, "depth map");
+    CheckBuffer(projection, 2, "projection");
+    CheckMapSize(volume, depthmap, "depth map");
+    CheckMapSize(volume, projection, "projection");
+    if (projection->pixel_type != volume->pixel_type)
+    {
+      throw Error{EPIPROJ_ERROR_ARGUMENT, "The projection pixel type should be the volume pixel type."};
+    }
+    itk::DepthMapProjectionReducer::ReducerType reducer;
+    if (parameters == nullptr || parameters->type == nullptr
+        || !itk::DepthMapProjectionReducer::GetReducerType(parameters->type, reducer))
+    {
+      throw Error{EPIPROJ_ERROR_ARGUMENT, "Invalid projection type, expected max, min, sum, avg, std, median or gauss."};
+    }
+    switch (volume->pixel_type)
+    {
+      case EPIPROJ_UINT8:
+        return ComputeProjection<unsigned char>(volume, depthmap, parameters, projection, number_of_threads);
+      case EPIPROJ_UINT16:
+        return ComputeProjection<unsigned short>(volume, depthmap, parameters, projection, number_of_threads);
+      case EPIPROJ_FLOAT32:
+        return ComputeProjection<float>(volume, depthmap, parameters, projection, number_of_threads);
+    }
+  });
+}
+
+const char *
+epiproj_last_error(void)
+{
+  return lastError.c_str();
+}
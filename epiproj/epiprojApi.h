@@ -0,0 +1,118 @@
+#ifndef __epiprojApi_h
+#define __epiprojApi_h
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#if defined(EPIPROJ_API_EXPORTS)
+#define EPIPROJ_API __declspec(dllexport)
+#else
+#define EPIPROJ_API __declspec(dllimport)
+#endif
+#else
+#define EPIPROJ_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  Epiproj C API.
+ *  Depth map and projection of a volume held in memory by the caller, written
+ *  into buffers of the caller. The buffers are wrapped as ITK images, neither
+ *  copied nor written to disk, and are only accessed during the call. The
+ *  functions can be called concurrently from several threads, each call using
+ *  its own filters.
+ */
+
+/** Status returned by the functions, the message of the last error of the
+ * calling thread being given by epiproj_last_error(). */
+typedef enum epiproj_status
+{
+  EPIPROJ_SUCCESS = 0,
+  EPIPROJ_ERROR_ARGUMENT = 1,
+  EPIPROJ_ERROR_LAYOUT = 2,
+  EPIPROJ_ERROR_COMPUTATION = 3
+} epiproj_status;
+
+/** Pixel type of a buffer. */
+typedef enum epiproj_pixel_type
+{
+  EPIPROJ_UINT8 = 0,
+  EPIPROJ_UINT16 = 1,
+  EPIPROJ_FLOAT32 = 2
+} epiproj_pixel_type;
+
+/** Buffer of a volume (3 dimensions) or of an image (2 dimensions, the third
+ * being ignored), x varying fastest. The strides are the number of bytes
+ * between two neighbours along x, y and z, 0 standing for the contiguous
+ * stride. Only contiguous buffers can be wrapped without a copy, so any
+ * other stride is rejected with EPIPROJ_ERROR_LAYOUT. The spacing is the
+ * physical size of the pixels, the depth map smoothing being in physical
+ * units. */
+typedef struct epiproj_buffer
+{
+  void *data;
+  epiproj_pixel_type pixel_type;
+  size_t size[3];
+  ptrdiff_t stride[3];
+  double spacing[3];
+} epiproj_buffer;
+
+/** Parameters of the depth map, as the options of epiprojDepthMapGenerator. */
+typedef struct epiproj_depthmap_parameters
+{
+  float sigma;                  /* depth map smoothing, none below 1 (=0) */
+  int variance;                 /* depth of the local variance rather than of the intensity (=0) */
+  unsigned int variance_radius; /* radius of the local variance (=15) */
+  unsigned int levels;          /* number of scaling levels (=5) */
+  unsigned int peak;            /* detecting peak (=0) */
+  float tolerance;              /* intensity ratio (=0.1) */
+  unsigned int delta;           /* degree of freedom per step (=1) */
+  int adaptive_range;           /* search band of each column adapted to the previous level (=0) */
+} epiproj_depthmap_parameters;
+
+/** Parameters of the projection, as the options of epiprojDepthMapProjector. */
+typedef struct epiproj_projection_parameters
+{
+  const char *type;           /* max, min, sum, avg, std, median or gauss (=max) */
+  unsigned int upper_range;   /* upper range band (=1) */
+  unsigned int lower_range;   /* lower range band (=1) */
+  int shift;                  /* depth shift (=0) */
+  unsigned int median_radius; /* median radius kernel before projection (=0) */
+} epiproj_projection_parameters;
+
+/** Default parameters. */
+EPIPROJ_API void
+epiproj_depthmap_parameters_init(epiproj_depthmap_parameters *parameters);
+EPIPROJ_API void
+epiproj_projection_parameters_init(epiproj_projection_parameters *parameters);
+
+/** Depth map of a volume, written into a map of its x and y size, of pixel
+ * type EPIPROJ_UINT16 or EPIPROJ_FLOAT32. The computation runs on the given
+ * number of threads, 0 for the default of ITK. */
+EPIPROJ_API epiproj_status
+epiproj_depthmap(const epiproj_buffer *volume,
+                 const epiproj_depthmap_parameters *parameters,
+                 epiproj_buffer *depthmap,
+                 unsigned int number_of_threads);
+
+/** Projection of a volume along its depth map, written into an image of the
+ * map size and of the volume pixel type. */
+EPIPROJ_API epiproj_status
+epiproj_project(const epiproj_buffer *volume,
+                const epiproj_buffer *depthmap,
+                const epiproj_projection_parameters *parameters,
+                epiproj_buffer *projection,
+                unsigned int number_of_threads);
+
+/** Message of the last error of the calling thread, empty if none. */
+EPIPROJ_API const char *
+epiproj_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __epiprojApi_h */
@@ -0,0 +1,127 @@
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "itkImageFileReader.h"
+#include "epiprojApi.h"
+
+/** Image of a file. */
+template <typename TImage>
+typename TImage::Pointer
+Read(const char *fileName)
+{
+  typename itk::ImageFileReader<TImage>::Pointer reader = itk::ImageFileReader<TImage>::New();
+  reader->SetFileName(fileName);
+  reader->Update();
+  return reader->GetOutput();
+}
+
+/*
+ *  Depth map and projection of an 8 bits volume through the C API, compared
+ *  with the ones of epiproj with the parameters of compute_depthmap_and_projection.
+ */
+int main(int argc, char **argv)
+{
+  if (argc < 4)
+  {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " InputFileName DepthMapFileName ProjectionFileName [Threads]" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const unsigned int numberOfThreads = argc >= 5 ? std::atoi(argv[4]) : 0;
+
+  using InputImageType = itk::Image<unsigned char, 3>;
+  using DepthMapImageType = itk::Image<unsigned short, 2>;
+  using OutputImageType = itk::Image<unsigned char, 2>;
+  InputImageType::Pointer volume;
+  DepthMapImageType::Pointer expectedDepthMap;
+  OutputImageType::Pointer expectedProjection;
+  try
+  {
+    volume = Read<InputImageType>(argv[1]);
+    expectedDepthMap = Read<DepthMapImageType>(argv[2]);
+    expectedProjection = Read<OutputImageType>(argv[3]);
+  }
+  catch (itk::ExceptionObject &excp)
+  {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /*
+   *  Buffers of the caller.
+   */
+  const InputImageType::SizeType size = volume->GetLargestPossibleRegion().GetSize();
+  epiproj_buffer volumeBuffer = {};
+  volumeBuffer.data = volume->GetBufferPointer();
+  volumeBuffer.pixel_type = EPIPROJ_UINT8;
+  for (unsigned int i = 0; i < 3; i++)
+  {
+    volumeBuffer.size[i] = size[i];
+    volumeBuffer.spacing[i] = volume->GetSpacing()[i];
+  }
+  volumeBuffer.stride[0] = sizeof(unsigned char);
+  volumeBuffer.stride[1] = volumeBuffer.stride[0] * size[0];
+  volumeBuffer.stride[2] = volumeBuffer.stride[1] * size[1];
+
+  std::vector<unsigned short> depthMapPixels(size[0] * size[1]);
+  epiproj_buffer depthMapBuffer = {};
+  depthMapBuffer.data = depthMapPixels.data();
+  depthMapBuffer.pixel_type = EPIPROJ_UINT16;
+  depthMapBuffer.size[0] = size[0];
+  depthMapBuffer.size[1] = size[1];
+  depthMapBuffer.spacing[0] = volumeBuffer.spacing[0];
+  depthMapBuffer.spacing[1] = volumeBuffer.spacing[1];
+
+  std::vector<unsigned char> projectionPixels(size[0] * size[1]);
+  epiproj_buffer projectionBuffer = depthMapBuffer;
+  projectionBuffer.data = projectionPixels.data();
+  projectionBuffer.pixel_type = EPIPROJ_UINT8;
+
+  /*
+   *  Parameters of compute_depthmap_and_projection.
+   */
+  epiproj_depthmap_parameters depthMapParameters;
+  epiproj_depthmap_parameters_init(&depthMapParameters);
+  depthMapParameters.sigma = 6;
+  depthMapParameters.variance = 1;
+  depthMapParameters.tolerance = 0;
+  epiproj_projection_parameters projectionParameters;
+  epiproj_projection_parameters_init(&projectionParameters);
+  projectionParameters.median_radius = 1;
+
+  if (epiproj_depthmap(&volumeBuffer, &depthMapParameters, &depthMapBuffer, numberOfThreads) != EPIPROJ_SUCCESS
+      || epiproj_project(&volumeBuffer, &depthMapBuffer, &projectionParameters, &projectionBuffer, numberOfThreads)
+           != EPIPROJ_SUCCESS)
+  {
+    std::cerr << "Error: " << epiproj_last_error() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /*
+   *  Same pixels as epiproj.
+   */
+  unsigned long mismatch = 0;
+  const unsigned short *expectedDepth = expectedDepthMap->GetBufferPointer();
+  const unsigned char *expectedValue = expectedProjection->GetBufferPointer();
+  for (size_t i = 0; i < depthMapPixels.size(); i++)
+  {
+    mismatch += depthMapPixels[i] != expectedDepth[i] ? 1 : 0;
+    mismatch += projectionPixels[i] != expectedValue[i] ? 1 : 0;
+  }
+  std::cout << "Mismatching pixels: " << mismatch << std::endl;
+
+  /*
+   *  Strided buffers are not copied, but rejected.
+   */
+  epiproj_buffer stridedBuffer = volumeBuffer;
+  stridedBuffer.size[0] = size[0] / 2;
+  stridedBuffer.stride[0] = 2 * sizeof(unsigned char);
+  depthMapBuffer.size[0] = stridedBuffer.size[0];
+  const epiproj_status status = epiproj_depthmap(&stridedBuffer, &depthMapParameters, &depthMapBuffer, numberOfThreads);
+  std::cout << "Strided volume: " << epiproj_last_error() << std::endl;
+
+  return mismatch == 0 && status == EPIPROJ_ERROR_LAYOUT ? EXIT_SUCCESS : EXIT_FAILURE;
+}
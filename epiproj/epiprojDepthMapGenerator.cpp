@@ -1,169 +1,753 @@
 
+#include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <iterator>
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <vector>
 
 #include "itkImageIOBase.h"
 #include "itkImageFileReader.h"
-#include "itkImageFileWriter.h"
 
-#include "itkSmoothingRecursiveGaussianImageFilter.h"
+#include "itkRegionOfInterestImageFilter.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIterator.h"
 #include "itkMultiscaleVolumeToDepthMapFilter.h"
-#include "itkVarianceImageFilter.h"
+#include "itkDepthMapPlaneVariance.h"
+#include "itkDepthMapSmoother.h"
+#include "itkDepthMapTaskGraph.h"
+#include "epiprojMappedImage.h"
+#include "epiprojProfile.h"
+#include "epiprojImageWriter.h"
 
-int main(int argc, char **argv)
+/** Parameters of the depth map generation. */
+struct Parameters
 {
+  std::string inputFileName;
+  std::string outputFileName;
+  float sigma;
+  std::string processing = "max";
+  unsigned int scalingFactor = 5;
+  unsigned int peak = 0;
+  float tolerance = 0.1;
+  unsigned int delta = 1;
+  size_t memory = 0;
+  std::string warmStartFileName = "";
+  std::string profileFileName = "";
+  bool adaptiveRange = false;
+  std::string sweep = "";
+  WriterOptions writerOptions;
+};
 
-  if (argc < 4)
+/** One configuration of a parameter sweep, its output and its wall time in seconds. */
+struct SweepConfiguration
+{
+  Parameters parameters;
+  double wallTime = 0;
+};
+
+/** Configurations of the grid "name=v1,v2;name=v1" over the sigma, level, peak,
+ * tolerance and delta parameters, the others keeping their value. Each output
+ * file name gets the swept values before its extension. */
+bool ParseSweep(const Parameters &parameters, std::vector<SweepConfiguration> &configurations)
+{
+  const char *names[] = {"sigma", "level", "peak", "tolerance", "delta"};
+  std::map<std::string, std::vector<std::string>> grid;
+  std::stringstream specification(parameters.sweep);
+  std::string entry;
+  while (std::getline(specification, entry, ';'))
+  {
+    const size_t equal = entry.find('=');
+    const std::string name = entry.substr(0, equal);
+    if (equal == std::string::npos || std::find(std::begin(names), std::end(names), name) == std::end(names))
+    {
+      std::cerr << "Error: Unknown sweep parameter " << entry << std::endl;
+      return false;
+    }
+    std::stringstream values(entry.substr(equal + 1));
+    std::string value;
+    while (std::getline(values, value, ','))
+    {
+      grid[name].push_back(value);
+    }
+  }
+
+  const std::string &outputFileName = parameters.outputFileName;
+  size_t extension = outputFileName.find_last_of('.');
+  if (extension == std::string::npos || extension < outputFileName.find_last_of("/\\") + 1)
+  {
+    extension = outputFileName.size();
+  }
+  configurations.assign(1, SweepConfiguration());
+  configurations[0].parameters = parameters;
+  configurations[0].parameters.outputFileName = outputFileName.substr(0, extension);
+  for (const char *name : names)
+  {
+    if (grid[name].empty())
+    {
+      continue;
+    }
+    std::vector<SweepConfiguration> product;
+    for (const SweepConfiguration &configuration : configurations)
+    {
+      for (const std::string &value : grid[name])
+      {
+        SweepConfiguration next = configuration;
+        Parameters &p = next.parameters;
+        const std::string key(name);
+        if (key == "sigma")
+        {
+          p.sigma = std::atof(value.c_str());
+        }
+        else if (key == "level")
+        {
+          p.scalingFactor = std::atoi(value.c_str());
+        }
+        else if (key == "peak")
+        {
+          p.peak = std::atoi(value.c_str());
+        }
+        else if (key == "tolerance")
+        {
+          p.tolerance = std::atof(value.c_str());
+        }
+        else
+        {
+          p.delta = std::atoi(value.c_str());
+        }
+        p.outputFileName += "_" + key + value;
+        product.push_back(next);
+      }
+    }
+    configurations = product;
+  }
+  for (SweepConfiguration &configuration : configurations)
+  {
+    configuration.parameters.outputFileName += outputFileName.substr(extension);
+  }
+  return true;
+}
+
+/*
+ *  Parameter sweep.
+ *  The volume is read once and the configurations are run concurrently, as tasks
+ *  of a work stealing pool. The pyramid of the first configuration of each number
+ *  of levels is kept, and given to the other configurations of the same number of
+ *  levels, which start once it is built. The depth map of each configuration is
+ *  written, and the run time of each configuration in a CSV file.
+ */
+template <typename TPixel>
+int Sweep(itk::ImageIOBase::Pointer imageIO, const Parameters &parameters)
+{
+  const unsigned int Dimension = 3;
+  using InputImageType = itk::Image<TPixel, Dimension>;
+  using InternatImageType = itk::Image<float, Dimension - 1>;
+  using OutputImageType = itk::Image<unsigned short, Dimension - 1>;
+  using ImageReaderType = itk::ImageFileReader<InputImageType>;
+  using PlaneVarianceType = itk::DepthMapPlaneVariance<InputImageType>;
+  using DepthMapImageFilterType = itk::MultiscaleVolumeToDepthMapFilter<InputImageType, InternatImageType>;
+  using SmootherType = itk::DepthMapSmoother<InternatImageType, OutputImageType>;
+  using PyramidLevelsType = typename DepthMapImageFilterType::PyramidLevelsType;
+  using TaskIdType = itk::DepthMapTaskGraph::TaskIdType;
+  const unsigned int varianceRadius = 15;
+
+  std::vector<SweepConfiguration> configurations;
+  if (!ParseSweep(parameters, configurations))
   {
-    std::cerr << "Epiproj - Stephane Rigaud {stephane.rigaud@pasteur.fr}";
-    std::cerr << ", Compiled : " << __DATE__ << " at " << __TIME__ << std::endl;
-    std::cerr << "Usage: " << argv[0] << std::endl;
-    std::cerr << "\tInputFileName  (string) - path to input file." << std::endl;
-    std::cerr << "\tOutputFileName (string) - path to output file." << std::endl;
-    std::cerr << "\tSigma (float)           - smoothing parameters." << std::endl;
-    std::cerr << "Options: " << std::endl;
-    std::cerr << "\tType (string)     - Computation on maximum (max) or variance (var) intensity." << std::endl;
-    std::cerr << "\tLevel (int)       - Number of scaling level. (=5)" << std::endl;
-    std::cerr << "\tPeak (int)        - Detecting peak. (=0)" << std::endl;
-    std::cerr << "\tTolerance (float) - Intensity ratio (=0.1)." << std::endl;
-    std::cerr << "\tDelta (int)       - Degree of freedom per step. (=1)" << std::endl;
     return EXIT_FAILURE;
   }
+  if (parameters.memory > 0 || !parameters.warmStartFileName.empty())
+  {
+    std::cerr << "Error: A sweep reads the whole volume, without Memory nor WarmStart." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (!parameters.profileFileName.empty())
+  {
+    std::cerr << "Warning: --profile is not used by a sweep." << std::endl;
+  }
 
-  /*
-   * Parameters  
-   */
-  std::string inputFileName = argv[1];
-  std::string outputFileName = argv[2];
-  float sigma = std::atoi(argv[3]);
-  
-  /*
-   * Optional parameters
-   */
-  std::string processing = "max";
-  if (argc >= 5)
+  // Read the volume once, uncompressed volumes being mapped.
+  typename InputImageType::Pointer input = MapImage<InputImageType>(parameters.inputFileName, imageIO);
+  if (input.IsNull())
   {
-    processing = argv[4];
+    typename ImageReaderType::Pointer reader = ImageReaderType::New();
+    reader->SetFileName(parameters.inputFileName);
+    reader->SetImageIO(imageIO);
+    try
+    {
+      reader->Update();
+    }
+    catch (itk::ExceptionObject &excp)
+    {
+      std::cerr << excp << std::endl;
+      return EXIT_FAILURE;
+    }
+    input = reader->GetOutput();
+    input->DisconnectPipeline();
   }
-  unsigned int scalingFactor = 5;
-  if (argc >= 6)
+
+  // The plane operator is only read by the filters.
+  typename PlaneVarianceType::Pointer planeVariance = nullptr;
+  if (parameters.processing.compare("var") == 0)
   {
-    scalingFactor = std::atoi(argv[5]);
+    typename PlaneVarianceType::SizeType kernel;
+    kernel.Fill(varianceRadius);
+    kernel[Dimension - 1] = 0;
+    planeVariance = PlaneVarianceType::New();
+    planeVariance->SetRadius(kernel);
   }
-  unsigned int peak = 0;
-  if (argc >= 7)
+
+  // The configurations share the threads, each one running its filters on its part.
+  const unsigned int numberOfThreads = itk::MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
+  const unsigned int numberOfTasks = std::max(std::min<unsigned int>(numberOfThreads, configurations.size()), 1u);
+  const unsigned int numberOfWorkUnits = std::max(numberOfThreads / numberOfTasks, 1u);
+
+  // The first configuration of each number of levels keeps its pyramid for the
+  // other ones, which wait for it.
+  std::map<unsigned int, size_t> firstConfiguration;
+  std::map<unsigned int, PyramidLevelsType> pyramids;
+  std::map<unsigned int, size_t> numberOfSharing;
+  for (size_t c = 0; c < configurations.size(); c++)
   {
-    peak = std::atoi(argv[6]);
+    const unsigned int levels = configurations[c].parameters.scalingFactor;
+    if (firstConfiguration.count(levels) == 0)
+    {
+      firstConfiguration[levels] = c;
+      pyramids[levels] = PyramidLevelsType();
+    }
+    numberOfSharing[levels]++;
   }
-  float tolerance = 0.1;
-  if (argc >= 8)
+
+  auto RunConfiguration = [&](size_t c) {
+    SweepConfiguration &configuration = configurations[c];
+    const Parameters &p = configuration.parameters;
+    const bool first = firstConfiguration.at(p.scalingFactor) == c;
+
+    typename InputImageType::Pointer volume = InputImageType::New();
+    volume->Graft(input);
+    typename DepthMapImageFilterType::Pointer depthMapFilter = DepthMapImageFilterType::New();
+    depthMapFilter->SetInput(volume);
+    depthMapFilter->SetPlaneOperator(planeVariance.GetPointer());
+    depthMapFilter->SetNumberOfLevels(p.scalingFactor);
+    depthMapFilter->SetSigma(p.delta);
+    depthMapFilter->SetPeak(p.peak);
+    depthMapFilter->SetTolerance(p.tolerance);
+    depthMapFilter->SetAdaptiveRange(p.adaptiveRange);
+    depthMapFilter->SetNumberOfWorkUnits(numberOfWorkUnits);
+    if (!first)
+    {
+      depthMapFilter->SetPyramidLevels(pyramids.at(p.scalingFactor));
+    }
+    else if (numberOfSharing.at(p.scalingFactor) > 1)
+    {
+      depthMapFilter->SetKeepPyramidLevels(true);
+    }
+    depthMapFilter->UpdateLargestPossibleRegion();
+    if (depthMapFilter->GetKeepPyramidLevels())
+    {
+      pyramids.at(p.scalingFactor) = depthMapFilter->GetPyramidLevels();
+    }
+
+    typename SmootherType::Pointer smoother = SmootherType::New();
+    smoother->SetVariance(p.sigma >= 1 ? p.sigma * p.sigma : 0);
+    smoother->UseImageSpacingOn();
+    smoother->SetNumberOfWorkUnits(numberOfWorkUnits);
+    OutputImageType::Pointer outputMap = OutputImageType::New();
+    outputMap->CopyInformation(depthMapFilter->GetOutput());
+    outputMap->SetRegions(depthMapFilter->GetOutput()->GetLargestPossibleRegion());
+    outputMap->Allocate();
+    smoother->Smooth(depthMapFilter->GetOutput(), outputMap);
+
+    WriteDepthMap(outputMap.GetPointer(), p.outputFileName, input->GetLargestPossibleRegion().GetSize(Dimension - 1),
+                  parameters.writerOptions);
+  };
+
+  itk::DepthMapTaskGraph graph;
+  std::vector<TaskIdType> tasks;
+  for (size_t c = 0; c < configurations.size(); c++)
   {
-    tolerance = std::atoi(argv[7]);
+    tasks.push_back(graph.AddTask([&RunConfiguration, c]() { RunConfiguration(c); }));
   }
-  unsigned int delta = 1;
-  if (argc >= 9)
+  for (size_t c = 0; c < configurations.size(); c++)
   {
-    delta = std::atoi(argv[8]);
+    const size_t first = firstConfiguration[configurations[c].parameters.scalingFactor];
+    if (first != c)
+    {
+      graph.AddDependency(tasks[c], tasks[first]);
+    }
+  }
+  std::cout << "Sweeping " << configurations.size() << " configurations, " << numberOfTasks << " at a time." << std::endl;
+  try
+  {
+    graph.Run(numberOfTasks);
+  }
+  catch (itk::ExceptionObject &excp)
+  {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
   }
 
+  // Wall time of each configuration, in OutputFileName_sweep.csv. The CPU time
+  // is not given, the process clock counting the concurrent configurations and
+  // the filters running on the threads of the shared pool.
+  std::ofstream timing(parameters.outputFileName + "_sweep.csv");
+  timing << "sigma,level,peak,tolerance,delta,wall_time,output" << std::endl;
+  for (size_t c = 0; c < configurations.size(); c++)
+  {
+    SweepConfiguration &configuration = configurations[c];
+    const Parameters &p = configuration.parameters;
+    configuration.wallTime = graph.GetStopTime(tasks[c]) - graph.GetStartTime(tasks[c]);
+    timing << p.sigma << "," << p.scalingFactor << "," << p.peak << "," << p.tolerance << "," << p.delta << ","
+           << configuration.wallTime << "," << p.outputFileName << std::endl;
+    std::cout << p.outputFileName << ": " << configuration.wallTime << " s" << std::endl;
+  }
+  if (!timing)
+  {
+    std::cerr << "Error: Can not write the sweep timing." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
+
+/** Depth map of a volume of pixel type TPixel, computed on the input itself, or on
+ * its local variance computed plane by plane during the depth search. */
+template <typename TPixel>
+int Generate(itk::ImageIOBase::Pointer imageIO, const Parameters &parameters)
+{
+  if (!parameters.sweep.empty())
+  {
+    return Sweep<TPixel>(imageIO, parameters);
+  }
+
+  const std::string &inputFileName = parameters.inputFileName;
+  const std::string &outputFileName = parameters.outputFileName;
+  const float sigma = parameters.sigma;
+  const std::string &processing = parameters.processing;
+  const unsigned int scalingFactor = parameters.scalingFactor;
+  const unsigned int peak = parameters.peak;
+  const float tolerance = parameters.tolerance;
+  const unsigned int delta = parameters.delta;
+  const size_t memory = parameters.memory;
+  const std::string &warmStartFileName = parameters.warmStartFileName;
+  Profile profile(parameters.profileFileName);
+
   /*
    *  Define typedef.
    */
   const unsigned int Dimension = 3;
-  using InputImageType = itk::Image<float, Dimension>;
+  using InputImageType = itk::Image<TPixel, Dimension>;
   using InternatImageType = itk::Image<float, Dimension - 1>;
   using OutputImageType = itk::Image<unsigned short, Dimension - 1>;
   using ImageReaderType = itk::ImageFileReader<InputImageType>;
-  using ImageWriterType = itk::ImageFileWriter<OutputImageType>;
-  using VarianceImageFilterType = itk::VarianceImageFilter<InputImageType, InputImageType>;
+  using PlaneVarianceType = itk::DepthMapPlaneVariance<InputImageType>;
   using DepthMapImageFilterType = itk::MultiscaleVolumeToDepthMapFilter<InputImageType, InternatImageType>;
-  using GaussianFilterType = itk::SmoothingRecursiveGaussianImageFilter<InternatImageType, InternatImageType>;
-  using CastImageFilterType = itk::CastImageFilter<InternatImageType, OutputImageType>;
-
-  /*
-   * Input verification.  
-   */
-  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(inputFileName.c_str(), itk::ImageIOFactory::ReadMode);
-  imageIO->SetFileName(inputFileName);
-  imageIO->ReadImageInformation();
-  if (imageIO->GetNumberOfDimensions() != 3)
-  {
-    std::cerr << "Error: Expected input should be of dimension " << Dimension;
-    std::cerr << ", instead of dimension " << imageIO->GetNumberOfDimensions() << std::endl;
-    return EXIT_FAILURE;
-  }
+  using RegionOfInterestFilterType = itk::RegionOfInterestImageFilter<InputImageType, InputImageType>;
+  using DepthMapReaderType = itk::ImageFileReader<InternatImageType>;
+  using MapRegionOfInterestFilterType = itk::RegionOfInterestImageFilter<InternatImageType, InternatImageType>;
+  using SmootherType = itk::DepthMapSmoother<InternatImageType, OutputImageType>;
 
   /*
    *  Filters declaration.
    */
-  ImageReaderType::Pointer reader = ImageReaderType::New();
-  DepthMapImageFilterType::Pointer depthMapFilter = DepthMapImageFilterType::New();
-  GaussianFilterType::Pointer gaussianFilter = GaussianFilterType::New();
-  CastImageFilterType::Pointer castFilter = CastImageFilterType::New();
-  ImageWriterType::Pointer writer = ImageWriterType::New();
+  typename ImageReaderType::Pointer reader = ImageReaderType::New();
+  typename DepthMapImageFilterType::Pointer depthMapFilter = DepthMapImageFilterType::New();
+  SmootherType::Pointer smoother = SmootherType::New();
 
   /*
-   *  Define pipeline.
+   *  Define streaming tiles.
+   *  The volume is processed by XY tiles covering the full Z when it does not fit
+   *  in the memory budget. Each tile is extended by a halo covering the variance
+   *  kernel and the smoothing of every pyramid level, and only its core is kept.
    */
+  const unsigned int varianceRadius = 15;
   reader->SetFileName(inputFileName);
   reader->SetImageIO(imageIO);
-  if (processing.compare("var") == 0)
+  try
   {
-    VarianceImageFilterType::InputSizeType kernel;
-    kernel.Fill(15);
-    kernel[Dimension - 1] = 0;
-    VarianceImageFilterType::Pointer varianceFilter = VarianceImageFilterType::New();
-    varianceFilter->SetInput(reader->GetOutput());
-    varianceFilter->SetRadius(kernel);
-    try
+    reader->UpdateOutputInformation();
+  }
+  catch (itk::ExceptionObject &excp)
+  {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Uncompressed volumes are mapped rather than read.
+  Profile::Clock clock = profile.Start();
+  typename InputImageType::Pointer input = MapImage<InputImageType>(inputFileName, imageIO);
+  const bool mapped = input.IsNotNull();
+  if (!mapped)
+  {
+    input = reader->GetOutput();
+  }
+  const typename InputImageType::RegionType largestRegion = input->GetLargestPossibleRegion();
+  // Input and pyramid buffers of a tile, in bytes per voxel, the local variance
+  // not being allocated.
+  const size_t bytesPerVoxel = 4 * sizeof(TPixel);
+  const size_t memoryBytes = memory * 1024 * 1024;
+  const bool overBudget = memory > 0 && largestRegion.GetNumberOfPixels() * bytesPerVoxel > memoryBytes;
+  // Files that can not be read by region are read whole once, in a single pass.
+  const bool streaming = overBudget && (mapped || imageIO->CanStreamRead());
+  if (overBudget && !streaming)
+  {
+    std::cerr << "Warning: " << inputFileName << " can not be read by region, ";
+    std::cerr << "it is processed in a single pass over the memory budget." << std::endl;
+  }
+  std::vector<typename InputImageType::RegionType> tiles(1, largestRegion);
+  std::vector<typename InputImageType::RegionType> cores(1, largestRegion);
+  if (streaming)
+  {
+    // Tiles are aligned on the coarsest level of the pyramid so that its blocks are
+    // the ones of the whole volume.
+    const unsigned int alignment = 1 << (scalingFactor - 1);
+    const unsigned int kernelRadius = static_cast<unsigned int>(std::ceil(3 * std::sqrt(static_cast<float>(delta)))) + 1;
+    unsigned int halo = (processing.compare("var") == 0) ? varianceRadius : 0;
+    for (unsigned int level = 0; level < scalingFactor; level++)
     {
-      varianceFilter->Update();
+      halo += (1 << level) * kernelRadius;
     }
-    catch (itk::ExceptionObject &excp)
+    halo = (halo + alignment - 1) / alignment * alignment;
+
+    const size_t depth = largestRegion.GetSize(Dimension - 1);
+    const long side = static_cast<long>(std::sqrt(static_cast<double>(memoryBytes) / (depth * bytesPerVoxel)));
+    const long tileSize = (side - 2 * static_cast<long>(halo)) / alignment * alignment;
+    if (tileSize <= 0)
     {
-      std::cerr << excp << std::endl;
+      std::cerr << "Error: Memory budget of " << memory << " MB is too small for a tile halo of " << halo;
+      std::cerr << " pixels over " << depth << " planes." << std::endl;
       return EXIT_FAILURE;
     }
-    depthMapFilter->SetInput(varianceFilter->GetOutput());
+    tiles.clear();
+    cores.clear();
+    for (long y = 0; y < static_cast<long>(largestRegion.GetSize(1)); y += tileSize)
+    {
+      for (long x = 0; x < static_cast<long>(largestRegion.GetSize(0)); x += tileSize)
+      {
+        typename InputImageType::RegionType core = largestRegion;
+        core.SetIndex(0, largestRegion.GetIndex(0) + x);
+        core.SetIndex(1, largestRegion.GetIndex(1) + y);
+        core.SetSize(0, tileSize);
+        core.SetSize(1, tileSize);
+        core.Crop(largestRegion);
+        typename InputImageType::RegionType tile = core;
+        tile.PadByRadius(halo);
+        tile.SetIndex(Dimension - 1, largestRegion.GetIndex(Dimension - 1));
+        tile.SetSize(Dimension - 1, depth);
+        tile.Crop(largestRegion);
+        tiles.push_back(tile);
+        cores.push_back(core);
+      }
+    }
+    std::cout << "Streaming " << tiles.size() << " tiles of " << tileSize << " pixels with a halo of " << halo << " pixels." << std::endl;
   }
-  else if (processing.compare("max") == 0)
+
+  /*
+   *  Define pipeline.
+   */
+  typename RegionOfInterestFilterType::Pointer regionOfInterestFilter = RegionOfInterestFilterType::New();
+  regionOfInterestFilter->SetInput(input);
+  typename InputImageType::Pointer volume = streaming ? regionOfInterestFilter->GetOutput() : input;
+  if (streaming)
   {
-    depthMapFilter->SetInput(reader->GetOutput());
+    reader->ReleaseDataFlagOn();
   }
-  else
+  depthMapFilter->SetInput(volume);
+  if (processing.compare("var") == 0)
   {
-    depthMapFilter->SetInput(reader->GetOutput());
+    // The local variance is computed plane by plane by the depth search.
+    typename PlaneVarianceType::Pointer planeVariance = PlaneVarianceType::New();
+    typename PlaneVarianceType::SizeType kernel;
+    kernel.Fill(varianceRadius);
+    kernel[Dimension - 1] = 0;
+    planeVariance->SetRadius(kernel);
+    depthMapFilter->SetPlaneOperator(planeVariance.GetPointer());
   }
   depthMapFilter->SetNumberOfLevels(scalingFactor);
   depthMapFilter->SetSigma(delta);
   depthMapFilter->SetPeak(peak);
   depthMapFilter->SetTolerance(tolerance);
+  depthMapFilter->SetAdaptiveRange(parameters.adaptiveRange);
+  depthMapFilter->SetProfiling(profile.IsEnabled());
 
-  if (sigma >= 1)
+  // The whole volume is read before the depth search, tiles are read with it.
+  if (!mapped && !streaming)
   {
-    gaussianFilter->SetInput(depthMapFilter->GetOutput());
-    gaussianFilter->SetSigma(sigma);
-    castFilter->SetInput(gaussianFilter->GetOutput());
+    try
+    {
+      reader->Update();
+    }
+    catch (itk::ExceptionObject &excp)
+    {
+      std::cerr << excp << std::endl;
+      return EXIT_FAILURE;
+    }
   }
-  else
+  profile.Stop(clock, "read", streaming ? 0 : largestRegion.GetNumberOfPixels(),
+               mapped || streaming ? 0 : largestRegion.GetNumberOfPixels() * sizeof(TPixel));
+
+  // Warm start from the previous timepoint, cropped as the tiles.
+  DepthMapReaderType::Pointer warmStartReader = DepthMapReaderType::New();
+  MapRegionOfInterestFilterType::Pointer warmStartRegionFilter = MapRegionOfInterestFilterType::New();
+  if (!warmStartFileName.empty())
   {
-    castFilter->SetInput(depthMapFilter->GetOutput());
+    warmStartReader->SetFileName(warmStartFileName);
+    warmStartRegionFilter->SetInput(warmStartReader->GetOutput());
   }
-  writer->SetFileName(outputFileName);
-  writer->SetInput(castFilter->GetOutput());
 
   /*
-   *  Update and execute pipeline.
+   *  Compute the depth map of each tile, and stitch their cores.
    */
+  InternatImageType::Pointer depthMap = InternatImageType::New();
+  for (size_t t = 0; t < tiles.size(); t++)
+  {
+    regionOfInterestFilter->SetRegionOfInterest(tiles[t]);
+    clock = profile.Start();
+    try
+    {
+      if (!warmStartFileName.empty())
+      {
+        InternatImageType::RegionType warmStartRegion;
+        for (unsigned int i = 0; i < Dimension - 1; i++)
+        {
+          warmStartRegion.SetIndex(i, tiles[t].GetIndex(i));
+          warmStartRegion.SetSize(i, tiles[t].GetSize(i));
+        }
+        warmStartRegionFilter->SetRegionOfInterest(warmStartRegion);
+        warmStartRegionFilter->UpdateLargestPossibleRegion();
+        InternatImageType::Pointer warmStart = warmStartRegionFilter->GetOutput();
+        warmStart->DisconnectPipeline();
+        depthMapFilter->SetWarmStart(warmStart);
+      }
+      depthMapFilter->UpdateLargestPossibleRegion();
+    }
+    catch (itk::ExceptionObject &excp)
+    {
+      std::cerr << excp << std::endl;
+      return EXIT_FAILURE;
+    }
+    const size_t tilePixels = tiles[t].GetNumberOfPixels();
+    const size_t tileMapPixels = tilePixels / tiles[t].GetSize(Dimension - 1);
+    profile.Stop(clock, "depthmap", tilePixels, (streaming ? tilePixels * sizeof(TPixel) : 0) + tileMapPixels * sizeof(float),
+                 streaming ? static_cast<int>(t) : -1);
+    profile.AddFilterProfile(depthMapFilter.GetPointer(), streaming ? static_cast<int>(t) : -1);
+    if (!streaming)
+    {
+      depthMap = depthMapFilter->GetOutput();
+      depthMap->DisconnectPipeline();
+      break;
+    }
+
+    InternatImageType::ConstPointer tileMap = depthMapFilter->GetOutput();
+    if (t == 0)
+    {
+      // The whole map has the geometry the depth map filter gives to the whole volume.
+      InternatImageType::RegionType mapRegion;
+      InternatImageType::SpacingType mapSpacing;
+      InternatImageType::PointType mapOrigin;
+      for (unsigned int i = 0; i < Dimension - 1; i++)
+      {
+        mapRegion.SetIndex(i, largestRegion.GetIndex(i));
+        mapRegion.SetSize(i, largestRegion.GetSize(i));
+        mapSpacing[i] = reader->GetOutput()->GetSpacing()[i];
+        mapOrigin[i] = reader->GetOutput()->GetOrigin()[i];
+      }
+      depthMap->SetRegions(mapRegion);
+      depthMap->SetSpacing(mapSpacing);
+      depthMap->SetOrigin(mapOrigin);
+      depthMap->Allocate();
+    }
+
+    InternatImageType::RegionType tileCore;
+    InternatImageType::RegionType mapCore;
+    for (unsigned int i = 0; i < Dimension - 1; i++)
+    {
+      tileCore.SetIndex(i, tileMap->GetLargestPossibleRegion().GetIndex(i) + cores[t].GetIndex(i) - tiles[t].GetIndex(i));
+      tileCore.SetSize(i, cores[t].GetSize(i));
+      mapCore.SetIndex(i, cores[t].GetIndex(i));
+      mapCore.SetSize(i, cores[t].GetSize(i));
+    }
+    itk::ImageRegionConstIterator<InternatImageType> tileIte(tileMap, tileCore);
+    itk::ImageRegionIterator<InternatImageType> mapIte(depthMap, mapCore);
+    for (; !tileIte.IsAtEnd(); ++tileIte, ++mapIte)
+    {
+      mapIte.Set(tileIte.Get());
+    }
+  }
+
+  // Smoothing in physical units, written as unsigned short in the same pass.
+  smoother->SetVariance(sigma >= 1 ? sigma * sigma : 0);
+  smoother->UseImageSpacingOn();
+  OutputImageType::Pointer outputMap = OutputImageType::New();
+  outputMap->CopyInformation(depthMap);
+  outputMap->SetRegions(depthMap->GetLargestPossibleRegion());
+
+  /*
+   *  Smooth the map, then write it, each being timed.
+   */
+  const size_t mapPixels = depthMap->GetLargestPossibleRegion().GetNumberOfPixels();
   try
   {
-    writer->Update();
+    clock = profile.Start();
+    outputMap->Allocate();
+    smoother->Smooth(depthMap, outputMap);
+    profile.Stop(clock, "smoothing", mapPixels, mapPixels * sizeof(unsigned short) + smoother->GetNumberOfBytes());
+    clock = profile.Start();
+    WriteDepthMap(outputMap.GetPointer(), outputFileName, imageIO->GetDimensions(Dimension - 1), parameters.writerOptions);
+    profile.Stop(clock, "write", mapPixels, 0);
   }
   catch (itk::ExceptionObject &excp)
   {
     std::cerr << excp << std::endl;
     return EXIT_FAILURE;
   }
+  if (!profile.Write())
+  {
+    std::cerr << "Error: Can not write the profile " << parameters.profileFileName << std::endl;
+    return EXIT_FAILURE;
+  }
 
   /** That's all folks! **/
   return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv)
+{
+  /*
+   * Named options, removed from the positional parameters.
+   */
+  std::string profileFileName = "";
+  bool adaptiveRange = false;
+  std::string sweep = "";
+  WriterOptions writerOptions;
+  std::vector<char *> arguments;
+  for (int i = 0; i < argc; i++)
+  {
+    if (std::string(argv[i]).compare("--adaptive-range") == 0)
+    {
+      adaptiveRange = true;
+      continue;
+    }
+    if (std::string(argv[i]).compare("--profile") == 0 && i + 1 < argc)
+    {
+      profileFileName = argv[++i];
+      continue;
+    }
+    if (std::string(argv[i]).compare("--sweep") == 0 && i + 1 < argc)
+    {
+      sweep = argv[++i];
+      continue;
+    }
+    const WriterOptionStatus writerOption = ParseWriterOption(argc, argv, i, writerOptions);
+    if (writerOption == WriterOptionStatus::Invalid)
+    {
+      return EXIT_FAILURE;
+    }
+    if (writerOption == WriterOptionStatus::Parsed)
+    {
+      continue;
+    }
+    arguments.push_back(argv[i]);
+  }
+  argc = static_cast<int>(arguments.size());
+  argv = arguments.data();
+
+  if (argc < 4)
+  {
+    std::cerr << "Epiproj - Stephane Rigaud {stephane.rigaud@pasteur.fr}";
+    std::cerr << ", Compiled : " << __DATE__ << " at " << __TIME__ << std::endl;
+    std::cerr << "Usage: " << argv[0] << std::endl;
+    std::cerr << "\tInputFileName  (string) - path to input file." << std::endl;
+    std::cerr << "\tOutputFileName (string) - path to output file." << std::endl;
+    std::cerr << "\tSigma (float)           - smoothing parameters." << std::endl;
+    std::cerr << "Options: " << std::endl;
+    std::cerr << "\tType (string)     - Computation on maximum (max) or variance (var) intensity." << std::endl;
+    std::cerr << "\tLevel (int)       - Number of scaling level. (=5)" << std::endl;
+    std::cerr << "\tPeak (int)        - Detecting peak. (=0)" << std::endl;
+    std::cerr << "\tTolerance (float) - Intensity ratio (=0.1)." << std::endl;
+    std::cerr << "\tDelta (int)       - Degree of freedom per step. (=1)" << std::endl;
+    std::cerr << "\tMemory (int)      - Memory budget in MB, streaming by XY tiles above it, 0 for no limit. (=0)" << std::endl;
+    std::cerr << "\tWarmStart (string) - path to the depth map of the previous timepoint, to start from. (=none)" << std::endl;
+    std::cerr << "\t--profile (string) - path to a JSON file timing each stage of the run. (=none)" << std::endl;
+    std::cerr << "\t--adaptive-range   - Search band of each column adapted to the previous level. (=off)" << std::endl;
+    std::cerr << "\t--sweep (string)   - grid of parameters run on one read of the volume, as" << std::endl;
+    std::cerr << "\t                     \"sigma=0,2;level=3,5;peak=0;tolerance=5,10;delta=1,2\". (=none)" << std::endl;
+    std::cerr << "\t--tile (int)       - TIFF output in square tiles of this size, multiple of 16. (=strips)" << std::endl;
+    std::cerr << "\t--compress         - Lossless Deflate compression of the TIFF output, across threads. (=off)" << std::endl;
+    std::cerr << "\t--streams (int)    - Number of bands the output is written in. (=1)" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /*
+   * Parameters  
+   */
+  Parameters parameters;
+  parameters.inputFileName = argv[1];
+  parameters.outputFileName = argv[2];
+  parameters.sigma = std::atoi(argv[3]);
+  parameters.profileFileName = profileFileName;
+  parameters.adaptiveRange = adaptiveRange;
+  parameters.sweep = sweep;
+  parameters.writerOptions = writerOptions;
+  
+  /*
+   * Optional parameters
+   */
+  if (argc >= 5)
+  {
+    parameters.processing = argv[4];
+  }
+  if (argc >= 6)
+  {
+    parameters.scalingFactor = std::atoi(argv[5]);
+  }
+  if (argc >= 7)
+  {
+    parameters.peak = std::atoi(argv[6]);
+  }
+  if (argc >= 8)
+  {
+    parameters.tolerance = std::atoi(argv[7]);
+  }
+  if (argc >= 9)
+  {
+    parameters.delta = std::atoi(argv[8]);
+  }
+  if (argc >= 10)
+  {
+    parameters.memory = std::atol(argv[9]);
+  }
+  if (argc >= 11)
+  {
+    parameters.warmStartFileName = argv[10];
+  }
+
+  /*
+   * Input verification.  
+   */
+  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(parameters.inputFileName.c_str(), itk::ImageIOFactory::ReadMode);
+  imageIO->SetFileName(parameters.inputFileName);
+  imageIO->ReadImageInformation();
+  const unsigned int Dimension = 3;
+  if (imageIO->GetNumberOfDimensions() != Dimension)
+  {
+    std::cerr << "Error: Expected input should be of dimension " << Dimension;
+    std::cerr << ", instead of dimension " << imageIO->GetNumberOfDimensions() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /*
+   *  Run the pipeline of the input pixel type.
+   */
+  switch (imageIO->GetComponentType())
+  {
+    case itk::ImageIOBase::UCHAR:
+      return Generate<unsigned char>(imageIO, parameters);
+    case itk::ImageIOBase::USHORT:
+      return Generate<unsigned short>(imageIO, parameters);
+    default:
+      return Generate<float>(imageIO, parameters);
+  }
 }
\ No newline at end of file
@@ -1,88 +1,241 @@
 
 #include <iostream>
+#include <sstream>
+#include <vector>
 
 #include "itkImageIOBase.h"
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
 
 #include "itkDepthMapProjectionFilter.h"
-#include "itkMedianImageFilter.h"
+#include "itkComposeImageFilter.h"
+#include "epiprojMappedImage.h"
+#include "epiprojImageWriter.h"
+
+/** Parameters of the projection. */
+struct Parameters
+{
+  std::vector<std::string> inputFileNames;
+  std::string depthFileName;
+  std::string outputFileName;
+  unsigned int radius = 0;
+  std::string processing = "max";
+  unsigned int upperRange = 1;
+  unsigned int lowerRange = 1;
+  unsigned int shift = 0;
+  WriterOptions writerOptions;
+};
+
+/** Projection of volumes of pixel type TPixel, written in the same pixel type. Several
+ * channels are projected in one pass along the same map, into one multi-component image. */
+template <typename TPixel>
+int Project(itk::ImageIOBase::Pointer inputImageIO, itk::ImageIOBase::Pointer depthImageIO, const Parameters &parameters)
+{
+  const std::vector<std::string> &inputFileNames = parameters.inputFileNames;
+  const std::string &depthFileName = parameters.depthFileName;
+  const std::string &outputFileName = parameters.outputFileName;
+  const unsigned int radius = parameters.radius;
+  const std::string &processing = parameters.processing;
+  const unsigned int upperRange = parameters.upperRange;
+  const unsigned int lowerRange = parameters.lowerRange;
+  const unsigned int shift = parameters.shift;
+
+  // Multi-component images are written by ImageFileWriter, which compresses them
+  // but does not write tiles.
+  if (inputFileNames.size() > 1 && parameters.writerOptions.tileSize > 0)
+  {
+    std::cerr << "Error: --tile is not supported for several channels, ";
+    std::cerr << "written as one multi-component image." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /*
+   *  Define typedef.
+   */
+  const unsigned int Dimension = 3;
+  using InputImageType = itk::Image<TPixel, Dimension>;
+  using InternatImageType = itk::Image<float, Dimension - 1>;
+  using OutputImageType = itk::Image<TPixel, Dimension - 1>;
+  using ImageReaderType = itk::ImageFileReader<InputImageType>;
+  using DepthMapReaderType = itk::ImageFileReader<InternatImageType>;
+  using VectorImageType = itk::VectorImage<TPixel, Dimension - 1>;
+  using ComposeFilterType = itk::ComposeImageFilter<OutputImageType, VectorImageType>;
+  using VectorWriterType = itk::ImageFileWriter<VectorImageType>;
+  using DepthMapProjectionFilterType = itk::DepthMapProjectionFilter<InputImageType, InternatImageType, OutputImageType>;
+  using ArrayType = typename DepthMapProjectionFilterType::ArrayType;
+
+  /*
+   *  Filters declaration.
+   */
+  typename DepthMapReaderType::Pointer reader2 = DepthMapReaderType::New();
+  typename DepthMapProjectionFilterType::Pointer projectionFilter = DepthMapProjectionFilterType::New();
+  typename ComposeFilterType::Pointer composeFilter = ComposeFilterType::New();
+  typename VectorWriterType::Pointer vectorWriter = VectorWriterType::New();
+
+  /*
+   *  Define pipeline, each channel being a projection filter input.
+   */
+  reader2->SetFileName(depthFileName);
+  reader2->SetImageIO(depthImageIO);
+
+  // Uncompressed channels are mapped rather than read.
+  std::vector<typename ImageReaderType::Pointer> readers;
+  for (unsigned int channel = 0; channel < inputFileNames.size(); channel++)
+  {
+    typename InputImageType::Pointer mapped =
+      MapImage<InputImageType>(inputFileNames[channel], channel == 0 ? inputImageIO : itk::ImageIOBase::Pointer());
+    if (mapped.IsNotNull())
+    {
+      projectionFilter->SetChannel(channel, mapped);
+      continue;
+    }
+    typename ImageReaderType::Pointer reader = ImageReaderType::New();
+    readers.push_back(reader);
+    reader->SetFileName(inputFileNames[channel]);
+    if (channel == 0)
+    {
+      reader->SetImageIO(inputImageIO);
+    }
+    projectionFilter->SetChannel(channel, reader->GetOutput());
+  }
+
+  // The median is only computed for the voxels of the projection band.
+  typename InputImageType::SizeType kernel;
+  kernel.Fill(radius);
+  projectionFilter->SetMedianRadius(kernel);
+
+  projectionFilter->SetMap(reader2->GetOutput());
+  projectionFilter->SetType(processing);
+  projectionFilter->SetShift(shift);
+  ArrayType rangeArray;
+  rangeArray[0] = upperRange;
+  rangeArray[1] = lowerRange;
+  projectionFilter->SetRange(rangeArray);
+
+  /*
+   *  Update and execute pipeline, in bands of the output with stream divisions.
+   */
+  try
+  {
+    if (inputFileNames.size() == 1)
+    {
+      WriteImage<TPixel>(projectionFilter->GetOutput(), outputFileName, parameters.writerOptions);
+    }
+    else
+    {
+      for (unsigned int channel = 0; channel < inputFileNames.size(); channel++)
+      {
+        composeFilter->SetInput(channel, projectionFilter->GetOutput(channel));
+      }
+      vectorWriter->SetFileName(outputFileName);
+      vectorWriter->SetInput(composeFilter->GetOutput());
+      vectorWriter->SetNumberOfStreamDivisions(parameters.writerOptions.streams);
+      vectorWriter->SetUseCompression(parameters.writerOptions.compression);
+      vectorWriter->Update();
+    }
+  }
+  catch (itk::ExceptionObject &excp)
+  {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  /** That's all folks! **/
+  return EXIT_SUCCESS;
+}
 
 int main(int argc, char **argv)
 {
+  /*
+   * Named options, removed from the positional parameters.
+   */
+  WriterOptions writerOptions;
+  std::vector<char *> arguments;
+  for (int i = 0; i < argc; i++)
+  {
+    const WriterOptionStatus writerOption = ParseWriterOption(argc, argv, i, writerOptions);
+    if (writerOption == WriterOptionStatus::Invalid)
+    {
+      return EXIT_FAILURE;
+    }
+    if (writerOption == WriterOptionStatus::Parsed)
+    {
+      continue;
+    }
+    arguments.push_back(argv[i]);
+  }
+  argc = static_cast<int>(arguments.size());
+  argv = arguments.data();
 
   if (argc < 4)
   {
     std::cerr << "Epiproj - Stephane Rigaud {stephane.rigaud@pasteur.fr}";
     std::cerr << ", Compiled : " << __DATE__ << " at " << __TIME__ << std::endl;
     std::cerr << "Usage: " << argv[0] << std::endl;
-    std::cerr << "\tInputFileName  (string) - path to input file." << std::endl;
+    std::cerr << "\tInputFileName  (string) - path to input file, or comma separated channel files." << std::endl;
     std::cerr << "\tDepthFileName (string)  - path to depth map file." << std::endl;
     std::cerr << "\tOutputFileName (string) - path to output file." << std::endl;
     std::cerr << "Options: " << std::endl;
     std::cerr << "\tMedian (int)      - Median radius kernel. (=0)" << std::endl;
-    std::cerr << "\tType (string)     - Projection type, maximum (max), average (avg) intensity." << std::endl;
+    std::cerr << "\tType (string)     - Projection type, max, min, sum, avg, std, median or gauss intensity." << std::endl;
     std::cerr << "\tupperRange (int)  - Upper range band. (=1)" << std::endl;
     std::cerr << "\tlowerRange (int)  - Lower range band. (=1)" << std::endl;
     std::cerr << "\tshift (int)       - Depth shift. (=0)" << std::endl;
+    std::cerr << "\t--tile (int)      - TIFF output in square tiles of this size, multiple of 16. (=strips)" << std::endl;
+    std::cerr << "\t--compress        - Lossless Deflate compression of the TIFF output, across threads. (=off)" << std::endl;
+    std::cerr << "\t--streams (int)   - Number of bands the projection is computed and written in. (=1)" << std::endl;
     return EXIT_FAILURE;
   }
 
   /*
    * Parameters  
    */
-  std::string inputFileName = argv[1];
-  std::string depthFileName = argv[2];
-  std::string outputFileName = argv[3];
+  Parameters parameters;
+  std::stringstream inputFileNames(argv[1]);
+  std::string inputFileName;
+  while (std::getline(inputFileNames, inputFileName, ','))
+  {
+    parameters.inputFileNames.push_back(inputFileName);
+  }
+  parameters.depthFileName = argv[2];
+  parameters.outputFileName = argv[3];
+  parameters.writerOptions = writerOptions;
 
   /*
    * Optional parameters
    */
-  unsigned int radius = 0;
   if (argc >= 5)
   {
-    radius = std::atoi(argv[4]);
+    parameters.radius = std::atoi(argv[4]);
   }
-  std::string processing = "max";
   if (argc >= 6)
   {
-    processing = argv[5];
+    parameters.processing = argv[5];
   }
-  unsigned int upperRange = 1;
   if (argc >= 7)
   {
-    upperRange = std::atoi(argv[6]);
+    parameters.upperRange = std::atoi(argv[6]);
   }
-  unsigned int lowerRange = 1;
   if (argc >= 8)
   {
-    lowerRange = std::atoi(argv[7]);
+    parameters.lowerRange = std::atoi(argv[7]);
   }
-  unsigned int shift = 0;
   if (argc >= 9)
   {
-    shift = std::atoi(argv[8]);
+    parameters.shift = std::atoi(argv[8]);
   }
 
-  /*
-   *  Define typedef.
-   */
-  const unsigned int Dimension = 3;
-  using InputImageType = itk::Image<float, Dimension>;
-  using InternatImageType = itk::Image<float, Dimension - 1>;
-  using OutputImageType = itk::Image<unsigned short, Dimension - 1>;
-  using ImageReaderType = itk::ImageFileReader<InputImageType>;
-  using DepthMapReaderType = itk::ImageFileReader<InternatImageType>;
-  using ImageWriterType = itk::ImageFileWriter<OutputImageType>;
-  using DepthMapProjectionFilterType = itk::DepthMapProjectionFilter<InputImageType, InternatImageType, OutputImageType>;
-  using ArrayType = typename DepthMapProjectionFilterType::ArrayType;
-  using MedianFilterType = itk::MedianImageFilter<InputImageType, InputImageType>;
-
   /*
    * Input verification.  
    */
-  itk::ImageIOBase::Pointer inputImageIO = itk::ImageIOFactory::CreateImageIO(inputFileName.c_str(), itk::ImageIOFactory::ReadMode);
-  inputImageIO->SetFileName(inputFileName);
+  const unsigned int Dimension = 3;
+  if (parameters.inputFileNames.empty())
+  {
+    std::cerr << "Error: Expected at least one input file" << std::endl;
+    return EXIT_FAILURE;
+  }
+  itk::ImageIOBase::Pointer inputImageIO = itk::ImageIOFactory::CreateImageIO(parameters.inputFileNames[0].c_str(), itk::ImageIOFactory::ReadMode);
+  inputImageIO->SetFileName(parameters.inputFileNames[0]);
   inputImageIO->ReadImageInformation();
   if (inputImageIO->GetNumberOfDimensions() != Dimension)
   {
@@ -91,8 +244,8 @@ int main(int argc, char **argv)
     return EXIT_FAILURE;
   }
 
-  itk::ImageIOBase::Pointer depthImageIO = itk::ImageIOFactory::CreateImageIO(depthFileName.c_str(), itk::ImageIOFactory::ReadMode);
-  depthImageIO->SetFileName(depthFileName);
+  itk::ImageIOBase::Pointer depthImageIO = itk::ImageIOFactory::CreateImageIO(parameters.depthFileName.c_str(), itk::ImageIOFactory::ReadMode);
+  depthImageIO->SetFileName(parameters.depthFileName);
   depthImageIO->ReadImageInformation();
   if (depthImageIO->GetNumberOfDimensions() != (Dimension - 1))
   {
@@ -102,68 +255,15 @@ int main(int argc, char **argv)
   }
 
   /*
-   *  Filters declaration.
-   */
-  ImageReaderType::Pointer reader = ImageReaderType::New();
-  DepthMapReaderType::Pointer reader2 = DepthMapReaderType::New();
-  DepthMapProjectionFilterType::Pointer projectionFilter = DepthMapProjectionFilterType::New();
-  ImageWriterType::Pointer writer = ImageWriterType::New();
-
-  /*
-   *  Define pipeline.
-   */
-  reader->SetFileName(inputFileName);
-  reader->SetImageIO(inputImageIO);
-  reader2->SetFileName(depthFileName);
-  reader2->SetImageIO(depthImageIO);
-
-  if (radius)
-  {
-    MedianFilterType::InputSizeType kernel;
-    kernel.Fill(radius);
-    MedianFilterType::Pointer median = MedianFilterType::New();
-    median->SetInput(reader->GetOutput());
-    median->SetRadius(kernel);
-    try
-    {
-      median->Update();
-    }
-    catch (itk::ExceptionObject &excp)
-    {
-      std::cerr << excp << std::endl;
-      return EXIT_FAILURE;
-    }
-    projectionFilter->SetInput(median->GetOutput());
-  }
-  else
-  {
-    projectionFilter->SetInput(reader->GetOutput());
-  }
-
-  projectionFilter->SetMap(reader2->GetOutput());
-  projectionFilter->SetType(processing);
-  projectionFilter->SetShift(shift);
-  ArrayType rangeArray;
-  rangeArray[0] = upperRange;
-  rangeArray[1] = lowerRange;
-  projectionFilter->SetRange(rangeArray);
-
-  writer->SetFileName(outputFileName);
-  writer->SetInput(projectionFilter->GetOutput());
-
-  /*
-   *  Update and execute pipeline.
+   *  Run the pipeline of the input pixel type.
    */
-  try
+  switch (inputImageIO->GetComponentType())
   {
-    writer->Update();
+    case itk::ImageIOBase::UCHAR:
+      return Project<unsigned char>(inputImageIO, depthImageIO, parameters);
+    case itk::ImageIOBase::USHORT:
+      return Project<unsigned short>(inputImageIO, depthImageIO, parameters);
+    default:
+      return Project<float>(inputImageIO, depthImageIO, parameters);
   }
-  catch (itk::ExceptionObject &excp)
-  {
-    std::cerr << excp << std::endl;
-    return EXIT_FAILURE;
-  }
-
-  /** That's all folks! **/
-  return EXIT_SUCCESS;
 }
\ No newline at end of file
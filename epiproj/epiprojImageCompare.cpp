@@ -0,0 +1,62 @@
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include "itkImageFileReader.h"
+
+/*
+ *  Pixels of an image compared with the ones of a baseline image, of the same
+ *  size, the images being read as 3D double images whatever their dimension and
+ *  pixel type.
+ */
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " ImageFileName BaselineFileName [Tolerance]" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const double tolerance = argc >= 4 ? std::atof(argv[3]) : 0;
+
+  using ImageType = itk::Image<double, 3>;
+  using ReaderType = itk::ImageFileReader<ImageType>;
+  ReaderType::Pointer reader = ReaderType::New();
+  ReaderType::Pointer baselineReader = ReaderType::New();
+  reader->SetFileName(argv[1]);
+  baselineReader->SetFileName(argv[2]);
+  try
+  {
+    reader->Update();
+    baselineReader->Update();
+  }
+  catch (itk::ExceptionObject &excp)
+  {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const ImageType *image = reader->GetOutput();
+  const ImageType *baseline = baselineReader->GetOutput();
+  if (image->GetLargestPossibleRegion().GetSize() != baseline->GetLargestPossibleRegion().GetSize())
+  {
+    std::cerr << "Size " << image->GetLargestPossibleRegion().GetSize() << " differs from the baseline size "
+              << baseline->GetLargestPossibleRegion().GetSize() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  unsigned long mismatch = 0;
+  double maximumDifference = 0;
+  const size_t numberOfPixels = image->GetLargestPossibleRegion().GetNumberOfPixels();
+  for (size_t i = 0; i < numberOfPixels; i++)
+  {
+    const double difference = std::abs(image->GetBufferPointer()[i] - baseline->GetBufferPointer()[i]);
+    maximumDifference = std::max(maximumDifference, difference);
+    mismatch += difference > tolerance ? 1 : 0;
+  }
+  std::cout << "Mismatching pixels: " << mismatch << ", maximum difference: " << maximumDifference << std::endl;
+
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
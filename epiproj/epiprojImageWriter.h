@@ -0,0 +1,338 @@
+#ifndef __epiprojImageWriter_h
+#define __epiprojImageWriter_h
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "itkImage.h"
+#include "itkImageFileWriter.h"
+#include "itkCastImageFilter.h"
+#include "itkMultiThreaderBase.h"
+#include "itk_tiff.h"
+#include "itk_zlib.h"
+
+/*
+ *  Image output.
+ *  Maps and projections are written by ImageFileWriter, or, for TIFF files
+ *  with tiling, compression or stream divisions, by WriteTiff: the image is
+ *  written as tiles, or strips, compressed by Deflate across threads and
+ *  written in the file as they are. With stream divisions, the image is
+ *  updated band by band, each band being compressed and written before the
+ *  next one is computed, so that a projection is never held in memory whole.
+ *  Depth maps of stacks of at most 256 slices are written as unsigned char.
+ */
+
+/** Options of the output. Tiles are square, of a multiple of 16 pixels, and
+ * strips are used without tile size. Compression is Deflate, lossless, with
+ * the horizontal predictor for integer pixels. Compression uses the given
+ * number of threads, 0 for the default of ITK. */
+struct WriterOptions
+{
+  unsigned int tileSize = 0;
+  bool compression = false;
+  unsigned int streams = 1;
+  unsigned int threads = 0;
+
+  /** Whether TIFF files are written by WriteTiff rather than ImageFileWriter. */
+  bool
+  UseTiffWriter() const
+  {
+    return tileSize > 0 || compression || streams > 1;
+  }
+};
+
+/** Result of the parse of an argument as an output option. */
+enum class WriterOptionStatus
+{
+  NotOption,
+  Parsed,
+  Invalid
+};
+
+/** Parse a named output option at argument i, moving i past its value.
+ * Options missing their value, or with a value that is not a positive integer,
+ * are invalid, an error being printed. */
+inline WriterOptionStatus
+ParseWriterOption(int argc, char **argv, int &i, WriterOptions &options)
+{
+  const std::string argument = argv[i];
+  if (argument.compare("--compress") == 0)
+    {
+    options.compression = true;
+    return WriterOptionStatus::Parsed;
+    }
+  if (argument.compare("--tile") != 0 && argument.compare("--streams") != 0)
+    {
+    return WriterOptionStatus::NotOption;
+    }
+  if (i + 1 >= argc)
+    {
+    std::cerr << "Error: Missing value of " << argument << std::endl;
+    return WriterOptionStatus::Invalid;
+    }
+  char *end = nullptr;
+  const long value = std::strtol(argv[++i], &end, 10);
+  if (*end != '\0' || value <= 0 || value > std::numeric_limits<int>::max())
+    {
+    std::cerr << "Error: " << argument << " must be a positive integer, not " << argv[i] << std::endl;
+    return WriterOptionStatus::Invalid;
+    }
+  if (argument.compare("--tile") == 0)
+    {
+    options.tileSize = static_cast<unsigned int>(value);
+    }
+  else
+    {
+    options.streams = static_cast<unsigned int>(value);
+    }
+  return WriterOptionStatus::Parsed;
+}
+
+/** Whether a file is written as TIFF. */
+inline bool
+IsTiffFileName(const std::string &fileName)
+{
+  const size_t dot = fileName.find_last_of('.');
+  if (dot == std::string::npos)
+    {
+    return false;
+    }
+  std::string extension = fileName.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+  return extension.compare("tif") == 0 || extension.compare("tiff") == 0;
+}
+
+/** Horizontal predictor of a row: each sample replaced by its difference with
+ * the previous one, in the arithmetic of the sample type. */
+template <typename TPixel>
+void
+PredictRow(TPixel *row, size_t width)
+{
+  for (size_t x = width; x-- > 1;)
+    {
+    row[x] = static_cast<TPixel>(row[x] - row[x - 1]);
+    }
+}
+
+/** Write a 2D image, of any pixel type, as a TIFF of pixel type TOutputPixel,
+ * the values being cast. The image can be the output of a pipeline, which is
+ * then updated by bands of rows, one per stream division. */
+template <typename TOutputPixel, typename TImage>
+void
+WriteTiff(TImage *image, const std::string &fileName, const WriterOptions &options)
+{
+  static_assert(TImage::ImageDimension == 2, "WriteTiff writes 2D images");
+  using RegionType = typename TImage::RegionType;
+  const bool predictor = options.compression && std::numeric_limits<TOutputPixel>::is_integer;
+
+  image->UpdateOutputInformation();
+  const RegionType largestRegion = image->GetLargestPossibleRegion();
+  const size_t width = largestRegion.GetSize(0);
+  const size_t height = largestRegion.GetSize(1);
+
+  // Blocks of the file, tiles or strips of about 64 KB, written in row-major order.
+  const bool tiled = options.tileSize > 0;
+  const size_t blockWidth = tiled ? (options.tileSize + 15) / 16 * 16 : width;
+  const size_t blockHeight = tiled ? blockWidth : std::max<size_t>(65536 / (width * sizeof(TOutputPixel)), 1);
+  const size_t blocksAcross = (width + blockWidth - 1) / blockWidth;
+  const size_t blocksDown = (height + blockHeight - 1) / blockHeight;
+  const size_t bandBlocks = (blocksDown + options.streams - 1) / options.streams;
+
+  // BigTIFF for files that may exceed 4 GB.
+  const uint64_t imageBytes = static_cast<uint64_t>(width) * height * sizeof(TOutputPixel);
+  TIFF *tiff = TIFFOpen(fileName.c_str(), imageBytes > 0xF0000000ULL ? "w8" : "w");
+  if (tiff == nullptr)
+    {
+    itkGenericExceptionMacro(<< "Can not write the TIFF file " << fileName);
+    }
+  const uint16_t sampleFormat = !std::numeric_limits<TOutputPixel>::is_integer ? SAMPLEFORMAT_IEEEFP
+                                : std::numeric_limits<TOutputPixel>::is_signed ? SAMPLEFORMAT_INT
+                                                                               : SAMPLEFORMAT_UINT;
+  TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, static_cast<uint32_t>(width));
+  TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, static_cast<uint32_t>(height));
+  TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, static_cast<uint16_t>(8 * sizeof(TOutputPixel)));
+  TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, static_cast<uint16_t>(1));
+  TIFFSetField(tiff, TIFFTAG_SAMPLEFORMAT, sampleFormat);
+  TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+  TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+  TIFFSetField(tiff, TIFFTAG_COMPRESSION, options.compression ? COMPRESSION_ADOBE_DEFLATE : COMPRESSION_NONE);
+  if (predictor)
+    {
+    TIFFSetField(tiff, TIFFTAG_PREDICTOR, PREDICTOR_HORIZONTAL);
+    }
+  if (tiled)
+    {
+    TIFFSetField(tiff, TIFFTAG_TILEWIDTH, static_cast<uint32_t>(blockWidth));
+    TIFFSetField(tiff, TIFFTAG_TILELENGTH, static_cast<uint32_t>(blockHeight));
+    }
+  else
+    {
+    TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, static_cast<uint32_t>(blockHeight));
+    }
+  // Spacing in mm, resolution in pixels per cm, as written by ITK.
+  TIFFSetField(tiff, TIFFTAG_RESOLUTIONUNIT, RESUNIT_CENTIMETER);
+  TIFFSetField(tiff, TIFFTAG_XRESOLUTION, static_cast<float>(10.0 / image->GetSpacing()[0]));
+  TIFFSetField(tiff, TIFFTAG_YRESOLUTION, static_cast<float>(10.0 / image->GetSpacing()[1]));
+
+  itk::MultiThreaderBase::Pointer threader = itk::MultiThreaderBase::New();
+  if (options.threads > 0)
+    {
+    threader->SetNumberOfWorkUnits(options.threads);
+    }
+  std::vector<std::vector<unsigned char>> blocks;
+  bool written = true;
+  for (size_t firstBlockRow = 0; firstBlockRow < blocksDown && written; firstBlockRow += bandBlocks)
+    {
+    // Band of rows, updated alone.
+    const size_t lastBlockRow = std::min(firstBlockRow + bandBlocks, blocksDown);
+    RegionType band = largestRegion;
+    band.SetIndex(1, largestRegion.GetIndex(1) + firstBlockRow * blockHeight);
+    band.SetSize(1, std::min(lastBlockRow * blockHeight, height) - firstBlockRow * blockHeight);
+    image->SetRequestedRegion(band);
+    try
+      {
+      image->Update();
+      }
+    catch (...)
+      {
+      TIFFClose(tiff);
+      throw;
+      }
+    const typename TImage::PixelType *buffer = image->GetBufferPointer();
+
+    // Each block of the band cast, predicted and compressed by one work unit.
+    const size_t bandBlockCount = (lastBlockRow - firstBlockRow) * blocksAcross;
+    blocks.assign(bandBlockCount, std::vector<unsigned char>());
+    threader->ParallelizeArray(
+      0,
+      bandBlockCount,
+      [&](itk::SizeValueType b) -> void {
+        const size_t blockX = (b % blocksAcross) * blockWidth;
+        const size_t blockY = (firstBlockRow + b / blocksAcross) * blockHeight;
+        const size_t rows = tiled ? blockHeight : std::min(blockHeight, height - blockY);
+        std::vector<TOutputPixel> pixels(blockWidth * rows, TOutputPixel());
+        for (size_t y = 0; y < rows && blockY + y < height; y++)
+          {
+          typename TImage::IndexType index = largestRegion.GetIndex();
+          index[0] += blockX;
+          index[1] += blockY + y;
+          const typename TImage::PixelType *row = buffer + image->ComputeOffset(index);
+          TOutputPixel *blockRow = pixels.data() + y * blockWidth;
+          for (size_t x = 0; x < blockWidth && blockX + x < width; x++)
+            {
+            blockRow[x] = static_cast<TOutputPixel>(row[x]);
+            }
+          if (predictor)
+            {
+            PredictRow(blockRow, blockWidth);
+            }
+          }
+        std::vector<unsigned char> &block = blocks[b];
+        const uLong rawBytes = static_cast<uLong>(pixels.size() * sizeof(TOutputPixel));
+        if (!options.compression)
+          {
+          block.resize(rawBytes);
+          std::memcpy(block.data(), pixels.data(), rawBytes);
+          return;
+          }
+        uLongf compressedBytes = compressBound(rawBytes);
+        block.resize(compressedBytes);
+        if (compress2(block.data(), &compressedBytes, reinterpret_cast<const Bytef *>(pixels.data()), rawBytes,
+                      Z_DEFAULT_COMPRESSION) != Z_OK)
+          {
+          block.clear();
+          return;
+          }
+        block.resize(compressedBytes);
+      },
+      nullptr);
+
+    // Blocks written in order, as compressed.
+    for (size_t b = 0; b < bandBlockCount && written; b++)
+      {
+      const uint32_t blockIndex = static_cast<uint32_t>(firstBlockRow * blocksAcross + b);
+      tmsize_t size = static_cast<tmsize_t>(blocks[b].size());
+      written = size > 0 && (tiled ? TIFFWriteRawTile(tiff, blockIndex, blocks[b].data(), size)
+                                   : TIFFWriteRawStrip(tiff, blockIndex, blocks[b].data(), size)) == size;
+      }
+    }
+  written = written && TIFFWriteDirectory(tiff) != 0;
+  TIFFClose(tiff);
+  image->SetRequestedRegionToLargestPossibleRegion();
+  if (!written)
+    {
+    itkGenericExceptionMacro(<< "Can not write the TIFF file " << fileName);
+    }
+}
+
+/** Write an image with ImageFileWriter, in stream divisions for the formats
+ * that can be written by parts. */
+template <typename TImage>
+void
+WriteImageFile(TImage *image, const std::string &fileName, unsigned int streams)
+{
+  typename itk::ImageFileWriter<TImage>::Pointer writer = itk::ImageFileWriter<TImage>::New();
+  writer->SetFileName(fileName);
+  writer->SetInput(image);
+  writer->SetNumberOfStreamDivisions(streams);
+  writer->Update();
+}
+
+/** Write an image of the output pixel type, as is. */
+template <typename TOutputPixel, typename TImage>
+typename std::enable_if<std::is_same<TOutputPixel, typename TImage::PixelType>::value>::type
+WriteCastImageFile(TImage *image, const std::string &fileName, unsigned int streams)
+{
+  WriteImageFile(image, fileName, streams);
+}
+
+/** Write an image cast to the output pixel type. */
+template <typename TOutputPixel, typename TImage>
+typename std::enable_if<!std::is_same<TOutputPixel, typename TImage::PixelType>::value>::type
+WriteCastImageFile(TImage *image, const std::string &fileName, unsigned int streams)
+{
+  using OutputImageType = itk::Image<TOutputPixel, TImage::ImageDimension>;
+  using CastFilterType = itk::CastImageFilter<TImage, OutputImageType>;
+  typename CastFilterType::Pointer castFilter = CastFilterType::New();
+  castFilter->SetInput(image);
+  WriteImageFile(castFilter->GetOutput(), fileName, streams);
+}
+
+/** Write an image as pixel type TOutputPixel, by WriteTiff for tiled TIFF
+ * options, else by ImageFileWriter. */
+template <typename TOutputPixel, typename TImage>
+void
+WriteImage(TImage *image, const std::string &fileName, const WriterOptions &options)
+{
+  if (IsTiffFileName(fileName) && options.UseTiffWriter())
+    {
+    WriteTiff<TOutputPixel>(image, fileName, options);
+    return;
+    }
+  WriteCastImageFile<TOutputPixel>(image, fileName, options.streams);
+}
+
+/** Write a depth map of a stack of the given number of slices, as unsigned char
+ * when its depths fit, else as unsigned short. */
+template <typename TImage>
+void
+WriteDepthMap(TImage *map, const std::string &fileName, itk::SizeValueType numberOfSlices,
+              const WriterOptions &options)
+{
+  if (numberOfSlices <= 256)
+    {
+    WriteImage<unsigned char>(map, fileName, options);
+    return;
+    }
+  WriteImage<unsigned short>(map, fileName, options);
+}
+
+#endif // __epiprojImageWriter_h
@@ -0,0 +1,119 @@
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "itkImageFileReader.h"
+#include "itkImageIOFactory.h"
+#include "itkCastImageFilter.h"
+#include "epiprojImageWriter.h"
+
+/** Number of pixels of a file differing from the map, -1 if it can not be read,
+ * or does not have the expected component type or size. */
+template <typename TMap>
+long
+Compare(const TMap *map, const std::string &fileName, itk::ImageIOBase::IOComponentType componentType)
+{
+  itk::ImageIOBase::Pointer imageIO = itk::ImageIOFactory::CreateImageIO(fileName.c_str(), itk::ImageIOFactory::ReadMode);
+  if (imageIO.IsNull())
+  {
+    return -1;
+  }
+  imageIO->SetFileName(fileName);
+  imageIO->ReadImageInformation();
+  if (imageIO->GetComponentType() != componentType)
+  {
+    std::cerr << fileName << ": unexpected component type "
+              << itk::ImageIOBase::GetComponentTypeAsString(imageIO->GetComponentType()) << std::endl;
+    return -1;
+  }
+  typename itk::ImageFileReader<TMap>::Pointer reader = itk::ImageFileReader<TMap>::New();
+  reader->SetFileName(fileName);
+  reader->Update();
+  const TMap *written = reader->GetOutput();
+  if (written->GetLargestPossibleRegion().GetSize() != map->GetLargestPossibleRegion().GetSize())
+  {
+    return -1;
+  }
+  long mismatch = 0;
+  const size_t numberOfPixels = map->GetLargestPossibleRegion().GetNumberOfPixels();
+  for (size_t i = 0; i < numberOfPixels; i++)
+  {
+    mismatch += written->GetBufferPointer()[i] != map->GetBufferPointer()[i] ? 1 : 0;
+  }
+  std::cout << fileName << ": " << mismatch << " mismatching pixels" << std::endl;
+  return mismatch;
+}
+
+/*
+ *  Depth map written as tiles or strips, compressed or not, in stream divisions,
+ *  and read back.
+ */
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " DepthMapFileName OutputPrefix" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string prefix = argv[2];
+
+  using MapType = itk::Image<unsigned short, 2>;
+  using FloatMapType = itk::Image<float, 2>;
+  using CastFilterType = itk::CastImageFilter<MapType, FloatMapType>;
+  using MapReaderType = itk::ImageFileReader<MapType>;
+
+  bool failed = false;
+  long mismatch = 0;
+  auto Check = [&failed, &mismatch](long fileMismatch) {
+    failed = failed || fileMismatch < 0;
+    mismatch += std::max(fileMismatch, 0L);
+  };
+  try
+  {
+    MapReaderType::Pointer reader = MapReaderType::New();
+    reader->SetFileName(argv[1]);
+    reader->Update();
+    MapType::Pointer map = reader->GetOutput();
+
+    // Compressed tiles, in 3 bands.
+    WriterOptions tiled;
+    tiled.tileSize = 50;
+    tiled.compression = true;
+    tiled.streams = 3;
+    WriteTiff<unsigned short>(map.GetPointer(), prefix + "_Tiled.tif", tiled);
+    Check(Compare(map.GetPointer(), prefix + "_Tiled.tif", itk::ImageIOBase::USHORT));
+
+    // Compressed strips, on 2 threads.
+    WriterOptions strips;
+    strips.compression = true;
+    strips.threads = 2;
+    WriteTiff<unsigned short>(map.GetPointer(), prefix + "_Strips.tif", strips);
+    Check(Compare(map.GetPointer(), prefix + "_Strips.tif", itk::ImageIOBase::USHORT));
+
+    // Depths of a stack of 256 slices narrowed to unsigned char.
+    WriteDepthMap(map.GetPointer(), prefix + "_Narrowed.tif", 256, tiled);
+    Check(Compare(map.GetPointer(), prefix + "_Narrowed.tif", itk::ImageIOBase::UCHAR));
+    WriteDepthMap(map.GetPointer(), prefix + "_Narrowed.mha", 256, WriterOptions());
+    Check(Compare(map.GetPointer(), prefix + "_Narrowed.mha", itk::ImageIOBase::UCHAR));
+
+    // Output of a pipeline, updated band by band, as float tiles.
+    CastFilterType::Pointer castFilter = CastFilterType::New();
+    castFilter->SetInput(map);
+    WriterOptions streamed;
+    streamed.tileSize = 32;
+    streamed.streams = 5;
+    WriteTiff<float>(castFilter->GetOutput(), prefix + "_Streamed.tif", streamed);
+    Check(Compare(map.GetPointer(), prefix + "_Streamed.tif", itk::ImageIOBase::FLOAT));
+  }
+  catch (itk::ExceptionObject &excp)
+  {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return !failed && mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
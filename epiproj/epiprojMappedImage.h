@@ -0,0 +1,447 @@
+#ifndef __epiprojMappedImage_h
+#define __epiprojMappedImage_h
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "itkImage.h"
+#include "itkImageIOBase.h"
+#include "itkImageIOFactory.h"
+#include "itkImportImageContainer.h"
+#include "itkByteSwapper.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define EPIPROJ_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ *  Memory mapped volumes.
+ *  The pixels of an uncompressed volume, stored contiguously in the file in the
+ *  memory order of the image, are mapped instead of being read: the volume is
+ *  available at once, and its pages are read by the system as the filters touch
+ *  them, and can be dropped under memory pressure. Uncompressed TIFF stacks,
+ *  MetaImage (mha, or mhd with its raw file) and NRRD (attached or detached
+ *  raw data) are mapped, any other file is left to ImageFileReader.
+ */
+
+/** Location of the raw pixels of a volume: file, byte offset, and byte order. */
+struct RawLayout
+{
+  std::string fileName;
+  size_t offset = 0;
+  bool bigEndian = false;
+};
+
+/** Directory of a file name, with its trailing separator. */
+inline std::string
+GetDirectory(const std::string &fileName)
+{
+  const size_t separator = fileName.find_last_of("/\\");
+  return separator == std::string::npos ? std::string() : fileName.substr(0, separator + 1);
+}
+
+/** Value of a "key = value" or "key: value" header line, trimmed. */
+inline std::string
+GetHeaderValue(const std::string &line, size_t separator)
+{
+  const size_t first = line.find_first_not_of(" \t", separator + 1);
+  const size_t last = line.find_last_not_of(" \t\r");
+  return first == std::string::npos ? std::string() : line.substr(first, last - first + 1);
+}
+
+inline std::string
+GetHeaderKey(const std::string &line, size_t separator)
+{
+  const size_t last = line.find_last_not_of(" \t", separator - 1);
+  return line.substr(0, last + 1);
+}
+
+/** Raw layout of a MetaImage, the header being followed by the data (LOCAL) or
+ * pointing to a single raw file. */
+inline bool
+GetMetaImageLayout(const std::string &fileName, RawLayout &layout)
+{
+  std::ifstream file(fileName, std::ios::binary);
+  std::string line;
+  long headerSize = 0;
+  while (std::getline(file, line))
+    {
+    const size_t separator = line.find('=');
+    if (separator == std::string::npos)
+      {
+      return false;
+      }
+    const std::string key = GetHeaderKey(line, separator);
+    const std::string value = GetHeaderValue(line, separator);
+    if ((key == "CompressedData" && value == "True") || key == "ElementDataFileRecordSize")
+      {
+      return false;
+      }
+    if (key == "HeaderSize")
+      {
+      headerSize = std::atol(value.c_str());
+      }
+    if (key == "BinaryDataByteOrderMSB" || key == "ElementByteOrderMSB")
+      {
+      layout.bigEndian = value == "True";
+      }
+    if (key == "ElementDataFile")
+      {
+      if (value == "LOCAL")
+        {
+        layout.fileName = fileName;
+        layout.offset = static_cast<size_t>(file.tellg()) + std::max(headerSize, 0L);
+        return headerSize >= 0;
+        }
+      if (value == "LIST" || value.find('%') != std::string::npos || value.find(' ') != std::string::npos)
+        {
+        return false;
+        }
+      layout.fileName = value[0] == '/' ? value : GetDirectory(fileName) + value;
+      layout.offset = headerSize;
+      return headerSize >= 0;
+      }
+    }
+  return false;
+}
+
+/** Raw layout of a NRRD, with raw encoding, attached or in a single detached file. */
+inline bool
+GetNrrdLayout(const std::string &fileName, RawLayout &layout)
+{
+  std::ifstream file(fileName, std::ios::binary);
+  std::string line;
+  std::string dataFileName;
+  long byteSkip = 0;
+  bool raw = false;
+  if (!std::getline(file, line) || line.compare(0, 4, "NRRD") != 0)
+    {
+    return false;
+    }
+  while (std::getline(file, line) && line.find_first_not_of("\r") != std::string::npos)
+    {
+    if (line[0] == '#')
+      {
+      continue;
+      }
+    const size_t separator = line.find(':');
+    if (separator == std::string::npos || line.compare(separator, 2, ":=") == 0)
+      {
+      continue;
+      }
+    const std::string key = GetHeaderKey(line, separator);
+    const std::string value = GetHeaderValue(line, separator);
+    if (key == "encoding")
+      {
+      raw = value == "raw";
+      }
+    else if (key == "endian")
+      {
+      layout.bigEndian = value == "big";
+      }
+    else if (key == "byte skip" || key == "byteskip")
+      {
+      byteSkip = std::atol(value.c_str());
+      }
+    else if (key == "line skip" || key == "lineskip")
+      {
+      if (std::atol(value.c_str()) != 0)
+        {
+        return false;
+        }
+      }
+    else if (key == "data file" || key == "datafile")
+      {
+      if (value.find(' ') != std::string::npos || value == "LIST")
+        {
+        return false;
+        }
+      dataFileName = value[0] == '/' ? value : GetDirectory(fileName) + value;
+      }
+    }
+  if (!raw || byteSkip < 0)
+    {
+    return false;
+    }
+  layout.fileName = dataFileName.empty() ? fileName : dataFileName;
+  layout.offset = (dataFileName.empty() ? static_cast<size_t>(file.tellg()) : 0) + byteSkip;
+  return !dataFileName.empty() || file.good();
+}
+
+/** Raw layout of a classic TIFF stack, each page being an uncompressed single
+ * sample image stored right after the previous one. */
+inline bool
+GetTIFFLayout(const std::string &fileName, size_t bytesPerPixel, RawLayout &layout)
+{
+  std::ifstream file(fileName, std::ios::binary);
+  char header[8];
+  if (!file.read(header, 8) || (std::memcmp(header, "II*\0", 4) != 0 && std::memcmp(header, "MM\0*", 4) != 0))
+    {
+    return false;
+    }
+  layout.fileName = fileName;
+  layout.bigEndian = header[0] == 'M';
+  file.seekg(0, std::ios::end);
+  const uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+
+  // Integers of the byte order of the file.
+  auto read = [&](uint64_t position, unsigned int size) -> uint64_t {
+    unsigned char bytes[4] = {0, 0, 0, 0};
+    file.seekg(position);
+    file.read(reinterpret_cast<char *>(bytes), size);
+    uint64_t value = 0;
+    for (unsigned int b = 0; b < size; b++)
+      {
+      value |= static_cast<uint64_t>(bytes[layout.bigEndian ? size - 1 - b : b]) << (8 * b);
+      }
+    return value;
+  };
+
+  uint64_t ifd = read(4, 4);
+  uint64_t pageBytes = 0;
+  uint64_t nextPage = 0;
+  for (unsigned int page = 0; ifd != 0 && file.good(); page++)
+    {
+    const uint64_t numberOfEntries = read(ifd, 2);
+    if (ifd + 6 + 12 * numberOfEntries > fileSize)
+      {
+      return false;
+      }
+    uint64_t width = 0, height = 0, bits = 1, compression = 1, samples = 1, orientation = 1;
+    std::vector<uint64_t> stripOffsets, stripBytes;
+    for (uint64_t e = 0; e < numberOfEntries; e++)
+      {
+      // Entries are read as is, so their values must lie within the file, which
+      // bounds the strip lists allocated.
+      const uint64_t entry = ifd + 2 + 12 * e;
+      const uint64_t tag = read(entry, 2);
+      const uint64_t type = read(entry + 2, 2);
+      const uint64_t count = read(entry + 4, 4);
+      const unsigned int size = type == 3 ? 2 : 4;
+      const uint64_t values = count * size <= 4 ? entry + 8 : read(entry + 8, 4);
+      if (count == 0 || values + count * size > fileSize)
+        {
+        return false;
+        }
+      if (tag == 273 || tag == 279)
+        {
+        std::vector<uint64_t> &strips = tag == 273 ? stripOffsets : stripBytes;
+        strips.resize(count);
+        for (uint64_t i = 0; i < count; i++)
+          {
+          strips[i] = read(values + i * size, size);
+          }
+        continue;
+        }
+      const uint64_t value = read(values, size);
+      switch (tag)
+        {
+        case 256: width = value; break;
+        case 257: height = value; break;
+        case 258: bits = value; break;
+        case 259: compression = value; break;
+        case 274: orientation = value; break;
+        case 277: samples = value; break;
+        case 322: return false; // tiled
+        default: break;
+        }
+      }
+    if (compression != 1 || samples != 1 || orientation != 1 || bits != 8 * bytesPerPixel ||
+        stripOffsets.empty() || stripOffsets.size() != stripBytes.size())
+      {
+      return false;
+      }
+
+    // Strips of the page one after the other, and the page right after the previous one.
+    uint64_t end = stripOffsets[0];
+    for (size_t s = 0; s < stripOffsets.size(); s++)
+      {
+      if (stripOffsets[s] != end)
+        {
+        return false;
+        }
+      end += stripBytes[s];
+      }
+    if (page == 0)
+      {
+      layout.offset = stripOffsets[0];
+      pageBytes = width * height * bytesPerPixel;
+      if (pageBytes == 0)
+        {
+        return false;
+        }
+      }
+    else if (stripOffsets[0] != nextPage)
+      {
+      return false;
+      }
+    if (end - stripOffsets[0] < pageBytes || width * height * bytesPerPixel != pageBytes)
+      {
+      return false;
+      }
+    nextPage = stripOffsets[0] + pageBytes;
+    ifd = read(ifd + 2 + 12 * numberOfEntries, 4);
+    }
+  return file.good();
+}
+
+#ifdef EPIPROJ_USE_MMAP
+/** Pixel container of a memory mapped file, unmapped with the image. */
+template <typename TPixel>
+class MappedImageContainer : public itk::ImportImageContainer<itk::SizeValueType, TPixel>
+{
+public:
+  ITK_DISALLOW_COPY_AND_ASSIGN(MappedImageContainer);
+
+  using Self = MappedImageContainer;
+  using Superclass = itk::ImportImageContainer<itk::SizeValueType, TPixel>;
+  using Pointer = itk::SmartPointer<Self>;
+
+  itkNewMacro(Self);
+  itkTypeMacro(MappedImageContainer, ImportImageContainer);
+
+  void
+  SetMapping(void *address, size_t length)
+  {
+    m_Address = address;
+    m_Length = length;
+  }
+
+protected:
+  MappedImageContainer() = default;
+  ~MappedImageContainer() override
+  {
+    if (m_Address != nullptr)
+      {
+      munmap(m_Address, m_Length);
+      }
+  }
+
+private:
+  void *m_Address = nullptr;
+  size_t m_Length = 0;
+};
+#endif
+
+/** Volume mapped from an uncompressed file, or nullptr if it has to be read.
+ * The pixel type of the file must be the one of the image, and its byte order
+ * the one of the system. The image information is read with the given
+ * ImageIO, or with a new one if it is null. */
+template <class TImage>
+typename TImage::Pointer
+MapImage(const std::string &fileName, itk::ImageIOBase::Pointer imageIO = nullptr)
+{
+#ifdef EPIPROJ_USE_MMAP
+  using PixelType = typename TImage::PixelType;
+  const unsigned int Dimension = TImage::ImageDimension;
+  try
+    {
+    if (imageIO.IsNull())
+      {
+      imageIO = itk::ImageIOFactory::CreateImageIO(fileName.c_str(), itk::ImageIOFactory::ReadMode);
+      if (imageIO.IsNull())
+        {
+        return nullptr;
+        }
+      imageIO->SetFileName(fileName);
+      imageIO->ReadImageInformation();
+      }
+    }
+  catch (itk::ExceptionObject &)
+    {
+    return nullptr;
+    }
+  if (imageIO->GetNumberOfDimensions() != Dimension || imageIO->GetNumberOfComponents() != 1 ||
+      imageIO->GetComponentType() != itk::ImageIOBase::MapPixelType<PixelType>::CType)
+    {
+    return nullptr;
+    }
+
+  RawLayout layout;
+  const std::string io = imageIO->GetNameOfClass();
+  bool mappable = false;
+  if (io == "MetaImageIO")
+    {
+    mappable = GetMetaImageLayout(fileName, layout);
+    }
+  else if (io == "NrrdImageIO")
+    {
+    mappable = GetNrrdLayout(fileName, layout);
+    }
+  else if (io == "TIFFImageIO")
+    {
+    mappable = GetTIFFLayout(fileName, sizeof(PixelType), layout);
+    }
+  const bool systemBigEndian = itk::ByteSwapper<PixelType>::SystemIsBigEndian();
+  if (!mappable || (sizeof(PixelType) > 1 && layout.bigEndian != systemBigEndian) ||
+      layout.offset % sizeof(PixelType) != 0)
+    {
+    return nullptr;
+    }
+
+  // Map the whole file up to the last pixel, the offset being within the first page.
+  typename TImage::RegionType region;
+  typename TImage::SpacingType spacing;
+  typename TImage::PointType origin;
+  typename TImage::DirectionType direction;
+  for (unsigned int i = 0; i < Dimension; i++)
+    {
+    region.SetSize(i, imageIO->GetDimensions(i));
+    spacing[i] = imageIO->GetSpacing(i);
+    origin[i] = imageIO->GetOrigin(i);
+    for (unsigned int j = 0; j < Dimension; j++)
+      {
+      direction[j][i] = imageIO->GetDirection(i)[j];
+      }
+    }
+  const size_t numberOfPixels = region.GetNumberOfPixels();
+  const size_t length = layout.offset + numberOfPixels * sizeof(PixelType);
+  const int descriptor = open(layout.fileName.c_str(), O_RDONLY);
+  if (descriptor < 0)
+    {
+    return nullptr;
+    }
+  struct stat status;
+  void *address = MAP_FAILED;
+  if (fstat(descriptor, &status) == 0 && static_cast<size_t>(status.st_size) >= length)
+    {
+    // Private mapping, a filter writing in its input would not modify the file.
+    address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+    }
+  close(descriptor);
+  if (address == MAP_FAILED)
+    {
+    return nullptr;
+    }
+  // Tiles and pyramid levels read the planes in any order, so the default read
+  // ahead is kept.
+  madvise(address, length, MADV_NORMAL);
+
+  typename MappedImageContainer<PixelType>::Pointer container = MappedImageContainer<PixelType>::New();
+  container->SetMapping(address, length);
+  container->SetImportPointer(reinterpret_cast<PixelType *>(static_cast<char *>(address) + layout.offset), numberOfPixels, false);
+  typename TImage::Pointer image = TImage::New();
+  image->SetRegions(region);
+  image->SetSpacing(spacing);
+  image->SetOrigin(origin);
+  image->SetDirection(direction);
+  image->SetPixelContainer(container);
+  return image;
+#else
+  (void)fileName;
+  (void)imageIO;
+  return nullptr;
+#endif
+}
+
+#endif // __epiprojMappedImage_h
@@ -0,0 +1,88 @@
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "itkImageFileReader.h"
+#include "itkImageFileWriter.h"
+#include "epiprojMappedImage.h"
+
+/** Number of voxels of the mapped file differing from the read volume, -1 if
+ * the file is not mapped. */
+template <typename TImage>
+long
+CompareMapped(const TImage *volume, const std::string &fileName)
+{
+  typename TImage::Pointer mapped = MapImage<TImage>(fileName);
+  if (mapped.IsNull())
+  {
+    std::cerr << fileName << ": not mapped" << std::endl;
+    return -1;
+  }
+  if (mapped->GetLargestPossibleRegion() != volume->GetLargestPossibleRegion() ||
+      mapped->GetSpacing() != volume->GetSpacing() || mapped->GetOrigin() != volume->GetOrigin())
+  {
+    std::cerr << fileName << ": geometry differs from the read volume" << std::endl;
+    return -1;
+  }
+  long mismatch = 0;
+  const size_t numberOfPixels = volume->GetLargestPossibleRegion().GetNumberOfPixels();
+  for (size_t i = 0; i < numberOfPixels; i++)
+  {
+    mismatch += mapped->GetBufferPointer()[i] != volume->GetBufferPointer()[i] ? 1 : 0;
+  }
+  std::cout << fileName << ": " << mismatch << " mismatching voxels" << std::endl;
+  return mismatch;
+}
+
+/*
+ *  Volume mapped from an uncompressed TIFF stack, and from the MetaImage and
+ *  NRRD files it is written to, compared with the one of ImageFileReader.
+ */
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " InputFileName OutputPrefix" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const std::string prefix = argv[2];
+
+  using ImageType = itk::Image<unsigned char, 3>;
+  using ReaderType = itk::ImageFileReader<ImageType>;
+  using WriterType = itk::ImageFileWriter<ImageType>;
+
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(argv[1]);
+  WriterType::Pointer writer = WriterType::New();
+  writer->SetInput(reader->GetOutput());
+  try
+  {
+    reader->Update();
+    writer->SetFileName(prefix + ".mha");
+    writer->Update();
+    writer->SetFileName(prefix + ".nrrd");
+    writer->Update();
+  }
+  catch (itk::ExceptionObject &excp)
+  {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+  }
+  const ImageType *volume = reader->GetOutput();
+
+  bool failed = false;
+  long mismatch = 0;
+  const std::string fileNames[3] = {argv[1], prefix + ".mha", prefix + ".nrrd"};
+  for (const std::string &fileName : fileNames)
+  {
+    const long fileMismatch = CompareMapped(volume, fileName);
+    failed = failed || fileMismatch < 0;
+    mismatch += std::max(fileMismatch, 0L);
+  }
+
+  return !failed && mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,138 @@
+#ifndef __epiprojProfile_h
+#define __epiprojProfile_h
+
+#include <chrono>
+#include <ctime>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+/*
+ *  Run profile.
+ *  Wall and CPU time, voxels processed and bytes allocated by each stage of an
+ *  executable, and by each stage of each level of the multiscale depth search,
+ *  written as JSON with the peak memory of the process. When disabled, stages
+ *  are neither timed nor recorded.
+ */
+class Profile
+{
+public:
+  /** One stage, times in seconds, level and tile being -1 when not relevant, and
+   * mean band width of the depth search in pixels, 0 for other stages. */
+  struct Stage
+  {
+    std::string name;
+    int level;
+    int tile;
+    double wallTime;
+    double cpuTime;
+    size_t voxels;
+    size_t bytes;
+    double bandWidth;
+  };
+
+  /** Clocks at the start of a stage. */
+  using Clock = std::pair<std::chrono::steady_clock::time_point, std::clock_t>;
+
+  explicit Profile(const std::string &fileName)
+    : m_FileName(fileName)
+  {}
+
+  bool
+  IsEnabled() const
+  {
+    return !m_FileName.empty();
+  }
+
+  Clock
+  Start() const
+  {
+    return IsEnabled() ? Clock(std::chrono::steady_clock::now(), std::clock()) : Clock();
+  }
+
+  void
+  Stop(const Clock &start, const std::string &name, size_t voxels, size_t bytes, int tile = -1)
+  {
+    if (!IsEnabled())
+      {
+      return;
+      }
+    const std::chrono::duration<double> wallTime = std::chrono::steady_clock::now() - start.first;
+    const double cpuTime = static_cast<double>(std::clock() - start.second) / CLOCKS_PER_SEC;
+    m_Stages.push_back({name, -1, tile, wallTime.count(), cpuTime, voxels, bytes, 0});
+  }
+
+  /** Stages of each level recorded by a MultiscaleVolumeToDepthMapFilter. */
+  template <class TFilter>
+  void
+  AddFilterProfile(const TFilter *filter, int tile = -1)
+  {
+    if (!IsEnabled())
+      {
+      return;
+      }
+    for (const auto &stage : filter->GetProfile())
+      {
+      m_Stages.push_back({stage.stage, static_cast<int>(stage.level), tile, stage.wallTime, stage.cpuTime, stage.voxels,
+                          stage.bytes, stage.bandWidth});
+      }
+  }
+
+  /** Peak resident memory of the process in bytes, 0 if unknown. */
+  static size_t
+  GetPeakMemory()
+  {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+      {
+#ifdef __APPLE__
+      return static_cast<size_t>(usage.ru_maxrss);
+#else
+      return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+      }
+#endif
+    return 0;
+  }
+
+  /** Write the JSON profile, if enabled. */
+  bool
+  Write() const
+  {
+    if (!IsEnabled())
+      {
+      return true;
+      }
+    std::ofstream file(m_FileName);
+    if (!file)
+      {
+      return false;
+      }
+    file << "{\n";
+    file << "  \"peak_memory\": " << GetPeakMemory() << ",\n";
+    file << "  \"stages\": [\n";
+    for (size_t i = 0; i < m_Stages.size(); i++)
+      {
+      const Stage &stage = m_Stages[i];
+      file << "    {\"name\": \"" << stage.name << "\", \"level\": " << stage.level << ", \"tile\": " << stage.tile;
+      file << ", \"wall_time\": " << stage.wallTime << ", \"cpu_time\": " << stage.cpuTime;
+      file << ", \"voxels\": " << stage.voxels << ", \"bytes\": " << stage.bytes;
+      file << ", \"band_width\": " << stage.bandWidth << "}";
+      file << (i + 1 < m_Stages.size() ? "," : "") << "\n";
+      }
+    file << "  ]\n";
+    file << "}\n";
+    return file.good();
+  }
+
+private:
+  std::string m_FileName;
+  std::vector<Stage> m_Stages;
+};
+
+#endif // __epiprojProfile_h
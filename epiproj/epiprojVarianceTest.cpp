@@ -0,0 +1,119 @@
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include "itkImageFileReader.h"
+#include "itkConstNeighborhoodIterator.h"
+#include "itkImageRegionIterator.h"
+#include "itkConstantBoundaryCondition.h"
+#include "itkZeroFluxNeumannBoundaryCondition.h"
+#include "itkVarianceImageFilter.h"
+
+/*
+ *  Local variance computed with running sums by VarianceImageFilter, compared
+ *  with the variance summed over the whole neighbourhood of each voxel, as
+ *  before the running sums: edge values outside of the volume, or zero outside
+ *  of the mask.
+ */
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+  {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " InputFileName Radius [RadiusZ] [Mask] [Tolerance]" << std::endl;
+    return EXIT_FAILURE;
+  }
+  const unsigned int radius = std::atoi(argv[2]);
+  const unsigned int radiusZ = argc >= 4 ? std::atoi(argv[3]) : 0;
+  const bool masked = argc >= 5 && std::atoi(argv[4]) != 0;
+  const double tolerance = argc >= 6 ? std::atof(argv[5]) : 1e-4;
+
+  using InputImageType = itk::Image<unsigned char, 3>;
+  using VarianceImageType = itk::Image<float, 3>;
+  using ReaderType = itk::ImageFileReader<InputImageType>;
+  using VarianceFilterType = itk::VarianceImageFilter<InputImageType, VarianceImageType>;
+  using NeighborhoodIteratorType = itk::ConstNeighborhoodIterator<InputImageType>;
+
+  ReaderType::Pointer reader = ReaderType::New();
+  reader->SetFileName(argv[1]);
+  InputImageType::SizeType kernel;
+  kernel[0] = radius;
+  kernel[1] = radius;
+  kernel[2] = radiusZ;
+  VarianceFilterType::Pointer varianceFilter = VarianceFilterType::New();
+  varianceFilter->SetInput(reader->GetOutput());
+  varianceFilter->SetRadius(kernel);
+  try
+  {
+    reader->Update();
+    if (masked)
+    {
+      // The volume is its own mask, its zero voxels being excluded.
+      varianceFilter->SetMask(reader->GetOutput());
+    }
+    varianceFilter->Update();
+  }
+  catch (itk::ExceptionObject &excp)
+  {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+  }
+  const InputImageType *input = reader->GetOutput();
+  const InputImageType::RegionType region = input->GetLargestPossibleRegion();
+
+  // Baseline variance, summing every voxel of the neighbourhood.
+  itk::ZeroFluxNeumannBoundaryCondition<InputImageType> edgeCondition;
+  itk::ConstantBoundaryCondition<InputImageType> zeroCondition;
+  zeroCondition.SetConstant(0);
+  NeighborhoodIteratorType neighborhoodIte(kernel, input, region);
+  if (masked)
+  {
+    neighborhoodIte.OverrideBoundaryCondition(&zeroCondition);
+  }
+  else
+  {
+    neighborhoodIte.OverrideBoundaryCondition(&edgeCondition);
+  }
+  itk::ImageRegionConstIterator<VarianceImageType> varianceIte(varianceFilter->GetOutput(), region);
+  const unsigned int neighborhoodSize = neighborhoodIte.Size();
+
+  unsigned long mismatch = 0;
+  double maximumDifference = 0;
+  for (; !neighborhoodIte.IsAtEnd(); ++neighborhoodIte, ++varianceIte)
+  {
+    double sum = 0;
+    double sumOfSquares = 0;
+    double count = 0;
+    if (!masked || neighborhoodIte.GetCenterPixel() != 0)
+    {
+      for (unsigned int i = 0; i < neighborhoodSize; i++)
+      {
+        const double value = neighborhoodIte.GetPixel(i);
+        if (!masked || value != 0)
+        {
+          sum += value;
+          sumOfSquares += value * value;
+          count++;
+        }
+      }
+    }
+    double variance = 0;
+    if (count > 0)
+    {
+      const double mean = sum / count;
+      variance = sumOfSquares / count - mean * mean;
+    }
+
+    // Relative difference, absolute below 1.
+    const double difference = std::abs(varianceIte.Get() - variance) / std::max(1.0, std::abs(variance));
+    maximumDifference = std::max(maximumDifference, difference);
+    mismatch += difference > tolerance ? 1 : 0;
+  }
+  std::cout << "Mismatching voxels: " << mismatch << ", maximum relative difference: " << maximumDifference
+            << std::endl;
+
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -21,6 +21,8 @@
 #include "itkImage.h"
 #include "itkNumericTraits.h"
 
+#include <vector>
+
 namespace itk
 {
 /** \class VarianceImageFilter
@@ -31,6 +33,12 @@ namespace itk
  * input pixel. Zero pixels can be excluded by setting a mask with SetMask(). 
  * The mask is assumed to be of the same size as the input image.
  *
+ * The sum and the sum of squares of the neighborhood are computed with
+ * running sums, separably along each dimension, and accumulated in double.
+ * The cost per pixel does not depend on the radius. Planes along the last
+ * dimension are summed one at a time, only the sums of the planes covered
+ * by the radius along the last dimension are kept in memory.
+ *
  * \sa Image
  * \sa Neighborhood
  * \sa NeighborhoodOperator
@@ -111,16 +119,22 @@ protected:
   void PrintSelf(std::ostream& os, Indent indent) const ITK_OVERRIDE;
 
   /** VarianceImageFilter can be implemented as a multithreaded filter.
-   * Therefore, this implementation provides a ThreadedGenerateData()
-   * routine which is called for each processing thread. The output
+   * Therefore, this implementation provides a DynamicThreadedGenerateData()
+   * routine which is called for each region of the output. The output
    * image data is allocated automatically by the superclass prior to
-   * calling ThreadedGenerateData().  ThreadedGenerateData can only
-   * write to the portion of the output image specified by the
+   * calling DynamicThreadedGenerateData().  DynamicThreadedGenerateData can
+   * only write to the portion of the output image specified by the
    * parameter "outputRegionForThread"
    *
-   * \sa ImageToImageFilter::ThreadedGenerateData(),
+   * \sa ImageToImageFilter::DynamicThreadedGenerateData(),
    *     ImageToImageFilter::GenerateData() */
-  virtual void ThreadedGenerateData(const OutputImageRegionType& outputRegionForThread, ThreadIdType threadId) ITK_OVERRIDE;
+  virtual void DynamicThreadedGenerateData(const OutputImageRegionType& outputRegionForThread) ITK_OVERRIDE;
+
+  /** Box sum, in place, of the lines along dimension d of a buffer of the
+   * given size. Outside the buffer, lines are extended with their edge value
+   * (replicate) or with zero. */
+  void BoxSumAlongDimension(std::vector<double>& buffer, const InputSizeType& size,
+                            unsigned int d, bool replicate) const;
 
 private:
   VarianceImageFilter(const Self&); //purposely not implemented
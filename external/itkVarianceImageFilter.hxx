@@ -19,15 +19,12 @@
 
 #include "itkVarianceImageFilter.h"
 
-#include "itkConstNeighborhoodIterator.h"
-#include "itkNeighborhoodInnerProduct.h"
+#include "itkImageRegionConstIterator.h"
 #include "itkImageRegionIterator.h"
-#include "itkNeighborhoodAlgorithm.h"
-#include "itkZeroFluxNeumannBoundaryCondition.h"
-#include "itkConstantBoundaryCondition.h"
-#include "itkOffset.h"
 #include "itkProgressReporter.h"
 
+#include <algorithm>
+
 namespace itk
 {
 
@@ -35,7 +32,6 @@ template <class TInputImage, class TOutputImage>
 VarianceImageFilter<TInputImage, TOutputImage>
 ::VarianceImageFilter()
 {
-  this->DynamicMultiThreadingOff();
   m_Radius.Fill(1);
   m_Mask = NULL;
 }
@@ -90,121 +86,230 @@ VarianceImageFilter<TInputImage, TOutputImage>
 }
 
 
+template <class TInputImage, class TOutputImage>
+void
+VarianceImageFilter<TInputImage, TOutputImage>
+::BoxSumAlongDimension(std::vector<double>& buffer, const InputSizeType& size,
+                       unsigned int d, bool replicate) const
+{
+  const long radius = static_cast<long>(m_Radius[d]);
+  const long length = static_cast<long>(size[d]);
+  if ( radius == 0 || length == 0 )
+    {
+    return;
+    }
+
+  SizeValueType stride = 1;
+  for (unsigned int j = 0; j < d; ++j)
+    {
+    stride *= size[j];
+    }
+  const SizeValueType numberOfLines = buffer.size() / length;
+
+  std::vector<double> line(length);
+  for (SizeValueType l = 0; l < numberOfLines; ++l)
+    {
+    const SizeValueType start = (l / stride) * stride * length + l % stride;
+    for (long i = 0; i < length; ++i)
+      {
+      line[i] = buffer[start + i * stride];
+      }
+
+    // Value of the line at position i, extended outside of the buffer.
+    auto value = [&](long i) -> double
+      {
+      if ( i < 0 || i >= length )
+        {
+        return replicate ? line[std::min(std::max(i, 0L), length - 1)] : 0.0;
+        }
+      return line[i];
+      };
+
+    // Slide the window along the line, one value in and one value out.
+    double sum = 0;
+    for (long i = -radius; i <= radius; ++i)
+      {
+      sum += value(i);
+      }
+    buffer[start] = sum;
+    for (long i = 1; i < length; ++i)
+      {
+      sum += value(i + radius) - value(i - radius - 1);
+      buffer[start + i * stride] = sum;
+      }
+    }
+}
+
 template< class TInputImage, class TOutputImage>
 void
 VarianceImageFilter< TInputImage, TOutputImage>
-::ThreadedGenerateData(const OutputImageRegionType& outputRegionForThread, ThreadIdType threadId)
+::DynamicThreadedGenerateData(const OutputImageRegionType& outputRegionForThread)
 {
-  unsigned int i;
-  ConstantBoundaryCondition<InputImageType> nbc;
-  nbc.SetConstant(0);
+  const unsigned int last = InputImageDimension - 1;
+  const bool masked = m_Mask.IsNotNull();
+  const unsigned int numberOfChannels = masked ? 3 : 2;
 
-  ZeroFluxNeumannBoundaryCondition<InputImageType> zbc;
-  
-  ConstNeighborhoodIterator<InputImageType> bit;
-  ImageRegionIterator<OutputImageType> it;
-  
-  ConstNeighborhoodIterator<InputImageType> bit2;
-  ImageRegionIterator<OutputImageType> it2;
-  
-  // Allocate output
   typename OutputImageType::Pointer output = this->GetOutput();
   typename  InputImageType::ConstPointer input  = this->GetInput();
-  
-  // Find the data-set boundary "faces"
-  typename NeighborhoodAlgorithm::ImageBoundaryFacesCalculator<InputImageType>::FaceListType faceList;
-  NeighborhoodAlgorithm::ImageBoundaryFacesCalculator<InputImageType> bC;
-  faceList = bC(input, outputRegionForThread, m_Radius);
-
-  typename NeighborhoodAlgorithm::ImageBoundaryFacesCalculator<InputImageType>::FaceListType::iterator fit;
 
   // support progress methods/callbacks
-  ProgressReporter progress(this, threadId, outputRegionForThread.GetNumberOfPixels());
-  
-  InputRealType value;
-  InputRealType sum;
-  InputRealType mean;
-  InputRealType sumOfSquares;
-  InputRealType var;
-  InputRealType num;
-
-  // Process each of the boundary faces.  These are N-d regions which border
-  // the edge of the buffer.
-  for (fit=faceList.begin(); fit != faceList.end(); ++fit)
-    { 
-    if(m_Mask.IsNotNull())
-      {    
-      bit = ConstNeighborhoodIterator<InputImageType>(m_Radius, m_Mask, *fit);
-      unsigned int neighborhoodSize = bit.Size();
-      bit.OverrideBoundaryCondition(&nbc);
-      bit.GoToBegin();
-      
-      it = ImageRegionIterator<OutputImageType>(output, *fit);
-      it.GoToBegin();
-      while ( ! bit.IsAtEnd() )
-        {
-         sum = NumericTraits<InputRealType>::Zero;
-         sumOfSquares = NumericTraits<InputRealType>::Zero;
-         num = 0;
-      
-         if(bit.GetPixel(0) != 0) 
-           {
-           for (i = 0; i < neighborhoodSize; ++i)
-            { 
-            if(bit.GetPixel(i) != 0)
-              {         
-              value = static_cast<InputRealType>( input->GetPixel(bit.GetIndex(i)) );
-              sum += value;
-              sumOfSquares += (value*value);
-              ++num;
-              }
-            }
-          }
-        // calculate the variance value
-        if(num < 1) 
-          var = 0;
+  ProgressReporter progress(this, this->GetNumberOfWorkUnits(), outputRegionForThread.GetNumberOfPixels());
+
+  // Outside of the buffered pixels, the input is extended with its edge
+  // values, and the mask with zero.
+  InputImageRegionType bufferedRegion = input->GetBufferedRegion();
+  if ( masked )
+    {
+    bufferedRegion.Crop( m_Mask->GetBufferedRegion() );
+    }
+
+  // One plane of the output region, and the input plane covering its
+  // neighborhood along the other dimensions.
+  InputImageRegionType outputPlane( outputRegionForThread.GetIndex(), outputRegionForThread.GetSize() );
+  outputPlane.SetSize( last, 1 );
+  InputSizeType planeRadius = m_Radius;
+  planeRadius[last] = 0;
+  InputImageRegionType planeRegion = outputPlane;
+  planeRegion.PadByRadius( planeRadius );
+  planeRegion.SetIndex( last, bufferedRegion.GetIndex(last) );
+  planeRegion.Crop( bufferedRegion );
+  const InputSizeType planeSize = planeRegion.GetSize();
+  const SizeValueType numberOfPlanePixels = planeRegion.GetNumberOfPixels();
+  const SizeValueType numberOfOutputPixels = outputPlane.GetNumberOfPixels();
 
-        else
+  // Offset in the input plane of each pixel of the output plane.
+  std::vector<SizeValueType> outputOffsets(numberOfOutputPixels);
+  for (SizeValueType j = 0; j < numberOfOutputPixels; ++j)
+    {
+    SizeValueType remainder = j;
+    SizeValueType offset = 0;
+    SizeValueType stride = 1;
+    for (unsigned int d = 0; d < last; ++d)
+      {
+      const SizeValueType position = remainder % outputPlane.GetSize(d);
+      remainder /= outputPlane.GetSize(d);
+      offset += (outputPlane.GetIndex(d) + position - planeRegion.GetIndex(d)) * stride;
+      stride *= planeSize[d];
+      }
+    outputOffsets[j] = offset;
+    }
+
+  // Sum of the values, of their squares, and count of the masked pixels.
+  // Planes are summed along the other dimensions one at a time, the sums of
+  // the planes inside the neighborhood along the last dimension are kept in
+  // a ring to slide the neighborhood along the last dimension.
+  const IndexValueType radius = static_cast<IndexValueType>(m_Radius[last]);
+  const IndexValueType window = 2 * radius + 1;
+  std::vector< std::vector<double> > plane( numberOfChannels, std::vector<double>(numberOfPlanePixels) );
+  std::vector< std::vector<double> > ring( numberOfChannels, std::vector<double>(window * numberOfOutputPixels) );
+  std::vector< std::vector<double> > sum( numberOfChannels, std::vector<double>(numberOfOutputPixels, 0) );
+
+  double neighborhoodSize = 1;
+  for (unsigned int d = 0; d < InputImageDimension; ++d)
+    {
+    neighborhoodSize *= 2 * m_Radius[d] + 1;
+    }
+
+  const IndexValueType bufferBegin = bufferedRegion.GetIndex(last);
+  const IndexValueType bufferEnd = bufferBegin + static_cast<IndexValueType>(bufferedRegion.GetSize(last));
+  const IndexValueType begin = outputRegionForThread.GetIndex(last) - radius;
+  const IndexValueType end = outputRegionForThread.GetIndex(last) + static_cast<IndexValueType>(outputRegionForThread.GetSize(last)) + radius;
+  for (IndexValueType k = begin; k < end; ++k)
+    {
+    const SizeValueType slot = (k - begin) % window;
+    if ( k - begin >= window )
+      {
+      for (unsigned int c = 0; c < numberOfChannels; ++c)
+        {
+        for (SizeValueType j = 0; j < numberOfOutputPixels; ++j)
           {
-          mean = sum/num;
-          var = (sumOfSquares/num) - (mean*mean);
+          sum[c][j] -= ring[c][slot * numberOfOutputPixels + j];
           }
-        it.Set( static_cast<OutputPixelType>(var) );
-      
-        ++bit;
-        ++it;
-        progress.CompletedPixel();
+        }
+      }
+
+    if ( masked && ( k < bufferBegin || k >= bufferEnd ) )
+      {
+      for (unsigned int c = 0; c < numberOfChannels; ++c)
+        {
+        std::fill( ring[c].begin() + slot * numberOfOutputPixels, ring[c].begin() + (slot + 1) * numberOfOutputPixels, 0.0 );
         }
       }
     else
       {
-      bit2 = ConstNeighborhoodIterator<InputImageType>(m_Radius, input, *fit);
-      unsigned int neighborhoodSize = bit2.Size();
-      num = neighborhoodSize;
-      bit2.OverrideBoundaryCondition(&zbc);
-      bit2.GoToBegin();
-      
-      it2 = ImageRegionIterator<OutputImageType>(output, *fit);
-      it2.GoToBegin();
-      while ( ! bit2.IsAtEnd() )
+      planeRegion.SetIndex( last, std::min( std::max(k, bufferBegin), bufferEnd - 1 ) );
+      ImageRegionConstIterator<InputImageType> inputIt( input, planeRegion );
+      ImageRegionConstIterator<InputImageType> maskIt;
+      if ( masked )
+        {
+        maskIt = ImageRegionConstIterator<InputImageType>( m_Mask, planeRegion );
+        }
+      for (SizeValueType i = 0; !inputIt.IsAtEnd(); ++inputIt, ++i)
+        {
+        const double value = static_cast<double>( inputIt.Get() );
+        double weight = 1;
+        if ( masked )
+          {
+          weight = ( maskIt.Get() != 0 ) ? 1 : 0;
+          plane[2][i] = weight;
+          ++maskIt;
+          }
+        plane[0][i] = weight * value;
+        plane[1][i] = weight * value * value;
+        }
+      for (unsigned int c = 0; c < numberOfChannels; ++c)
         {
-        sum = NumericTraits<InputRealType>::Zero;
-        sumOfSquares = NumericTraits<InputRealType>::Zero;
-        for (i = 0; i < neighborhoodSize; ++i)
-          {          
-          value = static_cast<InputRealType>( bit2.GetPixel(i) );
-          sum += value;
-          sumOfSquares += (value*value);
+        for (unsigned int d = 0; d < last; ++d)
+          {
+          this->BoxSumAlongDimension( plane[c], planeSize, d, !masked );
           }
-        // calculate the variance value
-        mean = sum/num;
-        var = (sumOfSquares/num) - (mean*mean);
-        it2.Set( static_cast<OutputPixelType>(var) );
-      
-        ++bit2;
-        ++it2;
-        progress.CompletedPixel();
+        for (SizeValueType j = 0; j < numberOfOutputPixels; ++j)
+          {
+          ring[c][slot * numberOfOutputPixels + j] = plane[c][outputOffsets[j]];
+          }
+        }
+      }
+
+    for (unsigned int c = 0; c < numberOfChannels; ++c)
+      {
+      for (SizeValueType j = 0; j < numberOfOutputPixels; ++j)
+        {
+        sum[c][j] += ring[c][slot * numberOfOutputPixels + j];
+        }
+      }
+
+    // The neighborhood of the plane k - radius is complete.
+    if ( k - begin < window - 1 )
+      {
+      continue;
+      }
+    OutputImageRegionType outputSlice = outputRegionForThread;
+    outputSlice.SetIndex( last, k - radius );
+    outputSlice.SetSize( last, 1 );
+    ImageRegionIterator<OutputImageType> outputIt( output, outputSlice );
+    outputPlane.SetIndex( last, k - radius );
+    ImageRegionConstIterator<InputImageType> centerIt;
+    if ( masked )
+      {
+      centerIt = ImageRegionConstIterator<InputImageType>( m_Mask, outputPlane );
+      }
+    for (SizeValueType j = 0; !outputIt.IsAtEnd(); ++outputIt, ++j)
+      {
+      double num = neighborhoodSize;
+      if ( masked )
+        {
+        num = ( centerIt.Get() != 0 ) ? sum[2][j] : 0;
+        ++centerIt;
+        }
+      // calculate the variance value
+      double var = 0;
+      if ( num >= 1 )
+        {
+        const double mean = sum[0][j] / num;
+        var = std::max( sum[1][j] / num - mean * mean, 0.0 );
         }
+      outputIt.Set( static_cast<OutputPixelType>(var) );
+      progress.CompletedPixel();
       }
     }
 }
@@ -2,6 +2,7 @@
 #define __itkDepthMapProjectionFilter_h
 
 #include "itkImageToImageFilter.h"
+#include "itkDepthMapProjectionReducer.h"
 
 namespace itk
 {
@@ -12,6 +13,27 @@ namespace itk
  * Filter that project a volume intensity along a dimension (default 3rd)
  * using a provided depth map. The filter allows multiple projection type.
  *
+ * Each output pixel is the reduction of the band [depth - Range[0], depth + Range[1]]
+ * of its column, depth being the value of the map plus the shift. The projection
+ * Type is the maximum (max), minimum (min), sum (sum), mean (avg), standard
+ * deviation (std), median (median) or the mean weighted by a Gaussian of sigma
+ * Sigma around the depth of the map (gauss). The Type is resolved once per run
+ * to a reducer policy of DepthMapProjectionReducer, the projection loop being
+ * instantiated per reducer. When the columns are contiguous in memory, i.e.
+ * the projection dimension is not the first one, max, sum and avg run row by
+ * row with the vectorised row policies.
+ *
+ * Channels acquired with the input, e.g. other fluorescence channels, can be
+ * projected along the same map in the same pass: channel i, 0 being the
+ * input, is projected in output i, the band of each column being computed
+ * once for all of them. All channels must have the size of the input.
+ *
+ * With a non zero MedianRadius, the projection reads the median of the
+ * neighbourhood of each voxel instead of the voxel, as after a
+ * MedianImageFilter of that radius, the neighbourhood being clamped to the
+ * volume. The median is only computed for the voxels of the bands, so that
+ * with a narrow band most of the cost of a full median filter is avoided.
+ *
  * \author Stephane U. Rigaud (stephane.rigaud@pasteur.fr)
  */  
 template <class TInputImage, class TMapImage, class TOutputImage>
@@ -78,13 +100,18 @@ public:
   using OutputIndexValueType = typename OutputImageType::IndexValueType;
 
   using ArrayType = FixedArray<int, 2>;
+  using DepthType = DepthMapProjectionReducer::DepthType;
 
   itkSetMacro(Range, ArrayType);
   itkSetMacro(Shift, int);
+  itkSetMacro(Sigma, float);
+  itkSetMacro(MedianRadius, InputSizeType);
   itkSetStringMacro(Type);
 
   itkGetMacro(Range, ArrayType);
   itkGetMacro(Shift, int);
+  itkGetMacro(Sigma, float);
+  itkGetConstReferenceMacro(MedianRadius, InputSizeType);
   itkGetStringMacro(Type);
 
   itkGetConstReferenceMacro(ProjectionDimension, unsigned int);
@@ -94,6 +121,11 @@ public:
   itkSetInputMacro(Map, MapImageType);
   itkGetInputMacro(Map, MapImageType);
 
+  /** Channel projected in the output of the same number, channel 0 being the input. **/
+  void SetChannel(unsigned int channel, const InputImageType *image);
+  const InputImageType *GetChannel(unsigned int channel) const;
+  unsigned int GetNumberOfChannels() const;
+
 protected:
   DepthMapProjectionFilter();
   ~DepthMapProjectionFilter() override = default;
@@ -102,14 +134,35 @@ protected:
   void GenerateOutputInformation() override;
   void GenerateInputRequestedRegion() override;
 
+  /** Resolve the projection type to its reducer. */
+  void BeforeThreadedGenerateData() override;
+
   /** Does the real work. */
   void DynamicThreadedGenerateData(const OutputRegionType &) override;
 
+  /** Projection loops, instantiated per reducer, called by DynamicThreadedGenerateData. **/
+  template <class TReducer>
+  void ColumnGenerateData(const OutputRegionType &);
+  template <class TRowReducer>
+  void RowGenerateData(const OutputRegionType &);
+
+  /** Depth of the map plus the shift, and the band around it clamped to the volume. **/
+  void GetBand(const OutputIndexType &outputIndex, DepthType &centerDepth, DepthType &highDepth, DepthType &lowDepth) const;
+
+  /** Input index of an output pixel at a given depth of its column. **/
+  InputIndexType GetInputIndex(const OutputIndexType &outputIndex, DepthType depth) const;
+
+  /** Median of the MedianRadius neighbourhood of a voxel of a channel, in a buffer reused between calls. **/
+  InputPixelType GetMedian(const InputImageType *channel, const InputIndexType &index,
+                           std::vector<InputPixelType> &neighbourhood) const;
+
 private:
   float m_Sigma;
+  InputSizeType m_MedianRadius;
   ArrayType m_Range;
   int m_Shift;
   std::string m_Type;
+  DepthMapProjectionReducer::ReducerType m_Reducer;
   unsigned int m_ProjectionDimension;
 };
 
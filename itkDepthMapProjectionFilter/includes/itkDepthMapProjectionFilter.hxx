@@ -2,7 +2,8 @@
 #define __itkDepthMapProjectionFilter_hxx
 
 #include "itkDepthMapProjectionFilter.h"
-#include "itkImageLinearConstIteratorWithIndex.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageScanlineConstIterator.h"
 
 #include "itkProgressReporter.h"
 
@@ -19,9 +20,57 @@ DepthMapProjectionFilter<TInputImage, TMapImage, TOutputImage>
   m_Range.Fill(1);
   m_Shift = 0;
   m_Type = "max";
+  m_Sigma = 1.0;
+  m_MedianRadius.Fill(0);
+  m_Reducer = DepthMapProjectionReducer::Max;
   m_ProjectionDimension = InputImageDimension - 1;
 }
 
+template <class TInputImage, class TMapImage, class TOutputImage>
+void 
+DepthMapProjectionFilter<TInputImage, TMapImage, TOutputImage>
+::SetChannel(unsigned int channel, const InputImageType *image)
+{
+  if (channel == 0)
+    {
+    this->SetInput(image);
+    return;
+    }
+  // Channels follow the input and the map, each one with its own output.
+  this->ProcessObject::SetNthInput(channel + 1, const_cast<InputImageType *>(image));
+  if (this->GetNumberOfIndexedOutputs() < channel + 1)
+    {
+    this->SetNumberOfRequiredOutputs(channel + 1);
+    for (unsigned int c = 1; c <= channel; c++)
+      {
+      if (this->ProcessObject::GetOutput(c) == nullptr)
+        {
+        this->ProcessObject::SetNthOutput(c, this->MakeOutput(c));
+        }
+      }
+    }
+}
+
+template <class TInputImage, class TMapImage, class TOutputImage>
+const TInputImage *
+DepthMapProjectionFilter<TInputImage, TMapImage, TOutputImage>
+::GetChannel(unsigned int channel) const
+{
+  if (channel == 0)
+    {
+    return this->GetInput();
+    }
+  return itkDynamicCastInDebugMode<const InputImageType *>(this->ProcessObject::GetInput(channel + 1));
+}
+
+template <class TInputImage, class TMapImage, class TOutputImage>
+unsigned int
+DepthMapProjectionFilter<TInputImage, TMapImage, TOutputImage>
+::GetNumberOfChannels() const
+{
+  return std::max<unsigned int>(this->GetNumberOfIndexedInputs(), 2) - 1;
+}
+
 template <class TInputImage, class TMapImage, class TOutputImage>
 void 
 DepthMapProjectionFilter<TInputImage, TMapImage, TOutputImage>
@@ -100,6 +149,17 @@ DepthMapProjectionFilter<TInputImage, TMapImage, TOutputImage>
   output->SetOrigin(outputOrigin);
   output->SetSpacing(outputSpacing);
   output->SetLargestPossibleRegion(outputRegion);
+
+  // Every channel is projected on the same grid as the input.
+  for (unsigned int c = 1; c < this->GetNumberOfChannels(); c++)
+    {
+    const InputImageType *channel = this->GetChannel(c);
+    if (channel == nullptr || channel->GetLargestPossibleRegion() != input->GetLargestPossibleRegion())
+      {
+      itkExceptionMacro(<< "Channel " << c << " is missing or does not have the size of the input");
+      }
+    this->GetOutput(c)->CopyInformation(output);
+    }
 }
 
 template <class TInputImage, class TMapImage, class TOutputImage>
@@ -164,148 +224,337 @@ DepthMapProjectionFilter<TInputImage, TMapImage, TOutputImage>
       inputIndex[m_ProjectionDimension] = inputLargeIndex[m_ProjectionDimension];
       }
 
+    // The median reads around the columns.
     InputRegionType RequestedRegion;
     RequestedRegion.SetSize(inputSize);
     RequestedRegion.SetIndex(inputIndex);
-    InputImagePointer input = const_cast<InputImageType *>(this->GetInput());
-    input->SetRequestedRegion(RequestedRegion);
+    RequestedRegion.PadByRadius(m_MedianRadius);
+    RequestedRegion.Crop(this->GetInput()->GetLargestPossibleRegion());
+    for (unsigned int c = 0; c < this->GetNumberOfChannels(); c++)
+      {
+      InputImagePointer input = const_cast<InputImageType *>(this->GetChannel(c));
+      input->SetRequestedRegion(RequestedRegion);
+      }
     }
 }
 
 template <class TInputImage, class TMapImage, class TOutputImage>
 void 
 DepthMapProjectionFilter<TInputImage, TMapImage, TOutputImage>
-::DynamicThreadedGenerateData(const OutputRegionType &outputRegionForThread)
+::BeforeThreadedGenerateData()
 {
-  // Use the output image to report the progress.
-  ProgressReporter progress(this, this->GetNumberOfWorkUnits(), outputRegionForThread.GetNumberOfPixels());
+  if (!DepthMapProjectionReducer::GetReducerType(m_Type, m_Reducer))
+    {
+    itkExceptionMacro(<< "Invalid projection Type " << m_Type
+                      << ", expected max, min, sum, avg, std, median or gauss");
+    }
+}
 
-  // Get some values, to simplify future manipulation.
-  InputImageConstPointer input = this->GetInput();
-  InputRegionType inputRegion = input->GetLargestPossibleRegion();
-  InputSizeType inputSize = inputRegion.GetSize();
-  InputIndexType inputIndex = inputRegion.GetIndex();
+template <class TInputImage, class TMapImage, class TOutputImage>
+void 
+DepthMapProjectionFilter<TInputImage, TMapImage, TOutputImage>
+::GetBand(const OutputIndexType &outputIndex, DepthType &centerDepth, DepthType &highDepth, DepthType &lowDepth) const
+{
+  const DepthType projectionSize = this->GetInput()->GetLargestPossibleRegion().GetSize()[m_ProjectionDimension];
+  MapIndexType mapIndex;
+  for (size_t i = 0; i < OutputImageDimension; i++)
+    {
+    mapIndex[i] = outputIndex[i];
+    }
+  centerDepth = this->GetMap()->GetPixel(mapIndex) + m_Shift;
+  highDepth = centerDepth - m_Range[0];
+  highDepth = std::max<DepthType>(highDepth, 0);
+  highDepth = std::min<DepthType>(highDepth, projectionSize - 1);
+  lowDepth = centerDepth + m_Range[1];
+  lowDepth = std::max<DepthType>(lowDepth, 0);
+  lowDepth = std::min<DepthType>(lowDepth, projectionSize - 1);
+}
 
-  OutputImagePointer output = this->GetOutput();
-  OutputRegionType outputRegion = output->GetLargestPossibleRegion();
-  OutputSizeType outputSizeForThread = outputRegionForThread.GetSize();
-  OutputIndexType outputIndexForThread = outputRegionForThread.GetIndex();
-
-  MapImageConstPointer map = this->GetMap();
-  MapRegionType mapRegion = map->GetLargestPossibleRegion();
-  MapSizeType mapSize = mapRegion.GetSize();
-  MapIndexType mapIndex = mapRegion.GetIndex();
-
-  // Compute the input region for this thread.
-  InputRegionType inputRegionForThread = inputRegion;
-  InputSizeType inputSizeForThread = inputSize;
-  InputIndexType inputIndexForThread = inputIndex;
-  if (static_cast<unsigned int>(InputImageDimension) == static_cast<unsigned int>(OutputImageDimension))
+template <class TInputImage, class TMapImage, class TOutputImage>
+typename TInputImage::IndexType
+DepthMapProjectionFilter<TInputImage, TMapImage, TOutputImage>
+::GetInputIndex(const OutputIndexType &outputIndex, DepthType depth) const
+{
+  InputIndexType inputIndex;
+  for (size_t i = 0; i < OutputImageDimension; i++)
     {
-    for (size_t i = 0; i < InputImageDimension; i++)
+    if (i != m_ProjectionDimension)
       {
-      if (i != m_ProjectionDimension)
+      inputIndex[i] = outputIndex[i];
+      }
+    else if (static_cast<unsigned int>(InputImageDimension) != static_cast<unsigned int>(OutputImageDimension))
+      {
+      inputIndex[InputImageDimension - 1] = outputIndex[i];
+      }
+    }
+  inputIndex[m_ProjectionDimension] = this->GetInput()->GetLargestPossibleRegion().GetIndex()[m_ProjectionDimension] + depth;
+  return inputIndex;
+}
+
+template <class TInputImage, class TMapImage, class TOutputImage>
+typename TInputImage::PixelType
+DepthMapProjectionFilter<TInputImage, TMapImage, TOutputImage>
+::GetMedian(const InputImageType *channel, const InputIndexType &index, std::vector<InputPixelType> &neighbourhood) const
+{
+  const InputRegionType region = channel->GetLargestPossibleRegion();
+  const InputIndexType bufferIndex = channel->GetBufferedRegion().GetIndex();
+  const OffsetValueType *offsetTable = channel->GetOffsetTable();
+  const InputPixelType *buffer = channel->GetBufferPointer();
+
+  // Neighbourhood clamped to the volume, as the zero flux Neumann boundary of MedianImageFilter.
+  neighbourhood.clear();
+  OffsetValueType position[InputImageDimension];
+  for (unsigned int d = 0; d < InputImageDimension; d++)
+    {
+    position[d] = -static_cast<OffsetValueType>(m_MedianRadius[d]);
+    }
+  while (true)
+    {
+    OffsetValueType offset = 0;
+    for (unsigned int d = 0; d < InputImageDimension; d++)
+      {
+      OffsetValueType i = index[d] + position[d];
+      i = std::max<OffsetValueType>(i, region.GetIndex(d));
+      i = std::min<OffsetValueType>(i, region.GetIndex(d) + static_cast<OffsetValueType>(region.GetSize(d)) - 1);
+      offset += (i - bufferIndex[d]) * offsetTable[d];
+      }
+    neighbourhood.push_back(buffer[offset]);
+
+    unsigned int d = 0;
+    for (; d < InputImageDimension; d++)
+      {
+      if (++position[d] <= static_cast<OffsetValueType>(m_MedianRadius[d]))
         {
-        inputSizeForThread[i] = outputSizeForThread[i];
-        inputIndexForThread[i] = outputIndexForThread[i];
+        break;
         }
+      position[d] = -static_cast<OffsetValueType>(m_MedianRadius[d]);
+      }
+    if (d == InputImageDimension)
+      {
+      break;
       }
     }
-  else
+
+  const auto median = neighbourhood.begin() + neighbourhood.size() / 2;
+  std::nth_element(neighbourhood.begin(), median, neighbourhood.end());
+  return *median;
+}
+
+template <class TInputImage, class TMapImage, class TOutputImage>
+void 
+DepthMapProjectionFilter<TInputImage, TMapImage, TOutputImage>
+::DynamicThreadedGenerateData(const OutputRegionType &outputRegionForThread)
+{
+  using namespace DepthMapProjectionReducer;
+
+  // Rows along the first dimension are adjacent columns, unless it is projected,
+  // or unless each voxel is replaced by its median.
+  bool median = false;
+  for (unsigned int d = 0; d < InputImageDimension; d++)
     {
-    for (size_t i = 0; i < OutputImageDimension; i++)
-      {
-      if (i != m_ProjectionDimension)
+    median = median || m_MedianRadius[d] > 0;
+    }
+  const bool rowByRow = m_ProjectionDimension != 0 && !median;
+  switch (m_Reducer)
+    {
+    case Max:
+      if (rowByRow)
         {
-        inputSizeForThread[i] = outputSizeForThread[i];
-        inputIndexForThread[i] = outputIndexForThread[i];
+        this->template RowGenerateData<MaxRowReducer<InputPixelType>>(outputRegionForThread);
         }
       else
         {
-        inputSizeForThread[InputImageDimension - 1] = outputSizeForThread[i];
-        inputIndexForThread[InputImageDimension - 1] = outputIndexForThread[i];
+        this->template ColumnGenerateData<MaxReducer<InputPixelType>>(outputRegionForThread);
         }
-      }
-    inputSizeForThread[m_ProjectionDimension] = inputSize[m_ProjectionDimension];
-    inputIndexForThread[m_ProjectionDimension] = inputIndex[m_ProjectionDimension];
-    }
-  inputRegionForThread.SetSize(inputSizeForThread);
-  inputRegionForThread.SetIndex(inputIndexForThread);
-  SizeValueType projectionSize = inputSize[m_ProjectionDimension];
-
-  // we define an iterator
-  using InputIteratorType = ImageLinearConstIteratorWithIndex<InputImageType>;
-  InputIteratorType inputIte(input, inputRegionForThread);
-  inputIte.SetDirection(m_ProjectionDimension);
-  inputIte.GoToBegin();
-
-  // for each (x,y) couple
-  while (!inputIte.IsAtEnd())
-    {
-    // move the ouput iterator and set the output value
-    OutputIndexType outputIndex;
-    MapIndexType mapIndex;
-    InputIndexType inputIndex = inputIte.GetIndex();
-
-    for (size_t i = 0; i < OutputImageDimension; i++)
-      {
-      if (i != m_ProjectionDimension)
+      break;
+    case Mean:
+      if (rowByRow)
         {
-        outputIndex[i] = inputIndex[i];
-        mapIndex[i] = inputIndex[i];
+        this->template RowGenerateData<MeanRowReducer<InputPixelType>>(outputRegionForThread);
         }
       else
         {
-        outputIndex[i] = 0;
-        mapIndex[i] = 0;
+        this->template ColumnGenerateData<MeanReducer<InputPixelType>>(outputRegionForThread);
         }
-      }
+      break;
+    case Sum:
+      if (rowByRow)
+        {
+        this->template RowGenerateData<SumRowReducer<InputPixelType>>(outputRegionForThread);
+        }
+      else
+        {
+        this->template ColumnGenerateData<SumReducer<InputPixelType>>(outputRegionForThread);
+        }
+      break;
+    case Min:
+      this->template ColumnGenerateData<MinReducer<InputPixelType>>(outputRegionForThread);
+      break;
+    case StandardDeviation:
+      this->template ColumnGenerateData<StandardDeviationReducer<InputPixelType>>(outputRegionForThread);
+      break;
+    case Median:
+      this->template ColumnGenerateData<MedianReducer<InputPixelType>>(outputRegionForThread);
+      break;
+    case GaussianMean:
+      this->template ColumnGenerateData<GaussianMeanReducer<InputPixelType>>(outputRegionForThread);
+      break;
+    }
+}
+
+template <class TInputImage, class TMapImage, class TOutputImage>
+template <class TReducer>
+void 
+DepthMapProjectionFilter<TInputImage, TMapImage, TOutputImage>
+::ColumnGenerateData(const OutputRegionType &outputRegionForThread)
+{
+  // Use the output image to report the progress.
+  ProgressReporter progress(this, this->GetNumberOfWorkUnits(), outputRegionForThread.GetNumberOfPixels());
+
+  const unsigned int numberOfChannels = this->GetNumberOfChannels();
+  std::vector<const InputImageType *> channels(numberOfChannels);
+  std::vector<OutputImageType *> outputs(numberOfChannels);
+  for (unsigned int ch = 0; ch < numberOfChannels; ch++)
+    {
+    channels[ch] = this->GetChannel(ch);
+    outputs[ch] = this->GetOutput(ch);
+    }
+
+  // One reducer per thread, reset for each column of each channel.
+  TReducer reducer(m_Range[0], m_Range[1], m_Sigma);
+
+  // Neighbourhood of the median, if any, allocated once per thread.
+  SizeValueType neighbourhoodSize = 1;
+  for (unsigned int d = 0; d < InputImageDimension; d++)
+    {
+    neighbourhoodSize *= 2 * m_MedianRadius[d] + 1;
+    }
+  const bool median = neighbourhoodSize > 1;
+  std::vector<InputPixelType> neighbourhood;
+  neighbourhood.reserve(neighbourhoodSize);
+
+  ImageRegionConstIteratorWithIndex<OutputImageType> outputIte(outputs[0], outputRegionForThread);
+  for (; !outputIte.IsAtEnd(); ++outputIte)
+    {
+    const OutputIndexType outputIndex = outputIte.GetIndex();
+    DepthType centerDepth, highDepth, lowDepth;
+    this->GetBand(outputIndex, centerDepth, highDepth, lowDepth);
+    const InputIndexType inputIndex = this->GetInputIndex(outputIndex, highDepth);
 
-    int currentDepth = map->GetPixel(mapIndex) + m_Shift;
-    int highDepthValue = currentDepth - m_Range[0];
-    highDepthValue = std::max<int>(highDepthValue, 0);
-    highDepthValue = std::min<int>(highDepthValue, projectionSize - 1);
-    int lowDepthValue = currentDepth + m_Range[1];
-    lowDepthValue = std::max<int>(lowDepthValue, 0);
-    lowDepthValue = std::min<int>(lowDepthValue, projectionSize - 1);
-
-    // accumulate along the dimention
-    std::vector<InputPixelType> accumulatedData;
-    while (!inputIte.IsAtEndOfLine())
+    // Walk the band of the column directly in the buffer of each channel.
+    for (unsigned int ch = 0; ch < numberOfChannels; ch++)
       {
-      if (inputIte.GetIndex()[m_ProjectionDimension] >= highDepthValue &&
-      inputIte.GetIndex()[m_ProjectionDimension] <= lowDepthValue)
+      OutputPixelType result = NumericTraits<OutputPixelType>::ZeroValue();
+      if (highDepth <= lowDepth)
         {
-        accumulatedData.push_back(inputIte.Get());
+        reducer.Reset();
+        if (median)
+          {
+          InputIndexType index = inputIndex;
+          for (DepthType depth = highDepth; depth <= lowDepth; depth++, index[m_ProjectionDimension]++)
+            {
+            reducer.Push(this->GetMedian(channels[ch], index, neighbourhood), depth - centerDepth);
+            }
+          }
+        else
+          {
+          const OffsetValueType stride = channels[ch]->GetOffsetTable()[m_ProjectionDimension];
+          const InputPixelType *value = channels[ch]->GetBufferPointer() + channels[ch]->ComputeOffset(inputIndex);
+          for (DepthType depth = highDepth; depth <= lowDepth; depth++, value += stride)
+            {
+            reducer.Push(*value, depth - centerDepth);
+            }
+          }
+        result = DepthMapProjectionReducer::Convert<OutputPixelType>(reducer.Get());
         }
-      ++inputIte;
+      outputs[ch]->GetBufferPointer()[outputs[ch]->ComputeOffset(outputIndex)] = result;
       }
+    progress.CompletedPixel();
+    }
+}
+
+template <class TInputImage, class TMapImage, class TOutputImage>
+template <class TRowReducer>
+void 
+DepthMapProjectionFilter<TInputImage, TMapImage, TOutputImage>
+::RowGenerateData(const OutputRegionType &outputRegionForThread)
+{
+  // Use the output image to report the progress.
+  ProgressReporter progress(this, this->GetNumberOfWorkUnits(), outputRegionForThread.GetNumberOfPixels());
 
-    // project according to methode
-    OutputPixelType result = 0;
-    if (!accumulatedData.empty())
+  const unsigned int numberOfChannels = this->GetNumberOfChannels();
+  std::vector<const InputImageType *> channels(numberOfChannels);
+  std::vector<OutputImageType *> outputs(numberOfChannels);
+  for (unsigned int ch = 0; ch < numberOfChannels; ch++)
+    {
+    channels[ch] = this->GetChannel(ch);
+    outputs[ch] = this->GetOutput(ch);
+    }
+  static const DepthMapArgMax::InstructionSetType instructionSet = DepthMapArgMax::GetSupportedInstructionSet();
+
+  // Band and running value of each column of a row, allocated once per thread.
+  const SizeValueType rowLength = outputRegionForThread.GetSize()[0];
+  std::vector<DepthType> highDepth(rowLength);
+  std::vector<DepthType> lowDepth(rowLength);
+  std::vector<typename TRowReducer::ValueType> value(rowLength);
+
+  // Columns are read by chunks, so that a jump of the map only widens the
+  // range of depths read for its own chunk.
+  const SizeValueType chunkLength = 64;
+
+  ImageScanlineConstIterator<OutputImageType> outputIte(outputs[0], outputRegionForThread);
+  while (!outputIte.IsAtEnd())
+    {
+    const OutputIndexType rowIndex = outputIte.GetIndex();
+    OutputIndexType outputIndex = rowIndex;
+    for (SizeValueType c = 0; c < rowLength; c++)
+      {
+      DepthType centerDepth;
+      outputIndex[0] = rowIndex[0] + c;
+      this->GetBand(outputIndex, centerDepth, highDepth[c], lowDepth[c]);
+      }
+
+    // The bands of the row are shared by all channels.
+    for (unsigned int ch = 0; ch < numberOfChannels; ch++)
       {
-      if (m_Type.compare("max") == 0)
+      const InputImageType *channel = channels[ch];
+      const OffsetValueType stride = channel->GetOffsetTable()[m_ProjectionDimension];
+      std::fill(value.begin(), value.end(), TRowReducer::Initial());
+      for (SizeValueType start = 0; start < rowLength; start += chunkLength)
         {
-        typename std::vector<InputPixelType>::iterator ite;
-        ite = std::max_element(accumulatedData.begin(), accumulatedData.end());
-        result = *ite;
+        const SizeValueType n = std::min(chunkLength, rowLength - start);
+        const DepthType firstDepth = *std::min_element(highDepth.begin() + start, highDepth.begin() + start + n);
+        const DepthType lastDepth = *std::max_element(lowDepth.begin() + start, lowDepth.begin() + start + n);
+        if (firstDepth > lastDepth)
+          {
+          continue;
+          }
+        outputIndex[0] = rowIndex[0] + start;
+        const InputPixelType *row = channel->GetBufferPointer() + channel->ComputeOffset(this->GetInputIndex(outputIndex, firstDepth));
+        for (DepthType depth = firstDepth; depth <= lastDepth; depth++, row += stride)
+          {
+          TRowReducer::Update(row, &value[start], &highDepth[start], &lowDepth[start], depth, n, instructionSet);
+          }
         }
-      else if (m_Type.compare("avg") == 0)
+
+      OutputPixelType *outputRow = outputs[ch]->GetBufferPointer() + outputs[ch]->ComputeOffset(rowIndex);
+      for (SizeValueType c = 0; c < rowLength; c++)
         {
-        int sum = std::accumulate(accumulatedData.begin(), accumulatedData.end(), 0);
-        result = sum / accumulatedData.size();
+        OutputPixelType result = NumericTraits<OutputPixelType>::ZeroValue();
+        if (highDepth[c] <= lowDepth[c])
+          {
+          result = DepthMapProjectionReducer::Convert<OutputPixelType>(
+            TRowReducer::Get(value[c], lowDepth[c] - highDepth[c] + 1));
+          }
+        outputRow[c] = result;
         }
       }
 
-    // Set value at pixel
-    output->SetPixel(outputIndex, static_cast<OutputPixelType>(result));
-
-    // one more line done !
-    progress.CompletedPixel();
-
-    // continue with the next one
-    inputIte.NextLine();
+    for (SizeValueType c = 0; c < rowLength; c++)
+      {
+      progress.CompletedPixel();
+      }
+    outputIte.NextLine();
     }
 }
 
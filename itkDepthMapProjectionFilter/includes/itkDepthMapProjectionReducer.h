@@ -0,0 +1,559 @@
+#ifndef __itkDepthMapProjectionReducer_h
+#define __itkDepthMapProjectionReducer_h
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include "itkDepthMapArgMax.h"
+
+namespace itk
+{
+
+/** \namespace DepthMapProjectionReducer
+ * \brief Reduction of the band of a column to one projected value.
+ *
+ * Each reducer is a policy with the same interface, so that the projection
+ * loop is instantiated once per reducer and the projection type is only
+ * looked up once per run:
+ * - a constructor taking the upper range, the lower range and the sigma,
+ *   which allocates whatever the reducer needs for the widest band,
+ * - Reset(), called before the band of each column,
+ * - Push(value, distance), called for each value of the band in increasing
+ *   depth order, distance being the depth minus the depth of the map,
+ * - Get(), the projected value, only called on a non empty band.
+ * Sums are accumulated in double, whatever the pixel type.
+ *
+ * The max, sum and mean reducers also have a row policy, updating the running
+ * value of a row of adjacent columns with one row of a plane, each column
+ * having its own band. For float and unsigned short pixels the update runs 4
+ * to 16 columns wide with SSE2 or AVX2, and gives the same result as the
+ * scalar loop.
+ *
+ * \author Stephane U. Rigaud (stephane.rigaud@pasteur.fr)
+ */
+namespace DepthMapProjectionReducer
+{
+
+using DepthType = DepthMapArgMax::DepthType;
+using DepthMapArgMax::InstructionSetType;
+
+enum ReducerType
+{
+  Max = 0,
+  Mean = 1,
+  Sum = 2,
+  Min = 3,
+  StandardDeviation = 4,
+  Median = 5,
+  GaussianMean = 6
+};
+
+/** Reducer of a projection type name, "avg" being the mean. Return false if the name is unknown. */
+inline bool
+GetReducerType(const std::string &name, ReducerType &type)
+{
+  static const char *names[] = {"max", "avg", "sum", "min", "std", "median", "gauss"};
+  for (int r = Max; r <= GaussianMean; r++)
+    {
+    if (name.compare(names[r]) == 0)
+      {
+      type = static_cast<ReducerType>(r);
+      return true;
+      }
+    }
+  if (name.compare("mean") == 0)
+    {
+    type = Mean;
+    return true;
+    }
+  return false;
+}
+
+/** Projected value converted to the output pixel type, rounded and clamped for integer types. */
+template <typename TOutputPixel>
+inline TOutputPixel
+Convert(double value)
+{
+  if (!std::numeric_limits<TOutputPixel>::is_integer)
+    {
+    return static_cast<TOutputPixel>(value);
+    }
+  value = std::round(value);
+  value = std::max<double>(value, std::numeric_limits<TOutputPixel>::lowest());
+  value = std::min<double>(value, std::numeric_limits<TOutputPixel>::max());
+  return static_cast<TOutputPixel>(value);
+}
+
+template <typename TPixel>
+class MaxReducer
+{
+public:
+  MaxReducer(int, int, float) {}
+  void Reset() { m_Value = std::numeric_limits<TPixel>::lowest(); }
+  void Push(const TPixel value, int) { m_Value = std::max(m_Value, value); }
+  double Get() const { return static_cast<double>(m_Value); }
+
+private:
+  TPixel m_Value;
+};
+
+template <typename TPixel>
+class MinReducer
+{
+public:
+  MinReducer(int, int, float) {}
+  void Reset() { m_Value = std::numeric_limits<TPixel>::max(); }
+  void Push(const TPixel value, int) { m_Value = std::min(m_Value, value); }
+  double Get() const { return static_cast<double>(m_Value); }
+
+private:
+  TPixel m_Value;
+};
+
+template <typename TPixel>
+class SumReducer
+{
+public:
+  SumReducer(int, int, float) {}
+  void Reset() { m_Sum = 0; }
+  void Push(const TPixel value, int) { m_Sum += static_cast<double>(value); }
+  double Get() const { return m_Sum; }
+
+private:
+  double m_Sum;
+};
+
+template <typename TPixel>
+class MeanReducer
+{
+public:
+  MeanReducer(int, int, float) {}
+  void Reset() { m_Sum = 0; m_Count = 0; }
+  void Push(const TPixel value, int) { m_Sum += static_cast<double>(value); m_Count++; }
+  double Get() const { return m_Sum / m_Count; }
+
+private:
+  double m_Sum;
+  unsigned int m_Count;
+};
+
+/** Population standard deviation, with Welford's running mean and sum of squared deviations. */
+template <typename TPixel>
+class StandardDeviationReducer
+{
+public:
+  StandardDeviationReducer(int, int, float) {}
+  void Reset() { m_Mean = 0; m_Deviation = 0; m_Count = 0; }
+  void Push(const TPixel value, int)
+  {
+    const double x = static_cast<double>(value);
+    m_Count++;
+    const double delta = x - m_Mean;
+    m_Mean += delta / m_Count;
+    m_Deviation += delta * (x - m_Mean);
+  }
+  double Get() const { return std::sqrt(std::max(m_Deviation / m_Count, 0.0)); }
+
+private:
+  double m_Mean;
+  double m_Deviation;
+  unsigned int m_Count;
+};
+
+/** Median of the band, the mean of the two middle values for an even number of
+ * values. The values are kept in a buffer sized once for the widest band. */
+template <typename TPixel>
+class MedianReducer
+{
+public:
+  MedianReducer(int upperRange, int lowerRange, float)
+    : m_Values(std::max(upperRange + lowerRange + 1, 1))
+  {}
+  void Reset() { m_Count = 0; }
+  void Push(const TPixel value, int) { m_Values[m_Count++] = value; }
+  double Get()
+  {
+    const auto begin = m_Values.begin();
+    const auto middle = begin + m_Count / 2;
+    std::nth_element(begin, middle, begin + m_Count);
+    if (m_Count % 2 == 1)
+      {
+      return static_cast<double>(*middle);
+      }
+    return (static_cast<double>(*std::max_element(begin, middle)) + static_cast<double>(*middle)) / 2;
+  }
+
+private:
+  std::vector<TPixel> m_Values;
+  unsigned int m_Count = 0;
+};
+
+/** Mean weighted by a Gaussian of the distance to the depth of the map. The
+ * weights of the band are tabulated once, a band clamped by the volume limits
+ * may reach beyond it. */
+template <typename TPixel>
+class GaussianMeanReducer
+{
+public:
+  GaussianMeanReducer(int upperRange, int lowerRange, float sigma)
+    : m_UpperRange(upperRange)
+    , m_Sigma(sigma)
+    , m_Weights(std::max(upperRange + lowerRange + 1, 1))
+  {
+    for (size_t i = 0; i < m_Weights.size(); i++)
+      {
+      m_Weights[i] = this->Weight(static_cast<int>(i) - upperRange);
+      }
+  }
+  void Reset() { m_Sum = 0; m_Weight = 0; }
+  void Push(const TPixel value, int distance)
+  {
+    const size_t i = static_cast<size_t>(distance + m_UpperRange);
+    const double weight = i < m_Weights.size() ? m_Weights[i] : this->Weight(distance);
+    m_Sum += weight * static_cast<double>(value);
+    m_Weight += weight;
+  }
+  double Get() const { return m_Weight > 0 ? m_Sum / m_Weight : 0.0; }
+
+private:
+  double Weight(int distance) const
+  {
+    if (m_Sigma <= 0)
+      {
+      return distance == 0 ? 1.0 : 0.0;
+      }
+    const double x = distance / static_cast<double>(m_Sigma);
+    return std::exp(-0.5 * x * x);
+  }
+
+  int m_UpperRange;
+  float m_Sigma;
+  std::vector<double> m_Weights;
+  double m_Sum;
+  double m_Weight;
+};
+
+/** Scalar row updates, used for the tail of the vector loops. A column c takes
+ * the value of the row if depth lies in [high[c], low[c]]. */
+template <typename TPixel>
+inline void
+MaxRowScalar(const TPixel *row, TPixel *value, const DepthType *high, const DepthType *low, DepthType depth, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    {
+    if (depth >= high[i] && depth <= low[i] && row[i] > value[i])
+      {
+      value[i] = row[i];
+      }
+    }
+}
+
+template <typename TPixel>
+inline void
+SumRowScalar(const TPixel *row, double *sum, const DepthType *high, const DepthType *low, DepthType depth, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    {
+    if (depth >= high[i] && depth <= low[i])
+      {
+      sum[i] += static_cast<double>(row[i]);
+      }
+    }
+}
+
+#ifdef ITK_DEPTHMAP_X86_SIMD
+
+/** Mask of the columns whose band does not contain depth. */
+__attribute__((target("sse2"))) inline __m128i
+OutOfBandSSE2(const DepthType *high, const DepthType *low, __m128i depthVector)
+{
+  __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(high));
+  __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(low));
+  return _mm_or_si128(_mm_cmpgt_epi32(h, depthVector), _mm_cmpgt_epi32(depthVector, l));
+}
+
+__attribute__((target("avx2"))) inline __m256i
+OutOfBandAVX2(const DepthType *high, const DepthType *low, __m256i depthVector)
+{
+  __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(high));
+  __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(low));
+  return _mm256_or_si256(_mm256_cmpgt_epi32(h, depthVector), _mm256_cmpgt_epi32(depthVector, l));
+}
+
+__attribute__((target("sse2"))) inline void
+MaxRowSSE2(const float *row, float *value, const DepthType *high, const DepthType *low, DepthType depth, size_t n)
+{
+  const __m128i depthVector = _mm_set1_epi32(depth);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+    __m128 outOfBand = _mm_castsi128_ps(OutOfBandSSE2(high + i, low + i, depthVector));
+    __m128 x = _mm_loadu_ps(row + i);
+    __m128 current = _mm_loadu_ps(value + i);
+    __m128 greater = _mm_andnot_ps(outOfBand, _mm_cmpgt_ps(x, current));
+    _mm_storeu_ps(value + i, _mm_or_ps(_mm_and_ps(greater, x), _mm_andnot_ps(greater, current)));
+    }
+  MaxRowScalar(row + i, value + i, high + i, low + i, depth, n - i);
+}
+
+__attribute__((target("sse2"))) inline void
+MaxRowSSE2(const unsigned short *row, unsigned short *value, const DepthType *high, const DepthType *low,
+           DepthType depth, size_t n)
+{
+  // SSE2 only has a signed 16 bits comparison, flip the sign bit to compare unsigned values.
+  const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+  const __m128i depthVector = _mm_set1_epi32(depth);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+    __m128i outOfBand = _mm_packs_epi32(OutOfBandSSE2(high + i, low + i, depthVector),
+                                        OutOfBandSSE2(high + i + 4, low + i + 4, depthVector));
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+    __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i *>(value + i));
+    __m128i greater = _mm_andnot_si128(outOfBand, _mm_cmpgt_epi16(_mm_xor_si128(x, bias), _mm_xor_si128(current, bias)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(value + i),
+                     _mm_or_si128(_mm_and_si128(greater, x), _mm_andnot_si128(greater, current)));
+    }
+  MaxRowScalar(row + i, value + i, high + i, low + i, depth, n - i);
+}
+
+__attribute__((target("avx2"))) inline void
+MaxRowAVX2(const float *row, float *value, const DepthType *high, const DepthType *low, DepthType depth, size_t n)
+{
+  const __m256i depthVector = _mm256_set1_epi32(depth);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+    __m256 outOfBand = _mm256_castsi256_ps(OutOfBandAVX2(high + i, low + i, depthVector));
+    __m256 x = _mm256_loadu_ps(row + i);
+    __m256 current = _mm256_loadu_ps(value + i);
+    __m256 greater = _mm256_andnot_ps(outOfBand, _mm256_cmp_ps(x, current, _CMP_GT_OQ));
+    _mm256_storeu_ps(value + i, _mm256_blendv_ps(current, x, greater));
+    }
+  MaxRowScalar(row + i, value + i, high + i, low + i, depth, n - i);
+}
+
+__attribute__((target("avx2"))) inline void
+MaxRowAVX2(const unsigned short *row, unsigned short *value, const DepthType *high, const DepthType *low,
+           DepthType depth, size_t n)
+{
+  const __m256i depthVector = _mm256_set1_epi32(depth);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    {
+    // The pack interleaves the 128 bits lanes, put the 16 columns back in order.
+    __m256i outOfBand = _mm256_packs_epi32(OutOfBandAVX2(high + i, low + i, depthVector),
+                                           OutOfBandAVX2(high + i + 8, low + i + 8, depthVector));
+    outOfBand = _mm256_permute4x64_epi64(outOfBand, 0xD8);
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i));
+    __m256i current = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(value + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(value + i),
+                        _mm256_blendv_epi8(current, _mm256_max_epu16(current, x), _mm256_xor_si256(outOfBand, _mm256_set1_epi32(-1))));
+    }
+  MaxRowScalar(row + i, value + i, high + i, low + i, depth, n - i);
+}
+
+__attribute__((target("sse2"))) inline void
+SumRowSSE2(const float *row, double *sum, const DepthType *high, const DepthType *low, DepthType depth, size_t n)
+{
+  const __m128i depthVector = _mm_set1_epi32(depth);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+    __m128i inBand = _mm_xor_si128(OutOfBandSSE2(high + i, low + i, depthVector), _mm_set1_epi32(-1));
+    __m128 x = _mm_loadu_ps(row + i);
+    __m128d x0 = _mm_and_pd(_mm_castsi128_pd(_mm_unpacklo_epi32(inBand, inBand)), _mm_cvtps_pd(x));
+    __m128d x1 = _mm_and_pd(_mm_castsi128_pd(_mm_unpackhi_epi32(inBand, inBand)), _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+    _mm_storeu_pd(sum + i, _mm_add_pd(_mm_loadu_pd(sum + i), x0));
+    _mm_storeu_pd(sum + i + 2, _mm_add_pd(_mm_loadu_pd(sum + i + 2), x1));
+    }
+  SumRowScalar(row + i, sum + i, high + i, low + i, depth, n - i);
+}
+
+__attribute__((target("sse2"))) inline void
+SumRowSSE2(const unsigned short *row, double *sum, const DepthType *high, const DepthType *low, DepthType depth,
+           size_t n)
+{
+  const __m128i depthVector = _mm_set1_epi32(depth);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+    __m128i inBand = _mm_xor_si128(OutOfBandSSE2(high + i, low + i, depthVector), _mm_set1_epi32(-1));
+    __m128i x = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(row + i)), _mm_setzero_si128());
+    x = _mm_and_si128(inBand, x);
+    __m128d x0 = _mm_cvtepi32_pd(x);
+    __m128d x1 = _mm_cvtepi32_pd(_mm_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2)));
+    _mm_storeu_pd(sum + i, _mm_add_pd(_mm_loadu_pd(sum + i), x0));
+    _mm_storeu_pd(sum + i + 2, _mm_add_pd(_mm_loadu_pd(sum + i + 2), x1));
+    }
+  SumRowScalar(row + i, sum + i, high + i, low + i, depth, n - i);
+}
+
+__attribute__((target("avx2"))) inline void
+SumRowAVX2(const float *row, double *sum, const DepthType *high, const DepthType *low, DepthType depth, size_t n)
+{
+  const __m256i depthVector = _mm256_set1_epi32(depth);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+    __m256i inBand = _mm256_xor_si256(OutOfBandAVX2(high + i, low + i, depthVector), _mm256_set1_epi32(-1));
+    __m256 x = _mm256_loadu_ps(row + i);
+    __m256d x0 = _mm256_and_pd(_mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_castsi256_si128(inBand))),
+                               _mm256_cvtps_pd(_mm256_castps256_ps128(x)));
+    __m256d x1 = _mm256_and_pd(_mm256_castsi256_pd(_mm256_cvtepi32_epi64(_mm256_extracti128_si256(inBand, 1))),
+                               _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)));
+    _mm256_storeu_pd(sum + i, _mm256_add_pd(_mm256_loadu_pd(sum + i), x0));
+    _mm256_storeu_pd(sum + i + 4, _mm256_add_pd(_mm256_loadu_pd(sum + i + 4), x1));
+    }
+  SumRowScalar(row + i, sum + i, high + i, low + i, depth, n - i);
+}
+
+__attribute__((target("avx2"))) inline void
+SumRowAVX2(const unsigned short *row, double *sum, const DepthType *high, const DepthType *low, DepthType depth,
+           size_t n)
+{
+  const __m256i depthVector = _mm256_set1_epi32(depth);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+    __m256i inBand = _mm256_xor_si256(OutOfBandAVX2(high + i, low + i, depthVector), _mm256_set1_epi32(-1));
+    __m256i x = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i)));
+    x = _mm256_and_si256(inBand, x);
+    __m256d x0 = _mm256_cvtepi32_pd(_mm256_castsi256_si128(x));
+    __m256d x1 = _mm256_cvtepi32_pd(_mm256_extracti128_si256(x, 1));
+    _mm256_storeu_pd(sum + i, _mm256_add_pd(_mm256_loadu_pd(sum + i), x0));
+    _mm256_storeu_pd(sum + i + 4, _mm256_add_pd(_mm256_loadu_pd(sum + i + 4), x1));
+    }
+  SumRowScalar(row + i, sum + i, high + i, low + i, depth, n - i);
+}
+
+#endif
+
+/** Row updates with a given instruction set, which must be supported by the processor. */
+template <typename TPixel>
+inline void
+MaxRow(const TPixel *row, TPixel *value, const DepthType *high, const DepthType *low, DepthType depth, size_t n,
+       InstructionSetType)
+{
+  MaxRowScalar(row, value, high, low, depth, n);
+}
+
+template <typename TPixel>
+inline void
+SumRow(const TPixel *row, double *sum, const DepthType *high, const DepthType *low, DepthType depth, size_t n,
+       InstructionSetType)
+{
+  SumRowScalar(row, sum, high, low, depth, n);
+}
+
+#ifdef ITK_DEPTHMAP_X86_SIMD
+template <typename TPixel>
+inline void
+MaxRowVector(const TPixel *row, TPixel *value, const DepthType *high, const DepthType *low, DepthType depth, size_t n,
+             InstructionSetType instructionSet)
+{
+  switch (instructionSet)
+    {
+    case DepthMapArgMax::AVX512:
+    case DepthMapArgMax::AVX2:
+      MaxRowAVX2(row, value, high, low, depth, n);
+      break;
+    case DepthMapArgMax::SSE2:
+      MaxRowSSE2(row, value, high, low, depth, n);
+      break;
+    default:
+      MaxRowScalar(row, value, high, low, depth, n);
+    }
+}
+
+template <typename TPixel>
+inline void
+SumRowVector(const TPixel *row, double *sum, const DepthType *high, const DepthType *low, DepthType depth, size_t n,
+             InstructionSetType instructionSet)
+{
+  switch (instructionSet)
+    {
+    case DepthMapArgMax::AVX512:
+    case DepthMapArgMax::AVX2:
+      SumRowAVX2(row, sum, high, low, depth, n);
+      break;
+    case DepthMapArgMax::SSE2:
+      SumRowSSE2(row, sum, high, low, depth, n);
+      break;
+    default:
+      SumRowScalar(row, sum, high, low, depth, n);
+    }
+}
+
+inline void
+MaxRow(const float *row, float *value, const DepthType *high, const DepthType *low, DepthType depth, size_t n,
+       InstructionSetType instructionSet)
+{
+  MaxRowVector(row, value, high, low, depth, n, instructionSet);
+}
+
+inline void
+MaxRow(const unsigned short *row, unsigned short *value, const DepthType *high, const DepthType *low, DepthType depth,
+       size_t n, InstructionSetType instructionSet)
+{
+  MaxRowVector(row, value, high, low, depth, n, instructionSet);
+}
+
+inline void
+SumRow(const float *row, double *sum, const DepthType *high, const DepthType *low, DepthType depth, size_t n,
+       InstructionSetType instructionSet)
+{
+  SumRowVector(row, sum, high, low, depth, n, instructionSet);
+}
+
+inline void
+SumRow(const unsigned short *row, double *sum, const DepthType *high, const DepthType *low, DepthType depth, size_t n,
+       InstructionSetType instructionSet)
+{
+  SumRowVector(row, sum, high, low, depth, n, instructionSet);
+}
+#endif
+
+/** Row policies: running value of each column of a row, its update with one
+ * row of a plane, and the projected value of a column of band size count. */
+template <typename TPixel>
+struct MaxRowReducer
+{
+  using ValueType = TPixel;
+  static ValueType Initial() { return std::numeric_limits<TPixel>::lowest(); }
+  static void
+  Update(const TPixel *row, ValueType *value, const DepthType *high, const DepthType *low, DepthType depth, size_t n,
+         InstructionSetType instructionSet)
+  {
+    MaxRow(row, value, high, low, depth, n, instructionSet);
+  }
+  static double Get(const ValueType value, DepthType) { return static_cast<double>(value); }
+};
+
+template <typename TPixel>
+struct SumRowReducer
+{
+  using ValueType = double;
+  static ValueType Initial() { return 0; }
+  static void
+  Update(const TPixel *row, ValueType *value, const DepthType *high, const DepthType *low, DepthType depth, size_t n,
+         InstructionSetType instructionSet)
+  {
+    SumRow(row, value, high, low, depth, n, instructionSet);
+  }
+  static double Get(const ValueType value, DepthType) { return value; }
+};
+
+template <typename TPixel>
+struct MeanRowReducer : public SumRowReducer<TPixel>
+{
+  static double Get(const double value, DepthType count) { return value / count; }
+};
+
+} // namespace DepthMapProjectionReducer
+} // namespace itk
+
+#endif // __itkDepthMapProjectionReducer_h
@@ -0,0 +1,124 @@
+
+#include <vector>
+
+#include "itkImageFileReader.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkDepthMapProjectionFilter.h"
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+    {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " InputImage Type" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  using VolumeType = itk::Image<unsigned short, 3>;
+  using MapType = itk::Image<float, 2>;
+  using ProjectionType = itk::Image<unsigned short, 2>;
+  using VolumeReaderType = itk::ImageFileReader<VolumeType>;
+  using FilterType = itk::DepthMapProjectionFilter<VolumeType, MapType, ProjectionType>;
+  const unsigned int numberOfChannels = 3;
+
+  VolumeReaderType::Pointer reader = VolumeReaderType::New();
+  reader->SetFileName(argv[1]);
+  try
+    {
+    reader->Update();
+    }
+  catch (itk::ExceptionObject &excp)
+    {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+    }
+  const VolumeType::RegionType region = reader->GetOutput()->GetLargestPossibleRegion();
+  const VolumeType::SizeType size = region.GetSize();
+
+  // Channels derived from the input, each one with a different content.
+  std::vector<VolumeType::Pointer> channels(numberOfChannels);
+  for (unsigned int ch = 0; ch < numberOfChannels; ch++)
+    {
+    channels[ch] = VolumeType::New();
+    channels[ch]->CopyInformation(reader->GetOutput());
+    channels[ch]->SetRegions(region);
+    channels[ch]->Allocate();
+    itk::ImageRegionConstIterator<VolumeType> inputIte(reader->GetOutput(), region);
+    itk::ImageRegionIteratorWithIndex<VolumeType> channelIte(channels[ch], region);
+    for (; !inputIte.IsAtEnd(); ++inputIte, ++channelIte)
+      {
+      const unsigned short value = inputIte.Get();
+      channelIte.Set(ch == 0 ? value : (ch == 1 ? 1000 - value : value * channelIte.GetIndex()[2]));
+      }
+    }
+
+  // Depth map with steps, so that adjacent columns have different bands.
+  MapType::Pointer map = MapType::New();
+  MapType::RegionType mapRegion;
+  mapRegion.SetSize(0, size[0]);
+  mapRegion.SetSize(1, size[1]);
+  map->SetRegions(mapRegion);
+  map->Allocate();
+  itk::ImageRegionIteratorWithIndex<MapType> mapIte(map, mapRegion);
+  for (; !mapIte.IsAtEnd(); ++mapIte)
+    {
+    const MapType::IndexType index = mapIte.GetIndex();
+    mapIte.Set(static_cast<float>((index[0] / 3 + index[1] / 11) % size[2]));
+    }
+  FilterType::ArrayType range;
+  range[0] = 2;
+  range[1] = 3;
+
+  // All channels in one pass.
+  FilterType::Pointer filter = FilterType::New();
+  for (unsigned int ch = 0; ch < numberOfChannels; ch++)
+    {
+    filter->SetChannel(ch, channels[ch]);
+    }
+  filter->SetMap(map);
+  filter->SetType(argv[2]);
+  filter->SetRange(range);
+  try
+    {
+    filter->Update();
+    }
+  catch (itk::ExceptionObject &excp)
+    {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Each channel must be projected as if it was the only input.
+  unsigned long mismatch = 0;
+  for (unsigned int ch = 0; ch < numberOfChannels; ch++)
+    {
+    FilterType::Pointer reference = FilterType::New();
+    reference->SetInput(channels[ch]);
+    reference->SetMap(map);
+    reference->SetType(argv[2]);
+    reference->SetRange(range);
+    try
+      {
+      reference->Update();
+      }
+    catch (itk::ExceptionObject &excp)
+      {
+      std::cerr << excp << std::endl;
+      return EXIT_FAILURE;
+      }
+    itk::ImageRegionConstIterator<ProjectionType> referenceIte(reference->GetOutput(), reference->GetOutput()->GetLargestPossibleRegion());
+    itk::ImageRegionConstIterator<ProjectionType> testIte(filter->GetOutput(ch), filter->GetOutput(ch)->GetLargestPossibleRegion());
+    for (; !referenceIte.IsAtEnd(); ++referenceIte, ++testIte)
+      {
+      if (referenceIte.Get() != testIte.Get())
+        {
+        mismatch++;
+        }
+      }
+    }
+
+  std::cout << "Mismatching pixels: " << mismatch << std::endl;
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
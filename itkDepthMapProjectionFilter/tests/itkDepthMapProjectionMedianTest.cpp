@@ -0,0 +1,100 @@
+
+#include "itkImageFileReader.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkMedianImageFilter.h"
+#include "itkDepthMapProjectionFilter.h"
+
+int main(int argc, char **argv)
+{
+  if (argc < 4)
+    {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " InputImage Type Radius [upperRange | lowerRange]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  using VolumeType = itk::Image<unsigned char, 3>;
+  using MapType = itk::Image<float, 2>;
+  using ProjectionType = itk::Image<unsigned char, 2>;
+  using VolumeReaderType = itk::ImageFileReader<VolumeType>;
+  using MedianFilterType = itk::MedianImageFilter<VolumeType, VolumeType>;
+  using FilterType = itk::DepthMapProjectionFilter<VolumeType, MapType, ProjectionType>;
+
+  VolumeReaderType::Pointer reader = VolumeReaderType::New();
+  reader->SetFileName(argv[1]);
+  try
+    {
+    reader->Update();
+    }
+  catch (itk::ExceptionObject &excp)
+    {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+    }
+  const VolumeType::SizeType size = reader->GetOutput()->GetLargestPossibleRegion().GetSize();
+
+  VolumeType::SizeType radius;
+  radius.Fill(std::atoi(argv[3]));
+  FilterType::ArrayType range;
+  range[0] = argc >= 5 ? std::atoi(argv[4]) : 1;
+  range[1] = argc >= 6 ? std::atoi(argv[5]) : 1;
+
+  // Depth map with steps, reaching the first and last planes.
+  MapType::Pointer map = MapType::New();
+  MapType::RegionType mapRegion;
+  mapRegion.SetSize(0, size[0]);
+  mapRegion.SetSize(1, size[1]);
+  map->SetRegions(mapRegion);
+  map->Allocate();
+  itk::ImageRegionIteratorWithIndex<MapType> mapIte(map, mapRegion);
+  for (; !mapIte.IsAtEnd(); ++mapIte)
+    {
+    const MapType::IndexType index = mapIte.GetIndex();
+    mapIte.Set(static_cast<float>((index[0] / 9 + index[1] / 4) % size[2]));
+    }
+
+  // Projection of the median filtered volume.
+  MedianFilterType::Pointer median = MedianFilterType::New();
+  median->SetInput(reader->GetOutput());
+  median->SetRadius(radius);
+  FilterType::Pointer reference = FilterType::New();
+  reference->SetInput(median->GetOutput());
+  reference->SetMap(map);
+  reference->SetType(argv[2]);
+  reference->SetRange(range);
+
+  // Projection with the median of the band voxels only.
+  FilterType::Pointer filter = FilterType::New();
+  filter->SetInput(reader->GetOutput());
+  filter->SetMap(map);
+  filter->SetType(argv[2]);
+  filter->SetRange(range);
+  filter->SetMedianRadius(radius);
+  try
+    {
+    reference->Update();
+    filter->Update();
+    }
+  catch (itk::ExceptionObject &excp)
+    {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Both must give the same projection.
+  itk::ImageRegionConstIterator<ProjectionType> referenceIte(reference->GetOutput(), reference->GetOutput()->GetLargestPossibleRegion());
+  itk::ImageRegionConstIterator<ProjectionType> testIte(filter->GetOutput(), filter->GetOutput()->GetLargestPossibleRegion());
+  unsigned long mismatch = 0;
+  for (; !referenceIte.IsAtEnd(); ++referenceIte, ++testIte)
+    {
+    if (referenceIte.Get() != testIte.Get())
+      {
+      mismatch++;
+      }
+    }
+
+  std::cout << "Mismatching pixels: " << mismatch << std::endl;
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
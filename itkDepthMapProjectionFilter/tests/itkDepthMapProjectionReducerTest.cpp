@@ -0,0 +1,145 @@
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+#include "itkDepthMapProjectionReducer.h"
+
+using namespace itk::DepthMapProjectionReducer;
+
+// Compare the row policies, with every supported instruction set, with the
+// column reducers along each column of a random volume with random bands, for
+// row lengths that exercise the vector tails.
+template <class TPixel, template <class> class TRowReducer, template <class> class TReducer>
+unsigned long CompareRowReducer(std::mt19937 &generator)
+{
+  unsigned long mismatch = 0;
+  const InstructionSetType supported = itk::DepthMapArgMax::GetSupportedInstructionSet();
+  for (size_t n = 1; n <= 70; n++)
+    {
+    const DepthType depthSize = 1 + generator() % 40;
+    std::vector<TPixel> volume(n * depthSize);
+    for (auto &value : volume)
+      {
+      value = static_cast<TPixel>(65000 - generator() % 1000);
+      }
+    std::vector<DepthType> high(n);
+    std::vector<DepthType> low(n);
+    for (size_t c = 0; c < n; c++)
+      {
+      high[c] = generator() % depthSize;
+      low[c] = std::min<DepthType>(high[c] + generator() % 5, depthSize - 1);
+      }
+
+    // Reference value of each column.
+    std::vector<double> reference(n);
+    TReducer<TPixel> reducer(0, 0, 1);
+    for (size_t c = 0; c < n; c++)
+      {
+      reducer.Reset();
+      for (DepthType z = high[c]; z <= low[c]; z++)
+        {
+        reducer.Push(volume[z * n + c], 0);
+        }
+      reference[c] = reducer.Get();
+      }
+
+    for (int isa = itk::DepthMapArgMax::Scalar; isa <= supported; isa++)
+      {
+      using ValueType = typename TRowReducer<TPixel>::ValueType;
+      std::vector<ValueType> value(n, TRowReducer<TPixel>::Initial());
+      for (DepthType z = 0; z < depthSize; z++)
+        {
+        TRowReducer<TPixel>::Update(&volume[z * n], value.data(), high.data(), low.data(), z, n,
+                                    static_cast<InstructionSetType>(isa));
+        }
+      for (size_t c = 0; c < n; c++)
+        {
+        if (TRowReducer<TPixel>::Get(value[c], low[c] - high[c] + 1) != reference[c])
+          {
+          std::cerr << "Mismatch for instruction set " << isa << " and row length " << n << std::endl;
+          mismatch++;
+          break;
+          }
+        }
+      }
+    }
+  return mismatch;
+}
+
+// Compare the column reducers with a direct computation on a random band.
+unsigned long CompareColumnReducers(std::mt19937 &generator)
+{
+  unsigned long mismatch = 0;
+  for (int upper = 0; upper <= 4; upper++)
+    {
+    for (int lower = 0; lower <= 4; lower++)
+      {
+      std::vector<unsigned short> band(upper + lower + 1);
+      for (auto &value : band)
+        {
+        value = static_cast<unsigned short>(generator() % 4096);
+        }
+
+      std::vector<unsigned short> sorted(band);
+      std::sort(sorted.begin(), sorted.end());
+      const size_t size = band.size();
+      const double median = size % 2 == 1 ? sorted[size / 2] : (sorted[size / 2 - 1] + sorted[size / 2]) / 2.0;
+      const double mean = std::accumulate(band.begin(), band.end(), 0.0) / size;
+      double deviation = 0;
+      double weightedSum = 0;
+      double weight = 0;
+      for (size_t i = 0; i < size; i++)
+        {
+        deviation += (band[i] - mean) * (band[i] - mean);
+        const double distance = static_cast<int>(i) - upper;
+        weightedSum += std::exp(-0.5 * distance * distance / 4) * band[i];
+        weight += std::exp(-0.5 * distance * distance / 4);
+        }
+
+      MedianReducer<unsigned short> medianReducer(upper, lower, 2);
+      StandardDeviationReducer<unsigned short> deviationReducer(upper, lower, 2);
+      GaussianMeanReducer<unsigned short> gaussianReducer(upper, lower, 2);
+      medianReducer.Reset();
+      deviationReducer.Reset();
+      gaussianReducer.Reset();
+      for (size_t i = 0; i < size; i++)
+        {
+        medianReducer.Push(band[i], static_cast<int>(i) - upper);
+        deviationReducer.Push(band[i], static_cast<int>(i) - upper);
+        gaussianReducer.Push(band[i], static_cast<int>(i) - upper);
+        }
+      if (medianReducer.Get() != median ||
+          std::abs(deviationReducer.Get() - std::sqrt(deviation / size)) > 1e-6 ||
+          std::abs(gaussianReducer.Get() - weightedSum / weight) > 1e-6)
+        {
+        std::cerr << "Mismatch for range " << upper << " " << lower << std::endl;
+        mismatch++;
+        }
+      }
+    }
+  return mismatch;
+}
+
+int main()
+{
+  std::mt19937 generator(42);
+  std::cout << "Supported instruction set: " << itk::DepthMapArgMax::GetSupportedInstructionSet() << std::endl;
+
+  unsigned long mismatch = 0;
+  mismatch += CompareRowReducer<float, MaxRowReducer, MaxReducer>(generator);
+  mismatch += CompareRowReducer<unsigned short, MaxRowReducer, MaxReducer>(generator);
+  mismatch += CompareRowReducer<unsigned char, MaxRowReducer, MaxReducer>(generator);
+  mismatch += CompareRowReducer<float, SumRowReducer, SumReducer>(generator);
+  mismatch += CompareRowReducer<unsigned short, SumRowReducer, SumReducer>(generator);
+  mismatch += CompareRowReducer<unsigned char, SumRowReducer, SumReducer>(generator);
+  mismatch += CompareRowReducer<float, MeanRowReducer, MeanReducer>(generator);
+  mismatch += CompareRowReducer<unsigned short, MeanRowReducer, MeanReducer>(generator);
+  mismatch += CompareColumnReducers(generator);
+
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,154 @@
+
+#include <cmath>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+#include "itkImageFileReader.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkDepthMapProjectionFilter.h"
+
+// Projection of a band given explicitly, as a reference for the filter reducers.
+double ReferenceProjection(const std::string &type, std::vector<double> band, float sigma, int centerDepth,
+                           int highDepth)
+{
+  const double size = band.size();
+  const double sum = std::accumulate(band.begin(), band.end(), 0.0);
+  if (type == "max")
+    {
+    return *std::max_element(band.begin(), band.end());
+    }
+  if (type == "min")
+    {
+    return *std::min_element(band.begin(), band.end());
+    }
+  if (type == "sum")
+    {
+    return sum;
+    }
+  if (type == "avg")
+    {
+    return sum / size;
+    }
+  if (type == "std")
+    {
+    double deviation = 0;
+    for (double value : band)
+      {
+      deviation += (value - sum / size) * (value - sum / size);
+      }
+    return std::sqrt(deviation / size);
+    }
+  if (type == "median")
+    {
+    std::sort(band.begin(), band.end());
+    const size_t n = band.size();
+    return n % 2 == 1 ? band[n / 2] : (band[n / 2 - 1] + band[n / 2]) / 2;
+    }
+  double weightedSum = 0;
+  double weight = 0;
+  for (size_t i = 0; i < band.size(); i++)
+    {
+    const double distance = highDepth + static_cast<int>(i) - centerDepth;
+    weightedSum += std::exp(-0.5 * distance * distance / (sigma * sigma)) * band[i];
+    weight += std::exp(-0.5 * distance * distance / (sigma * sigma));
+    }
+  return weightedSum / weight;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+    {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " InputImage Type [upperRange | lowerRange | shift]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  using VolumeType = itk::Image<unsigned short, 3>;
+  using MapType = itk::Image<float, 2>;
+  using ProjectionType = itk::Image<float, 2>;
+  using VolumeReaderType = itk::ImageFileReader<VolumeType>;
+  using FilterType = itk::DepthMapProjectionFilter<VolumeType, MapType, ProjectionType>;
+
+  VolumeReaderType::Pointer reader = VolumeReaderType::New();
+  reader->SetFileName(argv[1]);
+  try
+    {
+    reader->Update();
+    }
+  catch (itk::ExceptionObject &excp)
+    {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+    }
+  VolumeType::Pointer volume = reader->GetOutput();
+  const VolumeType::SizeType size = volume->GetLargestPossibleRegion().GetSize();
+
+  const std::string type = argv[2];
+  FilterType::ArrayType range;
+  range[0] = argc >= 4 ? std::atoi(argv[3]) : 1;
+  range[1] = argc >= 5 ? std::atoi(argv[4]) : 1;
+  const int shift = argc >= 6 ? std::atoi(argv[5]) : 0;
+  const float sigma = 1.5;
+
+  // Depth map with steps, so that adjacent columns have different bands,
+  // some of them clamped by the volume limits.
+  MapType::Pointer map = MapType::New();
+  MapType::RegionType mapRegion;
+  mapRegion.SetSize(0, size[0]);
+  mapRegion.SetSize(1, size[1]);
+  map->SetRegions(mapRegion);
+  map->Allocate();
+  itk::ImageRegionIteratorWithIndex<MapType> mapIte(map, mapRegion);
+  for (; !mapIte.IsAtEnd(); ++mapIte)
+    {
+    const MapType::IndexType index = mapIte.GetIndex();
+    mapIte.Set(static_cast<float>((index[0] / 7 + index[1] / 5) % (size[2] + 2)) - 1);
+    }
+
+  FilterType::Pointer filter = FilterType::New();
+  filter->SetInput(volume);
+  filter->SetMap(map);
+  filter->SetType(type);
+  filter->SetRange(range);
+  filter->SetShift(shift);
+  filter->SetSigma(sigma);
+  try
+    {
+    filter->Update();
+    }
+  catch (itk::ExceptionObject &excp)
+    {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Compare each column with the reference projection of its band.
+  const int projectionSize = static_cast<int>(size[2]);
+  unsigned long mismatch = 0;
+  itk::ImageRegionConstIteratorWithIndex<ProjectionType> outputIte(filter->GetOutput(), filter->GetOutput()->GetLargestPossibleRegion());
+  for (; !outputIte.IsAtEnd(); ++outputIte)
+    {
+    const ProjectionType::IndexType index = outputIte.GetIndex();
+    const int centerDepth = static_cast<int>(map->GetPixel(index)) + shift;
+    const int highDepth = std::min(std::max(centerDepth - range[0], 0), projectionSize - 1);
+    const int lowDepth = std::min(std::max(centerDepth + range[1], 0), projectionSize - 1);
+    std::vector<double> band;
+    for (int depth = highDepth; depth <= lowDepth; depth++)
+      {
+      VolumeType::IndexType voxel = {{index[0], index[1], depth}};
+      band.push_back(volume->GetPixel(voxel));
+      }
+    const double expected = band.empty() ? 0 : ReferenceProjection(type, band, sigma, centerDepth, highDepth);
+    if (std::abs(outputIte.Get() - static_cast<float>(expected)) > 1e-3 * std::max(1.0, std::abs(expected)))
+      {
+      mismatch++;
+      }
+    }
+
+  std::cout << "Mismatching pixels: " << mismatch << std::endl;
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
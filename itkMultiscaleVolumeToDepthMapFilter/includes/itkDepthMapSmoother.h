@@ -0,0 +1,165 @@
+#ifndef __itkDepthMapSmoother_h
+#define __itkDepthMapSmoother_h
+
+#include <vector>
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkFixedArray.h"
+#include "itkImage.h"
+
+namespace itk
+{
+
+/** \class DepthMapSmoother
+ * \brief Gaussian smoothing of a map, in a float buffer reused from call to call.
+ *
+ * Smooth() reads the input map once into a float working buffer, filters the
+ * buffer in place one dimension after the other, and writes the output pixel
+ * type directly, as a cast of the smoothed value. It replaces the cast,
+ * DiscreteGaussianImageFilter and cast chain of the map regularisation, without
+ * any intermediate image, and the input and output can be the same image.
+ *
+ * Each dimension of positive variance (m_Variance, in pixels, or in physical
+ * units with m_UseImageSpacing on) is filtered by the kernel of
+ * GaussianOperator, within m_MaximumError and m_MaximumKernelWidth as the
+ * DiscreteGaussianImageFilter, or by the recursive Gaussian of Young and van
+ * Vliet when the kernel would not fit in m_MaximumKernelWidth. The map edges
+ * are extended by their value (zero flux Neumann condition).
+ *
+ * Smoothing a region reads the input within the kernel radius around it, or
+ * along the whole map in the recursive dimensions, so that the region has the
+ * values of the whole map smoothed.
+ *
+ * The buffer is kept between calls, Reserve() allocating it once for the
+ * largest map, so a smoother must not be shared by concurrent calls.
+ *
+ * \author Stephane U. Rigaud (stephane.rigaud@pasteur.fr)
+ */
+template <class TInputImage, class TOutputImage = TInputImage>
+class DepthMapSmoother : public Object
+{
+public:
+  ITK_DISALLOW_COPY_AND_ASSIGN(DepthMapSmoother);
+
+  /** Standard class typedefs. **/
+  using Self = DepthMapSmoother;
+  using Superclass = Object;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  /** Method for creation through the object factory. **/
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). **/
+  itkTypeMacro(DepthMapSmoother, Object);
+
+  static constexpr unsigned int ImageDimension = TInputImage::ImageDimension;
+
+  using InputImageType = TInputImage;
+  using OutputImageType = TOutputImage;
+  using OutputPixelType = typename OutputImageType::PixelType;
+  using RegionType = typename InputImageType::RegionType;
+  using IndexType = typename InputImageType::IndexType;
+  using SizeType = typename InputImageType::SizeType;
+  using ArrayType = FixedArray<double, ImageDimension>;
+  using ValueType = float;
+
+  itkSetMacro(Variance, ArrayType);
+  itkGetConstReferenceMacro(Variance, ArrayType);
+  itkSetMacro(MaximumError, double);
+  itkGetMacro(MaximumError, double);
+  itkSetMacro(MaximumKernelWidth, unsigned int);
+  itkGetMacro(MaximumKernelWidth, unsigned int);
+  itkSetMacro(UseImageSpacing, bool);
+  itkGetMacro(UseImageSpacing, bool);
+  itkBooleanMacro(UseImageSpacing);
+  itkSetMacro(NumberOfWorkUnits, unsigned int);
+  itkGetMacro(NumberOfWorkUnits, unsigned int);
+
+  void
+  SetVariance(double variance)
+  {
+    ArrayType varianceArray;
+    varianceArray.Fill(variance);
+    this->SetVariance(varianceArray);
+  }
+
+  /** Kernel radius of each dimension for the spacing of the image, the whole
+   * map size in the recursive dimensions. **/
+  SizeType
+  GetRadius(const InputImageType *) const;
+
+  /** Whether a dimension is filtered recursively for the spacing of the image. **/
+  bool
+  IsRecursive(const InputImageType *, unsigned int) const;
+
+  /** Allocate the buffer for maps of up to the given number of pixels. **/
+  void
+  Reserve(SizeValueType numberOfPixels)
+  {
+    m_Buffer.reserve(numberOfPixels);
+  }
+
+  /** Size of the working buffer in bytes. **/
+  SizeValueType
+  GetNumberOfBytes() const
+  {
+    return m_Buffer.capacity() * sizeof(ValueType);
+  }
+
+  /** Smooth the buffered region of the input into the output, or only a region. **/
+  void
+  Smooth(const InputImageType *input, OutputImageType *output)
+  {
+    this->Smooth(input, output, input->GetBufferedRegion());
+  }
+  void
+  Smooth(const InputImageType *, OutputImageType *, const RegionType &);
+
+protected:
+  DepthMapSmoother();
+  ~DepthMapSmoother() override = default;
+
+  void
+  PrintSelf(std::ostream &os, Indent indent) const override;
+
+  /** Filter of one dimension: the kernel coefficients, or the coefficients of
+   * the recursive filter, none for a dimension left as is. **/
+  struct KernelType
+  {
+    std::vector<double> coefficients;
+    bool recursive = false;
+    double b[4] = {1, 0, 0, 0};
+    double gain = 1;
+  };
+
+  KernelType
+  ComputeKernel(const InputImageType *, unsigned int) const;
+
+  /** Filter a line of a given length, the output not aliasing the input. **/
+  static void
+  FilterLine(const KernelType &, const double *, double *, SizeValueType);
+
+  /** Run a function on [0, count) split in chunks, over the work units. **/
+  template <typename TFunction>
+  void
+  ParallelizeChunks(SizeValueType count, const TFunction &function) const;
+
+private:
+  ArrayType m_Variance;
+  double m_MaximumError;
+  unsigned int m_MaximumKernelWidth;
+  bool m_UseImageSpacing;
+  unsigned int m_NumberOfWorkUnits;
+
+  std::vector<ValueType> m_Buffer;
+};
+
+} // namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkDepthMapSmoother.hxx"
+#endif
+
+#endif // __itkDepthMapSmoother_h
@@ -0,0 +1,307 @@
+#ifndef __itkDepthMapSmoother_hxx
+#define __itkDepthMapSmoother_hxx
+
+#include "itkDepthMapSmoother.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "itkGaussianOperator.h"
+#include "itkMultiThreaderBase.h"
+
+namespace itk
+{
+
+template <class TInputImage, class TOutputImage>
+DepthMapSmoother<TInputImage, TOutputImage>
+::DepthMapSmoother()
+{
+  m_Variance.Fill(0);
+  m_MaximumError = 0.01;
+  m_MaximumKernelWidth = 32;
+  m_UseImageSpacing = false;
+  m_NumberOfWorkUnits = MultiThreaderBase::GetGlobalDefaultNumberOfThreads();
+}
+
+template <class TInputImage, class TOutputImage>
+typename DepthMapSmoother<TInputImage, TOutputImage>::KernelType
+DepthMapSmoother<TInputImage, TOutputImage>
+::ComputeKernel(const InputImageType *image, unsigned int dimension) const
+{
+  KernelType kernel;
+  double variance = m_Variance[dimension];
+  if (m_UseImageSpacing)
+    {
+    const double spacing = image->GetSpacing()[dimension];
+    variance /= spacing * spacing;
+    }
+  if (variance <= 0)
+    {
+    return kernel;
+    }
+
+  // Kernels of a radius of 3 sigma fitting in the maximum width.
+  const double sigma = std::sqrt(variance);
+  if (6 * sigma + 1 <= m_MaximumKernelWidth || sigma < 0.5)
+    {
+    GaussianOperator<double, ImageDimension> gaussianOperator;
+    gaussianOperator.SetDirection(dimension);
+    gaussianOperator.SetVariance(variance);
+    gaussianOperator.SetMaximumError(m_MaximumError);
+    gaussianOperator.SetMaximumKernelWidth(m_MaximumKernelWidth);
+    gaussianOperator.CreateDirectional();
+    for (SizeValueType i = 0; i < gaussianOperator.Size(); i++)
+      {
+      kernel.coefficients.push_back(gaussianOperator[i]);
+      }
+    return kernel;
+    }
+
+  // Young and van Vliet, "Recursive implementation of the Gaussian filter", 1995.
+  const double q = sigma >= 2.5 ? 0.98711 * sigma - 0.96330 : 3.97156 - 4.14554 * std::sqrt(1 - 0.26891 * sigma);
+  const double b0 = 1.57825 + 2.44413 * q + 1.4281 * q * q + 0.422205 * q * q * q;
+  kernel.recursive = true;
+  kernel.b[1] = (2.44413 * q + 2.85619 * q * q + 1.26661 * q * q * q) / b0;
+  kernel.b[2] = -(1.4281 * q * q + 1.26661 * q * q * q) / b0;
+  kernel.b[3] = 0.422205 * q * q * q / b0;
+  kernel.gain = 1 - (kernel.b[1] + kernel.b[2] + kernel.b[3]);
+  return kernel;
+}
+
+template <class TInputImage, class TOutputImage>
+typename DepthMapSmoother<TInputImage, TOutputImage>::SizeType
+DepthMapSmoother<TInputImage, TOutputImage>
+::GetRadius(const InputImageType *image) const
+{
+  SizeType radius;
+  for (unsigned int i = 0; i < ImageDimension; i++)
+    {
+    const KernelType kernel = this->ComputeKernel(image, i);
+    radius[i] = kernel.recursive ? image->GetLargestPossibleRegion().GetSize(i) : kernel.coefficients.size() / 2;
+    }
+  return radius;
+}
+
+template <class TInputImage, class TOutputImage>
+bool
+DepthMapSmoother<TInputImage, TOutputImage>
+::IsRecursive(const InputImageType *image, unsigned int dimension) const
+{
+  return this->ComputeKernel(image, dimension).recursive;
+}
+
+template <class TInputImage, class TOutputImage>
+void
+DepthMapSmoother<TInputImage, TOutputImage>
+::FilterLine(const KernelType &kernel, const double *input, double *output, SizeValueType length)
+{
+  if (kernel.recursive)
+    {
+    // Causal then anti-causal pass, from the steady state of the edge values.
+    double w1 = input[0];
+    double w2 = w1;
+    double w3 = w1;
+    for (SizeValueType i = 0; i < length; i++)
+      {
+      const double w = kernel.gain * input[i] + kernel.b[1] * w1 + kernel.b[2] * w2 + kernel.b[3] * w3;
+      output[i] = w;
+      w3 = w2;
+      w2 = w1;
+      w1 = w;
+      }
+    double y1 = output[length - 1];
+    double y2 = y1;
+    double y3 = y1;
+    for (SizeValueType i = length; i-- > 0;)
+      {
+      const double y = kernel.gain * output[i] + kernel.b[1] * y1 + kernel.b[2] * y2 + kernel.b[3] * y3;
+      output[i] = y;
+      y3 = y2;
+      y2 = y1;
+      y1 = y;
+      }
+    return;
+    }
+
+  // Kernel, the positions beyond the line edges reading the edge values.
+  const OffsetValueType radius = static_cast<OffsetValueType>(kernel.coefficients.size() / 2);
+  const OffsetValueType last = static_cast<OffsetValueType>(length) - 1;
+  for (OffsetValueType i = 0; i <= last; i++)
+    {
+    double value = 0;
+    if (i >= radius && i + radius <= last)
+      {
+      const double *window = input + i - radius;
+      for (OffsetValueType k = 0; k <= 2 * radius; k++)
+        {
+        value += kernel.coefficients[k] * window[k];
+        }
+      }
+    else
+      {
+      for (OffsetValueType k = 0; k <= 2 * radius; k++)
+        {
+        value += kernel.coefficients[k] * input[std::min(std::max<OffsetValueType>(i + k - radius, 0), last)];
+        }
+      }
+    output[i] = value;
+    }
+}
+
+template <class TInputImage, class TOutputImage>
+template <typename TFunction>
+void
+DepthMapSmoother<TInputImage, TOutputImage>
+::ParallelizeChunks(SizeValueType count, const TFunction &function) const
+{
+  const SizeValueType numberOfChunks = std::max<SizeValueType>(std::min<SizeValueType>(m_NumberOfWorkUnits, count), 1);
+  if (numberOfChunks == 1)
+    {
+    function(0, count);
+    return;
+    }
+  MultiThreaderBase::Pointer threader = MultiThreaderBase::New();
+  threader->SetNumberOfWorkUnits(numberOfChunks);
+  threader->ParallelizeArray(
+    0,
+    numberOfChunks,
+    [&](SizeValueType chunk) { function(chunk * count / numberOfChunks, (chunk + 1) * count / numberOfChunks); },
+    nullptr);
+}
+
+template <class TInputImage, class TOutputImage>
+void
+DepthMapSmoother<TInputImage, TOutputImage>
+::Smooth(const InputImageType *input, OutputImageType *output, const RegionType &region)
+{
+  if (!input->GetBufferedRegion().IsInside(region) || !output->GetBufferedRegion().IsInside(region))
+    {
+    itkExceptionMacro(<< "Region " << region << " is not buffered by the input and the output.");
+    }
+  if (region.GetNumberOfPixels() == 0)
+    {
+    return;
+    }
+
+  // The region is read within the kernel radius, and whole along the recursive dimensions.
+  std::vector<KernelType> kernels;
+  SizeType radius;
+  for (unsigned int i = 0; i < ImageDimension; i++)
+    {
+    kernels.push_back(this->ComputeKernel(input, i));
+    radius[i] = kernels[i].coefficients.size() / 2;
+    }
+  RegionType bufferRegion = region;
+  bufferRegion.PadByRadius(radius);
+  for (unsigned int i = 0; i < ImageDimension; i++)
+    {
+    if (kernels[i].recursive)
+      {
+      bufferRegion.SetIndex(i, input->GetBufferedRegion().GetIndex(i));
+      bufferRegion.SetSize(i, input->GetBufferedRegion().GetSize(i));
+      }
+    }
+  bufferRegion.Crop(input->GetBufferedRegion());
+
+  const SizeType bufferSize = bufferRegion.GetSize();
+  const SizeValueType numberOfPixels = bufferRegion.GetNumberOfPixels();
+  SizeValueType strides[ImageDimension];
+  strides[0] = 1;
+  for (unsigned int i = 1; i < ImageDimension; i++)
+    {
+    strides[i] = strides[i - 1] * bufferSize[i - 1];
+    }
+  m_Buffer.resize(numberOfPixels);
+  ValueType *buffer = m_Buffer.data();
+
+  // First pixel of a line along the first dimension of a region.
+  auto GetLineIndex = [](const RegionType &lineRegion, SizeValueType line) -> IndexType {
+    IndexType index = lineRegion.GetIndex();
+    for (unsigned int i = 1; i < ImageDimension; i++)
+      {
+      index[i] += line % lineRegion.GetSize(i);
+      line /= lineRegion.GetSize(i);
+      }
+    return index;
+  };
+
+  // Read the input, as float.
+  const typename InputImageType::PixelType *inputBuffer = input->GetBufferPointer();
+  this->ParallelizeChunks(numberOfPixels / bufferSize[0], [&](SizeValueType first, SizeValueType last) {
+    for (SizeValueType line = first; line < last; line++)
+      {
+      const auto *inputLine = inputBuffer + input->ComputeOffset(GetLineIndex(bufferRegion, line));
+      ValueType *bufferLine = buffer + line * bufferSize[0];
+      for (SizeValueType i = 0; i < bufferSize[0]; i++)
+        {
+        bufferLine[i] = static_cast<ValueType>(inputLine[i]);
+        }
+      }
+  });
+
+  // Filter the buffer in place along each dimension, line by line.
+  for (unsigned int d = 0; d < ImageDimension; d++)
+    {
+    const KernelType &kernel = kernels[d];
+    if (!kernel.recursive && kernel.coefficients.size() <= 1)
+      {
+      continue;
+      }
+    const SizeValueType length = bufferSize[d];
+    const SizeValueType stride = strides[d];
+    this->ParallelizeChunks(numberOfPixels / length, [&](SizeValueType first, SizeValueType last) {
+      std::vector<double> inputLine(length);
+      std::vector<double> outputLine(length);
+      for (SizeValueType line = first; line < last; line++)
+        {
+        ValueType *bufferLine = buffer + line % stride + (line / stride) * stride * length;
+        for (SizeValueType i = 0; i < length; i++)
+          {
+          inputLine[i] = bufferLine[i * stride];
+          }
+        FilterLine(kernel, inputLine.data(), outputLine.data(), length);
+        for (SizeValueType i = 0; i < length; i++)
+          {
+          bufferLine[i * stride] = static_cast<ValueType>(outputLine[i]);
+          }
+        }
+    });
+    }
+
+  // Write the region, as the output pixel type.
+  OutputPixelType *outputBuffer = output->GetBufferPointer();
+  this->ParallelizeChunks(region.GetNumberOfPixels() / region.GetSize(0), [&](SizeValueType first, SizeValueType last) {
+    for (SizeValueType line = first; line < last; line++)
+      {
+      const IndexType index = GetLineIndex(region, line);
+      SizeValueType offset = 0;
+      for (unsigned int i = 0; i < ImageDimension; i++)
+        {
+        offset += static_cast<SizeValueType>(index[i] - bufferRegion.GetIndex(i)) * strides[i];
+        }
+      OutputPixelType *outputLine = outputBuffer + output->ComputeOffset(index);
+      for (SizeValueType i = 0; i < region.GetSize(0); i++)
+        {
+        outputLine[i] = static_cast<OutputPixelType>(buffer[offset + i]);
+        }
+      }
+  });
+}
+
+template <class TInputImage, class TOutputImage>
+void
+DepthMapSmoother<TInputImage, TOutputImage>
+::PrintSelf(std::ostream &os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Variance: " << m_Variance << std::endl;
+  os << indent << "MaximumError: " << m_MaximumError << std::endl;
+  os << indent << "MaximumKernelWidth: " << m_MaximumKernelWidth << std::endl;
+  os << indent << "UseImageSpacing: " << m_UseImageSpacing << std::endl;
+  os << indent << "NumberOfWorkUnits: " << m_NumberOfWorkUnits << std::endl;
+  os << indent << "Buffer: " << this->GetNumberOfBytes() << " bytes" << std::endl;
+}
+
+} // namespace itk
+
+#endif // __itkDepthMapSmoother_hxx
@@ -0,0 +1,234 @@
+#ifndef __itkDepthMapTaskGraph_h
+#define __itkDepthMapTaskGraph_h
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace itk
+{
+
+/** \class DepthMapTaskGraph
+ * \brief Tasks with dependencies, run by a work stealing thread pool.
+ *
+ * A task is run once all the tasks it depends on are done, so that independent
+ * parts of successive stages overlap instead of waiting at a barrier between
+ * stages. Each worker holds a deque of ready tasks: the tasks a worker makes
+ * ready are pushed on its own deque and the worker runs the newest one first,
+ * its data being still in cache, while idle workers steal the oldest tasks of
+ * the others.
+ *
+ * The first exception thrown by a task stops the workers and is rethrown by
+ * Run(). The start and stop times of each task, in seconds from the start of
+ * Run(), are available once it returns.
+ *
+ * \author Stephane U. Rigaud (stephane.rigaud@pasteur.fr)
+ */
+class DepthMapTaskGraph
+{
+public:
+  using TaskIdType = size_t;
+  using FunctionType = std::function<void()>;
+
+  /** Add a task, return its identifier. */
+  TaskIdType
+  AddTask(const FunctionType &function)
+  {
+    m_Functions.push_back(function);
+    m_Successors.emplace_back();
+    m_NumberOfDependencies.push_back(0);
+    return m_Functions.size() - 1;
+  }
+
+  /** Run the task after its dependency. */
+  void
+  AddDependency(TaskIdType task, TaskIdType dependency)
+  {
+    m_Successors[dependency].push_back(task);
+    m_NumberOfDependencies[task]++;
+  }
+
+  TaskIdType
+  GetNumberOfTasks() const
+  {
+    return m_Functions.size();
+  }
+
+  double
+  GetStartTime(TaskIdType task) const
+  {
+    return m_StartTimes[task];
+  }
+
+  double
+  GetStopTime(TaskIdType task) const
+  {
+    return m_StopTimes[task];
+  }
+
+  /** Run all the tasks with the given number of threads, the calling one included. */
+  void
+  Run(unsigned int numberOfThreads)
+  {
+    const TaskIdType numberOfTasks = m_Functions.size();
+    numberOfThreads = std::max(numberOfThreads, 1u);
+    m_Remaining.reset(new std::atomic<unsigned int>[numberOfTasks]);
+    m_Queues.clear();
+    for (unsigned int w = 0; w < numberOfThreads; w++)
+      {
+      m_Queues.emplace_back(new WorkerQueue);
+      }
+    m_StartTimes.assign(numberOfTasks, 0);
+    m_StopTimes.assign(numberOfTasks, 0);
+    m_Pending = numberOfTasks;
+    m_Abort = false;
+    m_Exception = nullptr;
+    m_Start = std::chrono::steady_clock::now();
+
+    // Tasks without dependencies are dealt between the workers.
+    unsigned int worker = 0;
+    for (TaskIdType task = 0; task < numberOfTasks; task++)
+      {
+      m_Remaining[task] = m_NumberOfDependencies[task];
+      if (m_NumberOfDependencies[task] == 0)
+        {
+        m_Queues[worker]->tasks.push_back(task);
+        worker = (worker + 1) % numberOfThreads;
+        }
+      }
+
+    std::vector<std::thread> threads;
+    for (unsigned int w = 1; w < numberOfThreads; w++)
+      {
+      threads.emplace_back(&DepthMapTaskGraph::Work, this, w);
+      }
+    this->Work(0);
+    for (auto &thread : threads)
+      {
+      thread.join();
+      }
+    m_Queues.clear();
+    if (m_Exception)
+      {
+      std::rethrow_exception(m_Exception);
+      }
+  }
+
+private:
+  struct WorkerQueue
+  {
+    std::mutex mutex;
+    std::deque<TaskIdType> tasks;
+  };
+
+  /** Newest task of the worker, or oldest task of another one. */
+  bool
+  Pop(unsigned int worker, TaskIdType &task)
+  {
+    {
+    std::lock_guard<std::mutex> lock(m_Queues[worker]->mutex);
+    if (!m_Queues[worker]->tasks.empty())
+      {
+      task = m_Queues[worker]->tasks.back();
+      m_Queues[worker]->tasks.pop_back();
+      return true;
+      }
+    }
+    for (size_t k = 1; k < m_Queues.size(); k++)
+      {
+      WorkerQueue &victim = *m_Queues[(worker + k) % m_Queues.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (!victim.tasks.empty())
+        {
+        task = victim.tasks.front();
+        victim.tasks.pop_front();
+        return true;
+        }
+      }
+    return false;
+  }
+
+  void
+  Work(unsigned int worker)
+  {
+    while (m_Pending > 0 && !m_Abort)
+      {
+      TaskIdType task;
+      if (!this->Pop(worker, task))
+        {
+        // Wait for a task to be made ready, or for the last one to be done.
+        std::unique_lock<std::mutex> lock(m_IdleMutex);
+        m_Idle.wait_for(lock, std::chrono::milliseconds(1));
+        continue;
+        }
+
+      m_StartTimes[task] = this->GetTime();
+      try
+        {
+        m_Functions[task]();
+        }
+      catch (...)
+        {
+        std::lock_guard<std::mutex> lock(m_IdleMutex);
+        if (!m_Abort)
+          {
+          m_Exception = std::current_exception();
+          m_Abort = true;
+          }
+        m_Idle.notify_all();
+        return;
+        }
+      m_StopTimes[task] = this->GetTime();
+
+      // Successors made ready are run by this worker first.
+      bool ready = false;
+      for (TaskIdType successor : m_Successors[task])
+        {
+        if (--m_Remaining[successor] == 0)
+          {
+          std::lock_guard<std::mutex> lock(m_Queues[worker]->mutex);
+          m_Queues[worker]->tasks.push_back(successor);
+          ready = true;
+          }
+        }
+      if (--m_Pending == 0 || ready)
+        {
+        m_Idle.notify_all();
+        }
+      }
+  }
+
+  double
+  GetTime() const
+  {
+    const std::chrono::duration<double> time = std::chrono::steady_clock::now() - m_Start;
+    return time.count();
+  }
+
+  std::vector<FunctionType> m_Functions;
+  std::vector<std::vector<TaskIdType>> m_Successors;
+  std::vector<unsigned int> m_NumberOfDependencies;
+  std::vector<double> m_StartTimes;
+  std::vector<double> m_StopTimes;
+
+  std::unique_ptr<std::atomic<unsigned int>[]> m_Remaining;
+  std::vector<std::unique_ptr<WorkerQueue>> m_Queues;
+  std::atomic<TaskIdType> m_Pending;
+  std::atomic<bool> m_Abort;
+  std::exception_ptr m_Exception;
+  std::mutex m_IdleMutex;
+  std::condition_variable m_Idle;
+  std::chrono::steady_clock::time_point m_Start;
+};
+
+} // namespace itk
+
+#endif // __itkDepthMapTaskGraph_h
@@ -1,13 +1,15 @@
 #ifndef __itkMultiscaleVolumeToDepthMapFilter_h
 #define __itkMultiscaleVolumeToDepthMapFilter_h
 
+#include <ctime>
+#include <chrono>
+#include <string>
+#include <vector>
+
 #include "itkImageToImageFilter.h"
 #include "itkMultiResolutionPyramidImageFilter.h"
-#include "itkDiscreteGaussianImageFilter.h"
-#include "itkBSplineInterpolateImageFunction.h"
-#include "itkResampleImageFilter.h"
-#include "itkCastImageFilter.h"
 #include "itkVolumeToDepthMapFilter.h"
+#include "itkDepthMapSmoother.h"
 
 namespace itk
 {
@@ -20,6 +22,78 @@ namespace itk
  * A multiscale resolution pyramid is use to compute the depth map at each scale and
  * use the previous scale as an initialisation step.
  *
+ * The pyramid (m_Pyramid) can be:
+ * - a Gaussian pyramid, MultiResolutionPyramidImageFilter (value = 0, default),
+ * - a block max pooling pyramid (value = 1),
+ * - a block mean pooling pyramid (value = 2).
+ * The block pyramids reduce the volume along the non projected dimensions only,
+ * each level being built from the next finer one, or from the input for the mean
+ * pooling. The finest level is the input itself and levels are released once
+ * processed. If the coarser levels do not fit together in m_MaximumMemory (bytes,
+ * 0 for no limit), each level is built from the input when needed so that only
+ * one level is held at a time, the budget holding the largest coarser level. As no smoothing is
+ * applied, the depth map can slightly differ from the one of the Gaussian pyramid.
+ *
+ * The depth map of the previous level is given as is to the VolumeToDepthMapFilter,
+ * which reads it at the position of each column of the current level with nearest
+ * neighbour (m_Interpolation = 0) or linear (value = 1, default) interpolation.
+ * The time spent on each level, in seconds, is available with GetLevelTimes().
+ *
+ * The map of each level is regularised in place by a Gaussian of variance
+ * m_Sigma (DepthMapSmoother), which converts it to a float buffer reused from
+ * level to level, sized once for the finest level, and writes the smoothed
+ * values back into the map.
+ *
+ * With m_AdaptiveRange on, the band of each column is adapted to the local
+ * confidence of the previous level: its width on each side is m_MinimumRange
+ * plus the largest depth jump between the previous map pixel and its
+ * neighbours, bounded by m_MaximumRange rather than by m_Range. The band is
+ * narrower than m_Range where the surface is smooth, and wider near folds and
+ * discontinuities. The mean band width of each
+ * level, in pixels, is available with GetLevelBandWidths(), the coarsest level
+ * searching the whole columns.
+ *
+ * With m_Profiling on (off by default), GetProfile() details each stage of each
+ * level: pyramid reduction, depth search and Gaussian regularisation of the map,
+ * with their wall and CPU time, voxels processed and bytes allocated.
+ *
+ * With m_Wavefront on (off by default), a block pyramid is run as a task graph
+ * instead of level by level: each level is split into tiles of m_TileSize
+ * pixels along the non projected dimensions, and the reduction, depth search,
+ * range map and smoothing of each tile are tasks that start as soon as the
+ * tiles they read are done, e.g. a fine tile as soon as the coarse tiles under
+ * the support of its initialisation are smoothed. The tasks are run by a work
+ * stealing thread pool (DepthMapTaskGraph) of GetNumberOfWorkUnits() threads,
+ * without barrier between the stages and levels. All the levels of the pyramid
+ * are held, and the result is the one of the level by level run. As levels
+ * overlap, each level time is the span of its tasks, and in the profile the
+ * wall time of a stage is its span and its CPU time the sum of its task times.
+ * The Gaussian pyramid, a projection along another dimension than the last
+ * one, levels not fitting in m_MaximumMemory, or pyramid levels, fall back to
+ * the level by level run.
+ *
+ * For time series, the depth map of the previous timepoint can be given as a
+ * warm start (m_WarmStart, of the output size). The finest level is then directly
+ * searched in the narrow band m_WarmStartRange around it, skipping the coarse
+ * levels. The map is checked by tiles of m_WarmStartTileSize pixels: a tile fails
+ * when more than m_WarmStartTolerance of its columns reach the edge of their band,
+ * the surface having moved further than the range. The full pyramid is then run
+ * on the bounding box of the failed tiles only, and replaces them.
+ * GetNumberOfFailedTiles() returns their number, and the first level time is the
+ * one of the warm started level.
+ *
+ * A plane operator (m_PlaneOperator, see DepthMapPlaneOperator) preprocesses each
+ * level during its depth search, without a preprocessed volume being allocated.
+ * The pyramid is built from the input, and the operator is shrunk with each level,
+ * e.g. the local variance box keeps its physical size.
+ *
+ * With m_KeepPyramidLevels on (off by default) the volumes of all the
+ * levels are held once searched and available with GetPyramidLevels(). Given
+ * back with SetPyramidLevels(), one per level, they replace the pyramid of the
+ * input, e.g. for filters of other peak, tolerance or sigma parameters but of
+ * the same number of levels. The given levels are only read, so that they can
+ * be shared by filters updated concurrently. Neither is used with a warm start.
+ *
  * \author Stephane U. Rigaud (stephane.rigaud@pasteur.fr)
  */
 template <class TInputImage, class TOutputImage>
@@ -74,20 +148,31 @@ public:
   using OutputPointType = typename OutputImageType::PointType;
   using OutputIndexValueType = typename OutputImageType::IndexValueType;
 
-  using InternalImageType = Image<float, OutputImageDimension>;
-  using InternalCastFilterType = CastImageFilter<OutputImageType, InternalImageType>;
-  using OutputCastFilterType = CastImageFilter<InternalImageType, OutputImageType>;
-
   using MultiResolutionPyramidImageFilterType = MultiResolutionPyramidImageFilter<InputImageType, InputImageType>;
   using ScheduleType = typename MultiResolutionPyramidImageFilterType::ScheduleType;
   using VolumeToDepthMapFilterType = VolumeToDepthMapFilter<InputImageType, OutputImageType>;
   using RangeArrayType = typename VolumeToDepthMapFilterType::ArrayType;
-  using GaussianFilterType = DiscreteGaussianImageFilter<InternalImageType, InternalImageType>;
-  using SigmaArrayType = typename GaussianFilterType::ArrayType;
+  using PlaneOperatorType = typename VolumeToDepthMapFilterType::PlaneOperatorType;
+  using PlaneOperatorPointer = typename VolumeToDepthMapFilterType::PlaneOperatorPointer;
+  using PyramidLevelsType = std::vector<InputImagePointer>;
+  using SmootherType = DepthMapSmoother<OutputImageType>;
+  using SigmaArrayType = typename SmootherType::ArrayType;
 
-  using ImageInterpolatorType = BSplineInterpolateImageFunction<OutputImageType, float, float>;
-  using ResampleFilterType = ResampleImageFilter<OutputImageType, OutputImageType, float, float>;
-  using TransformType = IdentityTransform<float, OutputImageDimension>;
+  using LevelTimesType = std::vector<double>;
+  using LevelBandWidthsType = std::vector<double>;
+
+  /** Profile of one stage of one level, times in seconds. */
+  struct StageProfileType
+  {
+    unsigned int level;
+    std::string stage;
+    double wallTime;
+    double cpuTime;
+    SizeValueType voxels;
+    SizeValueType bytes;
+    double bandWidth;
+  };
+  using ProfileType = std::vector<StageProfileType>;
 
   itkSetMacro(NumberOfLevels, unsigned int);
   itkSetMacro(Schedule, ScheduleType);
@@ -95,6 +180,26 @@ public:
   itkSetMacro(Tolerance, float);
   itkSetMacro(Peak, unsigned int);
   itkSetMacro(Range, RangeArrayType);
+  itkSetMacro(AdaptiveRange, bool);
+  itkBooleanMacro(AdaptiveRange);
+  itkSetMacro(MinimumRange, unsigned int);
+  itkSetMacro(MaximumRange, unsigned int);
+  itkSetMacro(Pyramid, unsigned int);
+  itkSetMacro(MaximumMemory, SizeValueType);
+  itkSetMacro(Interpolation, unsigned int);
+  itkSetMacro(WarmStart, OutputImagePointer);
+  itkSetMacro(WarmStartRange, RangeArrayType);
+  itkSetMacro(WarmStartTileSize, SizeValueType);
+  itkSetMacro(WarmStartTolerance, float);
+  itkSetMacro(PlaneOperator, PlaneOperatorPointer);
+  itkSetMacro(Profiling, bool);
+  itkBooleanMacro(Profiling);
+  itkSetMacro(Wavefront, bool);
+  itkBooleanMacro(Wavefront);
+  itkSetMacro(TileSize, SizeValueType);
+  itkSetMacro(KeepPyramidLevels, bool);
+  itkBooleanMacro(KeepPyramidLevels);
+  itkSetMacro(PyramidLevels, PyramidLevelsType);
 
   itkGetMacro(NumberOfLevels, unsigned int);
   itkGetMacro(Schedule, ScheduleType);
@@ -102,6 +207,26 @@ public:
   itkGetMacro(Tolerance, float);
   itkGetMacro(Peak, unsigned int);
   itkGetMacro(Range, RangeArrayType);
+  itkGetMacro(AdaptiveRange, bool);
+  itkGetMacro(MinimumRange, unsigned int);
+  itkGetMacro(MaximumRange, unsigned int);
+  itkGetMacro(Pyramid, unsigned int);
+  itkGetMacro(MaximumMemory, SizeValueType);
+  itkGetMacro(Interpolation, unsigned int);
+  itkGetMacro(WarmStart, OutputImagePointer);
+  itkGetMacro(WarmStartRange, RangeArrayType);
+  itkGetMacro(WarmStartTileSize, SizeValueType);
+  itkGetMacro(WarmStartTolerance, float);
+  itkGetMacro(PlaneOperator, PlaneOperatorPointer);
+  itkGetConstReferenceMacro(LevelTimes, LevelTimesType);
+  itkGetConstReferenceMacro(LevelBandWidths, LevelBandWidthsType);
+  itkGetMacro(NumberOfFailedTiles, SizeValueType);
+  itkGetMacro(Profiling, bool);
+  itkGetConstReferenceMacro(Profile, ProfileType);
+  itkGetMacro(Wavefront, bool);
+  itkGetMacro(TileSize, SizeValueType);
+  itkGetMacro(KeepPyramidLevels, bool);
+  itkGetConstReferenceMacro(PyramidLevels, PyramidLevelsType);
 
   itkGetConstReferenceMacro(ProjectionDimension, unsigned int);
 
@@ -119,15 +244,49 @@ protected:
   /** Determine compute schedule. */
   void ScheduleFromLevels();
 
+  /** Size in pixels of a pyramid level. */
+  SizeValueType GetNumberOfPixelsAtLevel(unsigned int level) const;
+
+  /** Reduce a volume by blocks of the given size, using max or mean pooling. */
+  InputImagePointer BlockReduce(const InputImageType *, const InputSizeType &);
+  InputImagePointer AllocateBlockReduce(const InputImageType *, const InputSizeType &) const;
+  void BlockReduceRegion(const InputImageType *, const InputSizeType &, InputImageType *, const InputRegionType &) const;
+
+  /** Gaussian variance of the map regularisation, and plane operator of a level. */
+  SigmaArrayType GetSmoothingVariance() const;
+  PlaneOperatorPointer GetLevelPlaneOperator(const InputImageType *) const;
+
+  /** Smooth a region of a map, reading it within the given kernel radius. */
+  void SmoothMapRegion(const OutputImageType *, OutputImageType *, const OutputRegionType &) const;
+
+  /** Depth map of one level, initialised by a map searched in the given range,
+   * narrowed column by column by the range map if not null. */
+  OutputImagePointer GenerateLevelDepthMap(InputImageType *, OutputImageType *, const RangeArrayType &,
+                                           OutputImageType *, unsigned int);
+
+  /** Band width of each pixel of a map, from the depth jumps with its neighbours. */
+  OutputImagePointer GenerateRangeMap(const OutputImageType *) const;
+  void GenerateRangeMapRegion(const OutputImageType *, OutputImageType *, const OutputRegionType &) const;
+
+  /** Clocks at the start of a stage, and profile of the stage when profiling. */
+  using StageClockType = std::pair<std::chrono::steady_clock::time_point, std::clock_t>;
+  StageClockType StartStage() const;
+  void StopStage(const StageClockType &, unsigned int, const char *, SizeValueType, SizeValueType, double = 0);
+
+  /** Depth map of a volume through the whole pyramid. */
+  OutputImagePointer GeneratePyramidDepthMap(InputImageType *);
+
+  /** Depth map of a volume through the whole block pyramid, as a tile wavefront. */
+  OutputImagePointer GenerateWavefrontDepthMap(InputImageType *);
+
+  /** Warm start consistency check, return the number of failed tiles. */
+  SizeValueType GetWarmStartTile(const OutputRegionType &, const OutputIndexType &) const;
+  SizeValueType CheckWarmStart(const OutputImageType *, std::vector<bool> &) const;
+
 private:
   typename MultiResolutionPyramidImageFilterType::Pointer m_MultiscalePyramideImageFilter;
   typename VolumeToDepthMapFilterType::Pointer m_DepthMapFilter;
-  typename GaussianFilterType::Pointer m_GaussianFilter;
-  typename InternalCastFilterType::Pointer m_InternalCastFilter;
-  typename OutputCastFilterType::Pointer m_OutputCastFilter;
-  typename ImageInterpolatorType::Pointer m_Interpolator;
-  typename ResampleFilterType::Pointer m_ResampleFilter;
-  typename TransformType::Pointer m_Transform;
+  typename SmootherType::Pointer m_Smoother;
 
   ScheduleType m_Schedule;
   float m_Sigma;
@@ -136,6 +295,26 @@ private:
   unsigned int m_ProjectionDimension;
   unsigned int m_Peak;
   RangeArrayType m_Range;
+  bool m_AdaptiveRange;
+  unsigned int m_MinimumRange;
+  unsigned int m_MaximumRange;
+  unsigned int m_Pyramid;
+  SizeValueType m_MaximumMemory;
+  unsigned int m_Interpolation;
+  LevelTimesType m_LevelTimes;
+  LevelBandWidthsType m_LevelBandWidths;
+  OutputImagePointer m_WarmStart;
+  RangeArrayType m_WarmStartRange;
+  SizeValueType m_WarmStartTileSize;
+  float m_WarmStartTolerance;
+  SizeValueType m_NumberOfFailedTiles;
+  PlaneOperatorPointer m_PlaneOperator;
+  bool m_Profiling;
+  ProfileType m_Profile;
+  bool m_Wavefront;
+  SizeValueType m_TileSize;
+  bool m_KeepPyramidLevels;
+  PyramidLevelsType m_PyramidLevels;
 };
 
 } // namespace itk
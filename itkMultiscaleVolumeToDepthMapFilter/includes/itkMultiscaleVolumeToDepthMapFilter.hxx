@@ -3,6 +3,19 @@
 
 #include "itkMultiscaleVolumeToDepthMapFilter.h"
 
+#include <cmath>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "itkDepthMapTaskGraph.h"
+#include "itkImageScanlineConstIterator.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIterator.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkRegionOfInterestImageFilter.h"
+
 namespace itk
 {
 
@@ -12,24 +25,29 @@ MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
 {
   m_MultiscalePyramideImageFilter = MultiResolutionPyramidImageFilterType::New();
   m_DepthMapFilter = VolumeToDepthMapFilterType::New();
-  m_GaussianFilter = GaussianFilterType::New();
-  m_InternalCastFilter = InternalCastFilterType::New();
-  m_OutputCastFilter = OutputCastFilterType::New();
-
-  m_Interpolator = ImageInterpolatorType::New();
-  m_ResampleFilter = ResampleFilterType::New();
-  m_Transform = TransformType::New();
-
-  m_Interpolator->SetSplineOrder(3);
-  m_Transform->SetIdentity();
-  m_ResampleFilter->SetTransform(m_Transform);
-  m_ResampleFilter->SetInterpolator(m_Interpolator);
+  m_Smoother = SmootherType::New();
 
   m_Sigma = 1.5;
   m_Tolerance = 0.5;
   m_NumberOfLevels = 3;
   m_Peak = 0;
   m_Range.Fill(2);
+  m_AdaptiveRange = false;
+  m_MinimumRange = 1;
+  m_MaximumRange = 8;
+  m_Pyramid = 0;
+  m_MaximumMemory = 0;
+  m_Interpolation = 1;
+  m_WarmStart = nullptr;
+  m_WarmStartRange.Fill(4);
+  m_WarmStartTileSize = 32;
+  m_WarmStartTolerance = 0.05;
+  m_NumberOfFailedTiles = 0;
+  m_PlaneOperator = nullptr;
+  m_Profiling = false;
+  m_Wavefront = false;
+  m_TileSize = 64;
+  m_KeepPyramidLevels = false;
 
   m_ProjectionDimension = InputImageDimension - 1;
 }
@@ -179,6 +197,14 @@ MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
     InputRegionType RequestedRegion;
     RequestedRegion.SetSize(inputSize);
     RequestedRegion.SetIndex(inputIndex);
+
+    // The plane operator reads a neighbourhood of each pixel within its plane.
+    if (m_PlaneOperator.IsNotNull())
+      {
+      RequestedRegion.PadByRadius(m_PlaneOperator->GetNeighborhoodRadius(m_ProjectionDimension));
+      RequestedRegion.Crop(this->GetInput()->GetLargestPossibleRegion());
+      }
+
     InputImagePointer input = const_cast<InputImageType *>(this->GetInput());
     input->SetRequestedRegion(RequestedRegion);
     }
@@ -214,15 +240,224 @@ MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
 }
 
 template <class InputImageType, class OutputImageType>
-void 
+SizeValueType
 MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
-::GenerateData()
+::GetNumberOfPixelsAtLevel(unsigned int level) const
 {
-  // Define Input and Output of the filter.
-  InputImagePointer input = InputImageType::New();
-  input->Graft(this->GetInput());
-  this->AllocateOutputs();
+  InputSizeType inputSize = this->GetInput()->GetLargestPossibleRegion().GetSize();
+  SizeValueType numberOfPixels = 1;
+  for (unsigned int j = 0; j < InputImageDimension; j++)
+    {
+    SizeValueType factor = m_Schedule.GetElement(level, j);
+    numberOfPixels *= (inputSize[j] + factor - 1) / factor;
+    }
+  return numberOfPixels;
+}
+
+template <class InputImageType, class OutputImageType>
+typename InputImageType::Pointer
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::AllocateBlockReduce(const InputImageType *image, const InputSizeType &blockSize) const
+{
+  // Geometry of the reduced volume, one pixel per block, centred on the block.
+  const InputIndexType inputIndex = image->GetLargestPossibleRegion().GetIndex();
+  const InputSizeType inputSize = image->GetLargestPossibleRegion().GetSize();
+  InputIndexType outputIndex;
+  InputSizeType outputSize;
+  InputSpacingType outputSpacing;
+  ContinuousIndex<double, InputImageDimension> blockCentre;
+  for (unsigned int j = 0; j < InputImageDimension; j++)
+    {
+    outputIndex[j] = 0;
+    outputSize[j] = (inputSize[j] + blockSize[j] - 1) / blockSize[j];
+    outputSpacing[j] = image->GetSpacing()[j] * blockSize[j];
+    blockCentre[j] = inputIndex[j] + 0.5 * (blockSize[j] - 1);
+    }
+  InputPointType outputOrigin;
+  image->TransformContinuousIndexToPhysicalPoint(blockCentre, outputOrigin);
+
+  InputRegionType outputRegion;
+  outputRegion.SetIndex(outputIndex);
+  outputRegion.SetSize(outputSize);
+  InputImagePointer output = InputImageType::New();
+  output->SetRegions(outputRegion);
+  output->SetSpacing(outputSpacing);
+  output->SetOrigin(outputOrigin);
+  output->SetDirection(image->GetDirection());
+  output->Allocate();
+  return output;
+}
+
+template <class InputImageType, class OutputImageType>
+void
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::BlockReduceRegion(const InputImageType *image, const InputSizeType &blockSize, InputImageType *output,
+                    const InputRegionType &outputRegionForThread) const
+{
+  using RealType = typename NumericTraits<InputPixelType>::RealType;
+
+  const InputIndexType inputIndex = image->GetLargestPossibleRegion().GetIndex();
+  const InputSizeType inputSize = image->GetLargestPossibleRegion().GetSize();
+  const bool maxPooling = (m_Pyramid != 2);
 
+  // Input region covered by the blocks of this region.
+  InputIndexType blockIndex;
+  InputSizeType blockRegionSize;
+  OffsetValueType stride[InputImageDimension];
+  for (unsigned int j = 0; j < InputImageDimension; j++)
+    {
+    blockIndex[j] = inputIndex[j] + outputRegionForThread.GetIndex()[j] * blockSize[j];
+    blockRegionSize[j] = std::min<SizeValueType>(outputRegionForThread.GetSize()[j] * blockSize[j],
+                                                 inputIndex[j] + inputSize[j] - blockIndex[j]);
+    stride[j] = (j == 0) ? 1 : stride[j - 1] * outputRegionForThread.GetSize()[j - 1];
+    }
+  InputRegionType inputRegionForThread;
+  inputRegionForThread.SetIndex(blockIndex);
+  inputRegionForThread.SetSize(blockRegionSize);
+
+  // Pool the values of each block, in the memory order of the input.
+  const SizeValueType numberOfBlocks = outputRegionForThread.GetNumberOfPixels();
+  std::vector<RealType> pool(numberOfBlocks, maxPooling ? NumericTraits<RealType>::NonpositiveMin() : 0);
+  std::vector<SizeValueType> count(numberOfBlocks, 0);
+  ImageScanlineConstIterator<InputImageType> inputIte(image, inputRegionForThread);
+  while (!inputIte.IsAtEnd())
+    {
+    const InputIndexType index = inputIte.GetIndex();
+    OffsetValueType block = 0;
+    for (unsigned int j = 1; j < InputImageDimension; j++)
+      {
+      block += ((index[j] - blockIndex[j]) / static_cast<OffsetValueType>(blockSize[j])) * stride[j];
+      }
+    for (SizeValueType x = 0; !inputIte.IsAtEndOfLine(); ++inputIte, ++x)
+      {
+      const OffsetValueType b = block + x / blockSize[0];
+      const RealType value = static_cast<RealType>(inputIte.Get());
+      if (maxPooling)
+        {
+        pool[b] = std::max(pool[b], value);
+        }
+      else
+        {
+        pool[b] += value;
+        count[b]++;
+        }
+      }
+    inputIte.NextLine();
+    }
+
+  // Write one value per block.
+  ImageRegionIterator<InputImageType> outputIte(output, outputRegionForThread);
+  for (SizeValueType b = 0; !outputIte.IsAtEnd(); ++outputIte, ++b)
+    {
+    RealType value = pool[b];
+    if (!maxPooling)
+      {
+      value /= count[b];
+      if (NumericTraits<InputPixelType>::is_integer)
+        {
+        value = std::round(value);
+        }
+      }
+    outputIte.Set(static_cast<InputPixelType>(value));
+    }
+}
+
+template <class InputImageType, class OutputImageType>
+typename InputImageType::Pointer
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::BlockReduce(const InputImageType *image, const InputSizeType &blockSize)
+{
+  InputImagePointer output = this->AllocateBlockReduce(image, blockSize);
+  this->GetMultiThreader()->template ParallelizeImageRegion<InputImageDimension>(
+    output->GetLargestPossibleRegion(),
+    [&](const InputRegionType &outputRegionForThread)
+    {
+      this->BlockReduceRegion(image, blockSize, output, outputRegionForThread);
+    },
+    nullptr);
+
+  return output;
+}
+
+template <class InputImageType, class OutputImageType>
+typename MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>::StageClockType
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::StartStage() const
+{
+  if (!m_Profiling)
+    {
+    return StageClockType();
+    }
+  return StageClockType(std::chrono::steady_clock::now(), std::clock());
+}
+
+template <class InputImageType, class OutputImageType>
+void
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::StopStage(const StageClockType &start, unsigned int level, const char *stage, SizeValueType voxels, SizeValueType bytes,
+            double bandWidth)
+{
+  if (!m_Profiling)
+    {
+    return;
+    }
+  // The CPU time is the one of the process, summed over the threads of the stage.
+  const std::chrono::duration<double> wallTime = std::chrono::steady_clock::now() - start.first;
+  const double cpuTime = static_cast<double>(std::clock() - start.second) / CLOCKS_PER_SEC;
+  m_Profile.push_back({level, stage, wallTime.count(), cpuTime, voxels, bytes, bandWidth});
+}
+
+template <class InputImageType, class OutputImageType>
+typename OutputImageType::Pointer
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::GenerateRangeMap(const OutputImageType *map) const
+{
+  OutputImagePointer rangeMap = OutputImageType::New();
+  rangeMap->CopyInformation(map);
+  rangeMap->SetRegions(map->GetBufferedRegion());
+  rangeMap->Allocate();
+  this->GenerateRangeMapRegion(map, rangeMap, map->GetBufferedRegion());
+  return rangeMap;
+}
+
+template <class InputImageType, class OutputImageType>
+void
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::GenerateRangeMapRegion(const OutputImageType *map, OutputImageType *rangeMap, const OutputRegionType &region) const
+{
+  const OutputRegionType mapRegion = map->GetBufferedRegion();
+
+  // Largest depth jump with the face neighbours, the projected dimension of a
+  // same dimension map having a single pixel.
+  ImageRegionConstIteratorWithIndex<OutputImageType> mapIte(map, region);
+  ImageRegionIterator<OutputImageType> rangeIte(rangeMap, region);
+  for (; !mapIte.IsAtEnd(); ++mapIte, ++rangeIte)
+    {
+    const OutputIndexType index = mapIte.GetIndex();
+    const double depth = static_cast<double>(mapIte.Get());
+    double jump = 0;
+    for (unsigned int i = 0; i < OutputImageDimension; i++)
+      {
+      for (int step = -1; step <= 1; step += 2)
+        {
+        OutputIndexType neighbour = index;
+        neighbour[i] += step;
+        if (mapRegion.IsInside(neighbour))
+          {
+          jump = std::max(jump, std::abs(static_cast<double>(map->GetPixel(neighbour)) - depth));
+          }
+        }
+      }
+    const double width = std::min<double>(m_MinimumRange + std::ceil(jump), std::max(m_MaximumRange, m_MinimumRange));
+    rangeIte.Set(static_cast<OutputPixelType>(std::min(width, static_cast<double>(NumericTraits<OutputPixelType>::max()))));
+    }
+}
+
+template <class InputImageType, class OutputImageType>
+typename MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>::SigmaArrayType
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::GetSmoothingVariance() const
+{
   // Initialise variance array and set projection dimention to 0.
   SigmaArrayType sigmaArray;
   sigmaArray.Fill(m_Sigma);
@@ -230,105 +465,850 @@ MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
     {
     sigmaArray[m_ProjectionDimension] = 0.0;
     }
+  return sigmaArray;
+}
 
-  // Initialise variable for loop.
-  OutputImagePointer previousMap = nullptr;
-  InputImagePointer scaledImage = nullptr;
-  OutputSizeType oldSize;
-  OutputSpacingType oldSpacing;
-  OutputSizeType newSize;
-  OutputSpacingType newSpacing;
+template <class InputImageType, class OutputImageType>
+typename MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>::PlaneOperatorPointer
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::GetLevelPlaneOperator(const InputImageType *scaledImage) const
+{
+  // Plane operator shrunk as the level, from the spacing of the level.
+  if (m_PlaneOperator.IsNull())
+    {
+    return nullptr;
+    }
+  InputSizeType factors;
+  for (unsigned int j = 0; j < InputImageDimension; j++)
+    {
+    const double factor = scaledImage->GetSpacing()[j] / this->GetInput()->GetSpacing()[j];
+    factors[j] = std::max<SizeValueType>(static_cast<SizeValueType>(std::round(factor)), 1);
+    }
+  return m_PlaneOperator->Shrink(factors);
+}
 
-  const double newOrigin[OutputImageDimension] = {0};
+template <class InputImageType, class OutputImageType>
+void
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::SmoothMapRegion(const OutputImageType *map, OutputImageType *smoothedMap, const OutputRegionType &region) const
+{
+  // The region is smoothed with a margin of the kernel radius, so that its
+  // values are the ones of the whole map smoothed, at the map edges as well. Tiles
+  // are smoothed concurrently, each one by its own smoother.
+  typename SmootherType::Pointer smoother = SmootherType::New();
+  smoother->SetVariance(this->GetSmoothingVariance());
+  smoother->SetMaximumError(m_Smoother->GetMaximumError());
+  smoother->SetMaximumKernelWidth(m_Smoother->GetMaximumKernelWidth());
+  smoother->SetNumberOfWorkUnits(1);
+  smoother->Smooth(map, smoothedMap, region);
+}
 
-  // Compute multiscale level factors and setup filter.
-  this->ScheduleFromLevels();
-  m_MultiscalePyramideImageFilter->SetInput(input);
-  m_MultiscalePyramideImageFilter->SetNumberOfLevels(m_NumberOfLevels);
-  m_MultiscalePyramideImageFilter->SetSchedule(m_Schedule);
+template <class InputImageType, class OutputImageType>
+typename OutputImageType::Pointer
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::GenerateLevelDepthMap(InputImageType *scaledImage, OutputImageType *initialisation, const RangeArrayType &range,
+                        OutputImageType *rangeMap, unsigned int level)
+{
+  // Define Depthmap filter, on the work units of this filter.
+  m_DepthMapFilter->SetInput(scaledImage);
+  m_DepthMapFilter->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
+  m_DepthMapFilter->SetTolerance(m_Tolerance);
+  m_DepthMapFilter->SetPeak(m_Peak);
 
-  // Begin loop for each scale level.
-  for (size_t level = 0; level < m_NumberOfLevels; level++)
+  // Initialisation condition, the initialisation map is read at the current level
+  // resolution by the depth map filter itself.
+  m_DepthMapFilter->SetRange(range);
+  m_DepthMapFilter->SetInterpolation(m_Interpolation);
+  m_DepthMapFilter->SetInitialisation(initialisation);
+  m_DepthMapFilter->SetRangeMap(rangeMap);
+
+  m_DepthMapFilter->SetPlaneOperator(this->GetLevelPlaneOperator(scaledImage));
+
+  // The depth search is timed apart from the regularisation, which smooths its
+  // output in place.
+  m_Smoother->SetVariance(this->GetSmoothingVariance());
+  m_Smoother->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
+  OutputImagePointer map = m_DepthMapFilter->GetOutput();
+  const SizeValueType levelPixels = scaledImage->GetLargestPossibleRegion().GetNumberOfPixels();
+  SizeValueType mapPixels = 0;
+  double bandWidth = 0;
+  try
+    {
+    StageClockType clock = this->StartStage();
+    m_DepthMapFilter->UpdateLargestPossibleRegion();
+    mapPixels = m_DepthMapFilter->GetOutput()->GetLargestPossibleRegion().GetNumberOfPixels();
+    bandWidth = initialisation != nullptr ? m_DepthMapFilter->GetAverageBandWidth()
+                                          : scaledImage->GetLargestPossibleRegion().GetSize()[m_ProjectionDimension];
+    this->StopStage(clock, level, "depth", levelPixels, mapPixels * sizeof(OutputPixelType), bandWidth);
+
+    clock = this->StartStage();
+    const SizeValueType bufferBytes = m_Smoother->GetNumberOfBytes();
+    m_Smoother->Smooth(map, map);
+    this->StopStage(clock, level, "smoothing", mapPixels, m_Smoother->GetNumberOfBytes() - bufferBytes);
+    }
+  catch (itk::ExceptionObject &excp)
+    {
+    std::cerr << excp << std::endl;
+    }
+
+  m_LevelBandWidths.push_back(bandWidth);
+
+  map->DisconnectPipeline();
+  return map;
+}
+
+template <class InputImageType, class OutputImageType>
+typename OutputImageType::Pointer
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::GenerateWavefrontDepthMap(InputImageType *input)
+{
+  using TaskIdType = DepthMapTaskGraph::TaskIdType;
+  const unsigned int tileDimension = InputImageDimension - 1;
+  const unsigned int finest = m_NumberOfLevels - 1;
+  const OffsetValueType tileSize = static_cast<OffsetValueType>(std::max<SizeValueType>(m_TileSize, 1));
+
+  // Pyramid volume, depth filter, maps and tiles of each level, with the tasks of
+  // each tile: pyramid reduction, depth search, smoothing and range map.
+  struct Level
+  {
+    InputImagePointer volume;
+    InputImagePointer source;
+    InputSizeType blockSize;
+    PlaneOperatorPointer planeOperator;
+    typename VolumeToDepthMapFilterType::Pointer filter;
+    OutputImagePointer raw;
+    OutputImagePointer smoothed;
+    OutputImagePointer range;
+    std::vector<InputRegionType> tiles;
+    std::vector<TaskIdType> reduceTasks;
+    std::vector<TaskIdType> depthTasks;
+    std::vector<TaskIdType> smoothingTasks;
+    std::vector<TaskIdType> rangeTasks;
+  };
+  std::vector<Level> levels(m_NumberOfLevels);
+
+  // Each level is built from the next finer one, all levels being held. Mean
+  // pooling reads the input itself, the mean of the rounded means of the finer
+  // level not being the mean of the block.
+  const bool meanPooling = (m_Pyramid == 2);
+  levels[finest].volume = input;
+  for (unsigned int k = finest; k-- > 0;)
     {
-    // Get scaled input.
-    try
+    levels[k].source = meanPooling ? InputImagePointer(input) : levels[k + 1].volume;
+    for (unsigned int j = 0; j < InputImageDimension; j++)
+      {
+      levels[k].blockSize[j] = meanPooling ? m_Schedule.GetElement(k, j)
+                                           : m_Schedule.GetElement(k, j) / m_Schedule.GetElement(k + 1, j);
+      }
+    levels[k].volume = this->AllocateBlockReduce(levels[k].source, levels[k].blockSize);
+    }
+
+  // Tiles split the plane of each level, in memory order, along the whole columns.
+  auto GetTiles = [&](const Level &level, InputRegionType region) -> std::vector<SizeValueType>
+  {
+    std::vector<SizeValueType> tiles;
+    const InputRegionType levelRegion = level.volume->GetLargestPossibleRegion();
+    if (!region.Crop(levelRegion))
+      {
+      return tiles;
+      }
+    OffsetValueType first[InputImageDimension];
+    OffsetValueType last[InputImageDimension];
+    OffsetValueType tile[InputImageDimension];
+    SizeValueType stride[InputImageDimension];
+    for (unsigned int j = 0; j < tileDimension; j++)
+      {
+      first[j] = (region.GetIndex()[j] - levelRegion.GetIndex()[j]) / tileSize;
+      last[j] = (region.GetUpperIndex()[j] - levelRegion.GetIndex()[j]) / tileSize;
+      tile[j] = first[j];
+      stride[j] = (j == 0) ? 1 : stride[j - 1] * ((levelRegion.GetSize()[j - 1] + tileSize - 1) / tileSize);
+      }
+    bool done = false;
+    while (!done)
       {
-      m_MultiscalePyramideImageFilter->GetOutput(level)->Update();
+      SizeValueType id = 0;
+      for (unsigned int j = 0; j < tileDimension; j++)
+        {
+        id += tile[j] * stride[j];
+        }
+      tiles.push_back(id);
+      done = true;
+      for (unsigned int j = 0; j < tileDimension && done; j++)
+        {
+        if (++tile[j] <= last[j])
+          {
+          done = false;
+          }
+        else
+          {
+          tile[j] = first[j];
+          }
+        }
       }
-    catch (itk::ExceptionObject &excp)
+    return tiles;
+  };
+  for (Level &level : levels)
+    {
+    const InputRegionType levelRegion = level.volume->GetLargestPossibleRegion();
+    SizeValueType numberOfTiles = 1;
+    for (unsigned int j = 0; j < tileDimension; j++)
       {
-      std::cerr << excp << std::endl;
+      numberOfTiles *= (levelRegion.GetSize()[j] + tileSize - 1) / tileSize;
       }
-    scaledImage = m_MultiscalePyramideImageFilter->GetOutput(level);
+    for (SizeValueType t = 0; t < numberOfTiles; t++)
+      {
+      InputRegionType tile = levelRegion;
+      SizeValueType rest = t;
+      for (unsigned int j = 0; j < tileDimension; j++)
+        {
+        const SizeValueType numberOfTilesAlong = (levelRegion.GetSize()[j] + tileSize - 1) / tileSize;
+        const SizeValueType first = (rest % numberOfTilesAlong) * tileSize;
+        rest /= numberOfTilesAlong;
+        tile.SetIndex(j, levelRegion.GetIndex()[j] + first);
+        tile.SetSize(j, std::min<SizeValueType>(tileSize, levelRegion.GetSize()[j] - first));
+        }
+      level.tiles.push_back(tile);
+      }
+    }
 
-    // Define Depthmap filter.
-    m_DepthMapFilter->SetInput(scaledImage);
-    m_DepthMapFilter->SetTolerance(m_Tolerance);
-    m_DepthMapFilter->SetPeak(m_Peak);
+  // Map region of the columns of a volume region, the projected dimension of a
+  // same dimension map having a single pixel.
+  auto GetMapRegion = [&](const InputRegionType &region) -> OutputRegionType
+  {
+    OutputRegionType mapRegion;
+    for (unsigned int i = 0; i < OutputImageDimension; i++)
+      {
+      mapRegion.SetIndex(i, (i < tileDimension) ? region.GetIndex()[i] : 0);
+      mapRegion.SetSize(i, (i < tileDimension) ? region.GetSize()[i] : 1);
+      }
+    return mapRegion;
+  };
 
-    // Initialisation condition.
-    if (previousMap.IsNotNull())
+  // Coarse level region read by the interpolation of the initialisation of a
+  // fine level region, as in VolumeToDepthMapFilter, pixel centres being aligned.
+  auto GetFootprint = [&](const InputRegionType &region, const Level &fine, const Level &coarse) -> InputRegionType
+  {
+    const InputRegionType fineRegion = fine.volume->GetLargestPossibleRegion();
+    InputRegionType footprint = coarse.volume->GetLargestPossibleRegion();
+    for (unsigned int j = 0; j < tileDimension; j++)
       {
-      // Define new size and spacing for upsampling depthmap.
-      for (size_t d = 0; d < OutputImageDimension; d++)
+      const double coarseSize = footprint.GetSize()[j];
+      const double scale = coarseSize / fineRegion.GetSize()[j];
+      const double first = (region.GetIndex()[j] - fineRegion.GetIndex()[j] + 0.5) * scale - 0.5;
+      const double last = (region.GetUpperIndex()[j] - fineRegion.GetIndex()[j] + 0.5) * scale - 0.5;
+      const OffsetValueType lower = static_cast<OffsetValueType>(std::floor(std::min(std::max(first, 0.0), coarseSize - 1)));
+      const OffsetValueType upper = std::min<OffsetValueType>(
+        static_cast<OffsetValueType>(std::floor(std::min(std::max(last, 0.0), coarseSize - 1))) + 1,
+        static_cast<OffsetValueType>(coarseSize) - 1);
+      footprint.SetIndex(j, footprint.GetIndex()[j] + lower);
+      footprint.SetSize(j, upper - lower + 1);
+      }
+    return footprint;
+  };
+
+  // Radius of the smoothing kernel, as computed by the smoother.
+  m_Smoother->SetVariance(this->GetSmoothingVariance());
+  const OutputSizeType gaussianRadius = m_Smoother->GetRadius(this->GetOutput());
+  InputSizeType gaussianVolumeRadius;
+  gaussianVolumeRadius.Fill(0);
+  for (unsigned int i = 0; i < tileDimension; i++)
+    {
+    gaussianVolumeRadius[i] = gaussianRadius[i];
+    }
+  InputSizeType neighbourRadius;
+  neighbourRadius.Fill(1);
+  neighbourRadius[InputImageDimension - 1] = 0;
+
+  // Depth filters and maps, allocated from the coarsest level, each level being
+  // initialised by the smoothed map of the previous one.
+  for (unsigned int k = 0; k < m_NumberOfLevels; k++)
+    {
+    Level &level = levels[k];
+    level.planeOperator = this->GetLevelPlaneOperator(level.volume);
+    level.filter = VolumeToDepthMapFilterType::New();
+    level.filter->SetInput(level.volume);
+    level.filter->SetTolerance(m_Tolerance);
+    level.filter->SetPeak(m_Peak);
+    level.filter->SetRange(m_Range);
+    level.filter->SetInterpolation(m_Interpolation);
+    level.filter->SetInitialisation(k > 0 ? levels[k - 1].smoothed : OutputImagePointer());
+    level.filter->SetRangeMap(k > 0 && m_AdaptiveRange ? levels[k - 1].range : OutputImagePointer());
+    level.filter->SetPlaneOperator(level.planeOperator);
+    level.filter->BeginRegions();
+    level.raw = level.filter->GetOutput();
+
+    level.smoothed = OutputImageType::New();
+    level.smoothed->CopyInformation(level.raw);
+    level.smoothed->SetRegions(level.raw->GetLargestPossibleRegion());
+    level.smoothed->Allocate();
+    if (m_AdaptiveRange && k < finest)
+      {
+      level.range = OutputImageType::New();
+      level.range->CopyInformation(level.raw);
+      level.range->SetRegions(level.raw->GetLargestPossibleRegion());
+      level.range->Allocate();
+      }
+    }
+
+  // Tasks of each tile, with the level and stage they are accounted to.
+  enum
+  {
+    PyramidStage,
+    RangeStage,
+    DepthStage,
+    SmoothingStage,
+    NumberOfStages
+  };
+  DepthMapTaskGraph graph;
+  std::vector<std::pair<unsigned int, unsigned int>> taskStages;
+  auto AddTask = [&](unsigned int level, unsigned int stage, const DepthMapTaskGraph::FunctionType &function)
+  {
+    taskStages.emplace_back(level, stage);
+    return graph.AddTask(function);
+  };
+  for (unsigned int k = 0; k < m_NumberOfLevels; k++)
+    {
+    Level &level = levels[k];
+    for (SizeValueType t = 0; t < level.tiles.size(); t++)
+      {
+      if (k < finest)
+        {
+        level.reduceTasks.push_back(AddTask(k, PyramidStage, [&, k, t]() {
+          this->BlockReduceRegion(levels[k].source, levels[k].blockSize, levels[k].volume, levels[k].tiles[t]);
+        }));
+        }
+      level.depthTasks.push_back(AddTask(k, DepthStage, [&, k, t]() {
+        levels[k].filter->GenerateRegion(GetMapRegion(levels[k].tiles[t]));
+      }));
+      level.smoothingTasks.push_back(AddTask(k, SmoothingStage, [&, k, t]() {
+        this->SmoothMapRegion(levels[k].raw, levels[k].smoothed, GetMapRegion(levels[k].tiles[t]));
+      }));
+      if (m_AdaptiveRange && k < finest)
+        {
+        level.rangeTasks.push_back(AddTask(k + 1, RangeStage, [&, k, t]() {
+          this->GenerateRangeMapRegion(levels[k].smoothed, levels[k].range, GetMapRegion(levels[k].tiles[t]));
+        }));
+        }
+      }
+    }
+
+  // A tile waits for the tiles it reads only: the finer level blocks of its
+  // reduction, the neighbourhood of its depth search plane operator, the coarse
+  // maps of its initialisation, and the support of its smoothing kernel.
+  auto AddDependencies = [&](TaskIdType task, const std::vector<TaskIdType> &tasks, const std::vector<SizeValueType> &tiles)
+  {
+    for (SizeValueType tile : tiles)
+      {
+      graph.AddDependency(task, tasks[tile]);
+      }
+  };
+  for (unsigned int k = 0; k < m_NumberOfLevels; k++)
+    {
+    Level &level = levels[k];
+    for (SizeValueType t = 0; t < level.tiles.size(); t++)
+      {
+      const InputRegionType &tile = level.tiles[t];
+      if (k + 1 < finest)
         {
-        if (d != m_ProjectionDimension)
+        InputRegionType blocks = levels[k + 1].volume->GetLargestPossibleRegion();
+        for (unsigned int j = 0; j < tileDimension; j++)
           {
-          oldSize[d] = previousMap->GetLargestPossibleRegion().GetSize()[d];
-          oldSpacing[d] = previousMap->GetSpacing()[d];
-          newSize[d] = scaledImage->GetLargestPossibleRegion().GetSize()[d];
-          newSpacing[d] = oldSpacing[d] * static_cast<float>(oldSize[d]) / static_cast<float>(newSize[d]);
+          blocks.SetIndex(j, blocks.GetIndex()[j] + tile.GetIndex()[j] * level.blockSize[j]);
+          blocks.SetSize(j, tile.GetSize()[j] * level.blockSize[j]);
           }
-        else
+        AddDependencies(level.reduceTasks[t], levels[k + 1].reduceTasks, GetTiles(levels[k + 1], blocks));
+        }
+      if (k < finest)
+        {
+        InputRegionType support = tile;
+        if (level.planeOperator.IsNotNull())
+          {
+          support.PadByRadius(level.planeOperator->GetNeighborhoodRadius(m_ProjectionDimension));
+          }
+        AddDependencies(level.depthTasks[t], level.reduceTasks, GetTiles(level, support));
+        }
+      if (k > 0)
+        {
+        const std::vector<SizeValueType> coarseTiles = GetTiles(levels[k - 1], GetFootprint(tile, level, levels[k - 1]));
+        AddDependencies(level.depthTasks[t], levels[k - 1].smoothingTasks, coarseTiles);
+        if (m_AdaptiveRange)
+          {
+          AddDependencies(level.depthTasks[t], levels[k - 1].rangeTasks, coarseTiles);
+          }
+        }
+      InputRegionType kernelSupport = tile;
+      kernelSupport.PadByRadius(gaussianVolumeRadius);
+      AddDependencies(level.smoothingTasks[t], level.depthTasks, GetTiles(level, kernelSupport));
+      if (m_AdaptiveRange && k < finest)
+        {
+        InputRegionType neighbours = tile;
+        neighbours.PadByRadius(neighbourRadius);
+        AddDependencies(level.rangeTasks[t], level.smoothingTasks, GetTiles(level, neighbours));
+        }
+      }
+    }
+
+  graph.Run(this->GetNumberOfWorkUnits());
+
+  // Levels and stages overlapping, a level time is the span from its first task
+  // start to its last task stop. In the profile, the wall time of a stage is its
+  // span, and its CPU time the sum of the times of its tasks.
+  const char *stageNames[NumberOfStages] = {"pyramid", "range", "depth", "smoothing"};
+  const SizeValueType numberOfSpans = m_NumberOfLevels * NumberOfStages;
+  std::vector<double> spanStart(numberOfSpans, NumericTraits<double>::max());
+  std::vector<double> spanStop(numberOfSpans, 0);
+  std::vector<double> taskTime(numberOfSpans, 0);
+  for (TaskIdType task = 0; task < graph.GetNumberOfTasks(); task++)
+    {
+    const SizeValueType span = taskStages[task].first * NumberOfStages + taskStages[task].second;
+    spanStart[span] = std::min(spanStart[span], graph.GetStartTime(task));
+    spanStop[span] = std::max(spanStop[span], graph.GetStopTime(task));
+    taskTime[span] += graph.GetStopTime(task) - graph.GetStartTime(task);
+    }
+  for (unsigned int k = 0; k < m_NumberOfLevels; k++)
+    {
+    const SizeValueType levelPixels = levels[k].volume->GetLargestPossibleRegion().GetNumberOfPixels();
+    const SizeValueType mapPixels = levels[k].raw->GetLargestPossibleRegion().GetNumberOfPixels();
+    const double bandWidth = k > 0 ? levels[k].filter->GetAverageBandWidth()
+                                   : levels[k].volume->GetLargestPossibleRegion().GetSize()[m_ProjectionDimension];
+    m_LevelBandWidths.push_back(bandWidth);
+
+    double levelStart = NumericTraits<double>::max();
+    double levelStop = 0;
+    for (unsigned int stage = 0; stage < NumberOfStages; stage++)
+      {
+      const SizeValueType span = k * NumberOfStages + stage;
+      if (spanStop[span] < spanStart[span])
+        {
+        continue;
+        }
+      levelStart = std::min(levelStart, spanStart[span]);
+      levelStop = std::max(levelStop, spanStop[span]);
+      if (!m_Profiling)
+        {
+        continue;
+        }
+      StageProfileType profile = {k, stageNames[stage], spanStop[span] - spanStart[span], taskTime[span], 0, 0, 0};
+      switch (stage)
+        {
+        case PyramidStage:
+          profile.voxels = levels[k + 1].volume->GetLargestPossibleRegion().GetNumberOfPixels();
+          profile.bytes = levelPixels * sizeof(InputPixelType);
+          break;
+        case RangeStage:
+          profile.voxels = levels[k - 1].raw->GetLargestPossibleRegion().GetNumberOfPixels();
+          profile.bytes = profile.voxels * sizeof(OutputPixelType);
+          break;
+        case DepthStage:
+          profile.voxels = levelPixels;
+          profile.bytes = mapPixels * sizeof(OutputPixelType);
+          profile.bandWidth = bandWidth;
+          break;
+        default:
+          profile.voxels = mapPixels;
+          profile.bytes = mapPixels * (2 * sizeof(float) + sizeof(OutputPixelType));
+          break;
+        }
+      m_Profile.push_back(profile);
+      }
+    m_LevelTimes.push_back(levelStop - levelStart);
+    }
+
+  return levels[finest].smoothed;
+}
+
+template <class InputImageType, class OutputImageType>
+typename OutputImageType::Pointer
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::GeneratePyramidDepthMap(InputImageType *input)
+{
+  // Levels given by a previous run.
+  const bool givenLevels = !m_KeepPyramidLevels && !m_PyramidLevels.empty();
+
+  // The wavefront holds every level of the block pyramid.
+  if (m_Wavefront && !givenLevels && !m_KeepPyramidLevels &&
+      m_Pyramid != 0 && m_ProjectionDimension == InputImageDimension - 1)
+    {
+    SizeValueType cascadeMemory = 0;
+    for (unsigned int level = 0; level + 1 < m_NumberOfLevels; level++)
+      {
+      cascadeMemory += this->GetNumberOfPixelsAtLevel(level) * sizeof(InputPixelType);
+      }
+    // Tiles are smoothed within a kernel radius, not along whole recursive lines.
+    m_Smoother->SetVariance(this->GetSmoothingVariance());
+    bool recursiveSmoothing = false;
+    for (unsigned int i = 0; i < OutputImageDimension; i++)
+      {
+      recursiveSmoothing = recursiveSmoothing || m_Smoother->IsRecursive(this->GetOutput(), i);
+      }
+    if (!recursiveSmoothing && (m_MaximumMemory == 0 || cascadeMemory <= m_MaximumMemory))
+      {
+      return this->GenerateWavefrontDepthMap(input);
+      }
+    }
+
+  // Initialise variable for loop, the smoothing buffer being sized for the finest map.
+  OutputImagePointer previousMap = nullptr;
+  InputImagePointer scaledImage = nullptr;
+  m_Smoother->Reserve(this->GetOutput()->GetLargestPossibleRegion().GetNumberOfPixels());
+
+  // Setup the pyramid, with the level factors computed by ScheduleFromLevels.
+  std::vector<InputImagePointer> pyramidLevels(m_NumberOfLevels);
+  if (givenLevels)
+    {
+    // Each level is grafted, the given ones being possibly read by other filters.
+    for (unsigned int level = 0; level < m_NumberOfLevels; level++)
+      {
+      pyramidLevels[level] = InputImageType::New();
+      pyramidLevels[level]->Graft(m_PyramidLevels[level]);
+      }
+    }
+  else if (m_Pyramid == 0)
+    {
+    // The Gaussian pyramid holds a copy of the volume at every level.
+    SizeValueType pyramidMemory = 0;
+    for (unsigned int level = 0; level < m_NumberOfLevels; level++)
+      {
+      pyramidMemory += this->GetNumberOfPixelsAtLevel(level) * sizeof(InputPixelType);
+      }
+    if (m_MaximumMemory > 0 && pyramidMemory > m_MaximumMemory)
+      {
+      itkExceptionMacro(<< "Gaussian pyramid requires " << pyramidMemory
+                        << " bytes but MaximumMemory is " << m_MaximumMemory
+                        << " bytes, use a block pyramid instead.");
+      }
+    m_MultiscalePyramideImageFilter->SetInput(input);
+    m_MultiscalePyramideImageFilter->SetNumberOfLevels(m_NumberOfLevels);
+    m_MultiscalePyramideImageFilter->SetSchedule(m_Schedule);
+    m_MultiscalePyramideImageFilter->SetNumberOfWorkUnits(this->GetNumberOfWorkUnits());
+    }
+  else
+    {
+    // The finest level is the input. Coarser levels are built from the next finer
+    // one if they fit together in memory, else each one from the input when needed.
+    // Mean pooling always reads the input, the mean of the rounded means of the
+    // finer level not being the mean of the block. A level built on demand is only
+    // pooled once the previous one is released, so the peak is the largest level.
+    SizeValueType cascadeMemory = 0;
+    SizeValueType onDemandMemory = 0;
+    for (unsigned int level = 0; level + 1 < m_NumberOfLevels; level++)
+      {
+      SizeValueType levelMemory = this->GetNumberOfPixelsAtLevel(level) * sizeof(InputPixelType);
+      cascadeMemory += levelMemory;
+      onDemandMemory = std::max(onDemandMemory, levelMemory);
+      }
+    if (m_MaximumMemory > 0 && onDemandMemory > m_MaximumMemory)
+      {
+      itkExceptionMacro(<< "Block pyramid requires at least " << onDemandMemory
+                        << " bytes but MaximumMemory is " << m_MaximumMemory << " bytes.");
+      }
+    pyramidLevels[m_NumberOfLevels - 1] = input;
+    if (m_Pyramid != 2 && (m_MaximumMemory == 0 || cascadeMemory <= m_MaximumMemory))
+      {
+      for (unsigned int level = m_NumberOfLevels - 1; level-- > 0;)
+        {
+        InputSizeType blockSize;
+        for (unsigned int j = 0; j < InputImageDimension; j++)
           {
-          oldSize[d] = 1;
-          oldSpacing[d] = 0;
-          newSpacing[d] = 1;
-          newSize[m_ProjectionDimension] = 1;
+          blockSize[j] = m_Schedule.GetElement(level, j) / m_Schedule.GetElement(level + 1, j);
           }
+        const StageClockType clock = this->StartStage();
+        pyramidLevels[level] = this->BlockReduce(pyramidLevels[level + 1], blockSize);
+        const SizeValueType levelPixels = pyramidLevels[level]->GetLargestPossibleRegion().GetNumberOfPixels();
+        this->StopStage(clock, level, "pyramid", pyramidLevels[level + 1]->GetLargestPossibleRegion().GetNumberOfPixels(),
+                        levelPixels * sizeof(InputPixelType));
         }
-      // Define Upsampler filter to resize the previous map to the current level.
-      m_ResampleFilter->SetSize(newSize);
-      m_ResampleFilter->SetOutputSpacing(newSpacing);
-      m_ResampleFilter->SetOutputOrigin(newOrigin);
-      m_ResampleFilter->SetInput(previousMap);
+      }
+    }
+
+  // Begin loop for each scale level.
+  for (size_t level = 0; level < m_NumberOfLevels; level++)
+    {
+    auto levelStart = std::chrono::steady_clock::now();
+
+    // Get scaled input, the Gaussian pyramid computing all its levels with the first one.
+    if (givenLevels)
+      {
+      scaledImage = pyramidLevels[level];
+      pyramidLevels[level] = nullptr;
+      }
+    else if (m_Pyramid == 0)
+      {
+      const StageClockType clock = this->StartStage();
       try
         {
-        m_ResampleFilter->UpdateLargestPossibleRegion();
+        m_MultiscalePyramideImageFilter->GetOutput(level)->Update();
         }
       catch (itk::ExceptionObject &excp)
         {
         std::cerr << excp << std::endl;
         }
-      previousMap = m_ResampleFilter->GetOutput();
+      scaledImage = m_MultiscalePyramideImageFilter->GetOutput(level);
+      const SizeValueType levelPixels = scaledImage->GetLargestPossibleRegion().GetNumberOfPixels();
+      this->StopStage(clock, level, "pyramid", level == 0 ? input->GetLargestPossibleRegion().GetNumberOfPixels() : 0,
+                      levelPixels * sizeof(InputPixelType));
+      }
+    else
+      {
+      if (pyramidLevels[level].IsNull())
+        {
+        // Release the previous level before pooling this one.
+        scaledImage = nullptr;
+        m_DepthMapFilter->SetInput(nullptr);
+        InputSizeType blockSize;
+        for (unsigned int j = 0; j < InputImageDimension; j++)
+          {
+          blockSize[j] = m_Schedule.GetElement(level, j);
+          }
+        const StageClockType clock = this->StartStage();
+        pyramidLevels[level] = this->BlockReduce(input, blockSize);
+        const SizeValueType levelPixels = pyramidLevels[level]->GetLargestPossibleRegion().GetNumberOfPixels();
+        this->StopStage(clock, level, "pyramid", input->GetLargestPossibleRegion().GetNumberOfPixels(),
+                        levelPixels * sizeof(InputPixelType));
+        }
+      // Release the level, it is only held by the depth filter from now on.
+      scaledImage = pyramidLevels[level];
+      pyramidLevels[level] = nullptr;
+      }
+
+    if (m_KeepPyramidLevels)
+      {
+      m_PyramidLevels.push_back(scaledImage);
+      }
 
-      // Link upscaled map as current level initialisation.
-      m_DepthMapFilter->SetRange(m_Range);
-      m_DepthMapFilter->SetInitialisation(m_ResampleFilter->GetOutput());
+    // Compute the map of the level, initialised by the one of the previous level,
+    // in bands adapted to its local depth jumps.
+    OutputImagePointer rangeMap = nullptr;
+    if (m_AdaptiveRange && previousMap.IsNotNull())
+      {
+      const StageClockType clock = this->StartStage();
+      rangeMap = this->GenerateRangeMap(previousMap);
+      const SizeValueType mapPixels = rangeMap->GetBufferedRegion().GetNumberOfPixels();
+      this->StopStage(clock, level, "range", mapPixels, mapPixels * sizeof(OutputPixelType));
       }
+    previousMap = this->GenerateLevelDepthMap(scaledImage, previousMap, m_Range, rangeMap, level);
 
-  // Gaussian regularisation filter.
-  m_InternalCastFilter->SetInput(m_DepthMapFilter->GetOutput());
-  m_GaussianFilter->SetInput(m_InternalCastFilter->GetOutput());
-  m_GaussianFilter->SetVariance(sigmaArray);
-  m_GaussianFilter->SetUseImageSpacing(false);
-  m_OutputCastFilter->SetInput(m_GaussianFilter->GetOutput());
-  try
+    std::chrono::duration<double> levelTime = std::chrono::steady_clock::now() - levelStart;
+    m_LevelTimes.push_back(levelTime.count());
+    }
+
+  // The kept Gaussian levels are left to the caller, the pyramid making new outputs.
+  if (m_KeepPyramidLevels && m_Pyramid == 0)
     {
-    m_OutputCastFilter->UpdateLargestPossibleRegion();
+    for (unsigned int level = 0; level < m_NumberOfLevels; level++)
+      {
+      m_MultiscalePyramideImageFilter->GetOutput(level)->DisconnectPipeline();
+      }
     }
-  catch (itk::ExceptionObject &excp)
+
+  return previousMap;
+}
+
+template <class InputImageType, class OutputImageType>
+SizeValueType
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::GetWarmStartTile(const OutputRegionType &region, const OutputIndexType &index) const
+{
+  // Tiles are numbered in the memory order of the map.
+  SizeValueType tile = 0;
+  SizeValueType stride = 1;
+  for (unsigned int i = 0; i < OutputImageDimension; i++)
     {
-    std::cerr << excp << std::endl;
+    tile += (index[i] - region.GetIndex()[i]) / m_WarmStartTileSize * stride;
+    stride *= (region.GetSize()[i] + m_WarmStartTileSize - 1) / m_WarmStartTileSize;
     }
+  return tile;
+}
 
-  // Update map for next iteration.
-  previousMap = m_OutputCastFilter->GetOutput();
-  previousMap->DisconnectPipeline();
-  }
+template <class InputImageType, class OutputImageType>
+SizeValueType
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::CheckWarmStart(const OutputImageType *map, std::vector<bool> &failedTiles) const
+{
+  const OutputRegionType region = map->GetLargestPossibleRegion();
+  const InputIndexValueType projectionSize = this->GetInput()->GetLargestPossibleRegion().GetSize()[m_ProjectionDimension];
+
+  SizeValueType numberOfTiles = 1;
+  for (unsigned int i = 0; i < OutputImageDimension; i++)
+    {
+    numberOfTiles *= (region.GetSize()[i] + m_WarmStartTileSize - 1) / m_WarmStartTileSize;
+    }
+  std::vector<SizeValueType> numberOfColumns(numberOfTiles, 0);
+  std::vector<SizeValueType> numberOfEdgeColumns(numberOfTiles, 0);
+
+  // A column is at the edge of its band when its depth moved by the full range
+  // from the warm start, without being stopped by the volume bounds.
+  ImageRegionConstIteratorWithIndex<OutputImageType> mapIte(map, region);
+  for (; !mapIte.IsAtEnd(); ++mapIte)
+    {
+    const OutputIndexType index = mapIte.GetIndex();
+    const SizeValueType tile = this->GetWarmStartTile(region, index);
+    const InputIndexValueType depth = static_cast<InputIndexValueType>(mapIte.Get());
+    const InputIndexValueType warmDepth = static_cast<InputIndexValueType>(m_WarmStart->GetPixel(index));
+    const bool highEdge = depth <= warmDepth - m_WarmStartRange[0] && depth > 0;
+    const bool lowEdge = depth >= warmDepth + m_WarmStartRange[1] && depth < projectionSize - 1;
+    numberOfColumns[tile]++;
+    if (highEdge || lowEdge)
+      {
+      numberOfEdgeColumns[tile]++;
+      }
+    }
+
+  SizeValueType numberOfFailedTiles = 0;
+  failedTiles.assign(numberOfTiles, false);
+  for (SizeValueType t = 0; t < numberOfTiles; t++)
+    {
+    if (numberOfEdgeColumns[t] > m_WarmStartTolerance * numberOfColumns[t])
+      {
+      failedTiles[t] = true;
+      numberOfFailedTiles++;
+      }
+    }
+  return numberOfFailedTiles;
+}
+
+template <class InputImageType, class OutputImageType>
+void 
+MultiscaleVolumeToDepthMapFilter<InputImageType, OutputImageType>
+::GenerateData()
+{
+  // Define Input and Output of the filter.
+  InputImagePointer input = InputImageType::New();
+  input->Graft(this->GetInput());
+  this->AllocateOutputs();
+
+  this->ScheduleFromLevels();
+  m_LevelTimes.clear();
+  m_Profile.clear();
+  m_LevelBandWidths.clear();
+  m_NumberOfFailedTiles = 0;
+
+  if (m_KeepPyramidLevels)
+    {
+    m_PyramidLevels.clear();
+    }
+  else if (!m_PyramidLevels.empty() &&
+           (m_PyramidLevels.size() != m_NumberOfLevels ||
+            m_PyramidLevels.back()->GetLargestPossibleRegion() != input->GetLargestPossibleRegion()))
+    {
+    itkExceptionMacro(<< "PyramidLevels must be the " << m_NumberOfLevels << " levels of the input region "
+                      << input->GetLargestPossibleRegion());
+    }
+  if (m_WarmStart.IsNotNull() && (m_KeepPyramidLevels || !m_PyramidLevels.empty()))
+    {
+    itkExceptionMacro(<< "PyramidLevels can not be used with a WarmStart.");
+    }
+
+  if (m_WarmStart.IsNull())
+    {
+    this->GetOutput()->Graft(this->GeneratePyramidDepthMap(input));
+    return;
+    }
+
+  // Warm start, the finest level is directly initialised by the previous map.
+  if (m_WarmStart->GetLargestPossibleRegion() != this->GetOutput()->GetLargestPossibleRegion())
+    {
+    itkExceptionMacro(<< "WarmStart region " << m_WarmStart->GetLargestPossibleRegion()
+                      << " differs from the output region " << this->GetOutput()->GetLargestPossibleRegion());
+    }
+  auto warmStart = std::chrono::steady_clock::now();
+  OutputImagePointer map = this->GenerateLevelDepthMap(input, m_WarmStart, m_WarmStartRange, nullptr, m_NumberOfLevels - 1);
+  std::chrono::duration<double> warmTime = std::chrono::steady_clock::now() - warmStart;
+  m_LevelTimes.push_back(warmTime.count());
+
+  // Fall back to the full pyramid on the tiles that failed the consistency check,
+  // computed on their bounding box extended by a halo covering the coarse levels.
+  std::vector<bool> failedTiles;
+  const StageClockType checkClock = this->StartStage();
+  m_NumberOfFailedTiles = this->CheckWarmStart(map, failedTiles);
+  this->StopStage(checkClock, m_NumberOfLevels - 1, "warmstart check", map->GetLargestPossibleRegion().GetNumberOfPixels(),
+                  failedTiles.size() * sizeof(SizeValueType) * 2);
+  if (m_NumberOfFailedTiles > 0)
+    {
+    const OutputRegionType mapRegion = map->GetLargestPossibleRegion();
+    OutputIndexType lower = mapRegion.GetUpperIndex();
+    OutputIndexType upper = mapRegion.GetIndex();
+    ImageRegionConstIteratorWithIndex<OutputImageType> mapIte(map, mapRegion);
+    for (; !mapIte.IsAtEnd(); ++mapIte)
+      {
+      if (failedTiles[this->GetWarmStartTile(mapRegion, mapIte.GetIndex())])
+        {
+        for (unsigned int i = 0; i < OutputImageDimension; i++)
+          {
+          lower[i] = std::min(lower[i], mapIte.GetIndex()[i]);
+          upper[i] = std::max(upper[i], mapIte.GetIndex()[i]);
+          }
+        }
+      }
+
+    // Sub volume of the bounding box, aligned on the coarsest level of the pyramid.
+    const OffsetValueType alignment = m_Schedule.GetElement(0, (m_ProjectionDimension == 0) ? 1 : 0);
+    const OffsetValueType kernelRadius = static_cast<OffsetValueType>(std::ceil(3 * std::sqrt(m_Sigma))) + 1;
+    OffsetValueType halo = 0;
+    for (unsigned int level = 0; level < m_NumberOfLevels; level++)
+      {
+      halo += static_cast<OffsetValueType>(m_Schedule.GetElement(level, (m_ProjectionDimension == 0) ? 1 : 0)) * kernelRadius;
+      }
+    halo = (halo + alignment - 1) / alignment * alignment;
+    InputRegionType subRegion = input->GetLargestPossibleRegion();
+    InputIndexType subIndex = subRegion.GetIndex();
+    InputSizeType subSize = subRegion.GetSize();
+    for (unsigned int i = 0; i < OutputImageDimension; i++)
+      {
+      // Input dimension of the output dimension i, if not projected.
+      unsigned int j = i;
+      if (i == m_ProjectionDimension)
+        {
+        if (InputImageDimension == OutputImageDimension)
+          {
+          continue;
+          }
+        j = InputImageDimension - 1;
+        }
+      const OffsetValueType first = subRegion.GetIndex()[j]
+                                    + (lower[i] - mapRegion.GetIndex()[i] - halo) / alignment * alignment;
+      subIndex[j] = std::max(first, subRegion.GetIndex()[j]);
+      subSize[j] = std::min<OffsetValueType>(upper[i] + halo + 1, subRegion.GetUpperIndex()[j] + 1) - subIndex[j];
+      }
+    subRegion.SetIndex(subIndex);
+    subRegion.SetSize(subSize);
+
+    using RegionOfInterestFilterType = RegionOfInterestImageFilter<InputImageType, InputImageType>;
+    typename RegionOfInterestFilterType::Pointer regionOfInterestFilter = RegionOfInterestFilterType::New();
+    regionOfInterestFilter->SetInput(input);
+    regionOfInterestFilter->SetRegionOfInterest(subRegion);
+    regionOfInterestFilter->Update();
+    OutputImagePointer subMap = this->GeneratePyramidDepthMap(regionOfInterestFilter->GetOutput());
+
+    // Replace the failed tiles by the pyramid result.
+    ImageRegionIteratorWithIndex<OutputImageType> outputIte(map, mapRegion);
+    for (; !outputIte.IsAtEnd(); ++outputIte)
+      {
+      const OutputIndexType index = outputIte.GetIndex();
+      if (!failedTiles[this->GetWarmStartTile(mapRegion, index)])
+        {
+        continue;
+        }
+      OutputIndexType subMapIndex = subMap->GetLargestPossibleRegion().GetIndex();
+      for (unsigned int i = 0; i < OutputImageDimension; i++)
+        {
+        unsigned int j = i;
+        if (i == m_ProjectionDimension)
+          {
+          if (InputImageDimension == OutputImageDimension)
+            {
+            continue;
+            }
+          j = InputImageDimension - 1;
+          }
+        subMapIndex[i] += index[i] - subRegion.GetIndex()[j];
+        }
+      outputIte.Set(subMap->GetPixel(subMapIndex));
+      }
+    }
 
   // Graft it to the pipeline output
-  this->GetOutput()->Graft(previousMap);
+  this->GetOutput()->Graft(map);
 }
 
 } // namespace itk
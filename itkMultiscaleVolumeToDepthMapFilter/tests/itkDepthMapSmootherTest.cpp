@@ -0,0 +1,147 @@
+
+#include <algorithm>
+#include <cmath>
+
+#include "itkImageFileReader.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIterator.h"
+#include "itkDiscreteGaussianImageFilter.h"
+#include "itkMinimumMaximumImageCalculator.h"
+#include "itkDepthMapSmoother.h"
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+    {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " InputMap Variance [MaximumKernelWidth]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  using MapType = itk::Image<float, 2>;
+  using DepthMapType = itk::Image<unsigned short, 2>;
+  using MapReaderType = itk::ImageFileReader<MapType>;
+  using SmootherType = itk::DepthMapSmoother<MapType>;
+  using DepthMapSmootherType = itk::DepthMapSmoother<DepthMapType>;
+  using GaussianFilterType = itk::DiscreteGaussianImageFilter<MapType, MapType>;
+  using CalculatorType = itk::MinimumMaximumImageCalculator<MapType>;
+
+  MapReaderType::Pointer reader = MapReaderType::New();
+  reader->SetFileName(argv[1]);
+  try
+    {
+    reader->Update();
+    }
+  catch (itk::ExceptionObject &excp)
+    {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+    }
+  MapType::Pointer map = reader->GetOutput();
+  const MapType::RegionType region = map->GetLargestPossibleRegion();
+  const double variance = std::atof(argv[2]);
+  const unsigned int maximumKernelWidth = argc >= 4 ? std::atoi(argv[3]) : 32;
+
+  SmootherType::Pointer smoother = SmootherType::New();
+  smoother->SetVariance(variance);
+  smoother->SetMaximumKernelWidth(maximumKernelWidth);
+  MapType::Pointer smoothed = MapType::New();
+  smoothed->CopyInformation(map);
+  smoothed->SetRegions(region);
+  smoothed->Allocate();
+  smoother->Smooth(map, smoothed);
+  const bool recursive = smoother->IsRecursive(map, 0);
+
+  // Same values as the discrete Gaussian filter, its kernel being wide enough
+  // to compare the recursive Gaussian with.
+  GaussianFilterType::Pointer gaussianFilter = GaussianFilterType::New();
+  gaussianFilter->SetInput(map);
+  gaussianFilter->SetVariance(variance);
+  gaussianFilter->SetUseImageSpacing(false);
+  gaussianFilter->SetMaximumKernelWidth(recursive ? 1024 : maximumKernelWidth);
+  CalculatorType::Pointer calculator = CalculatorType::New();
+  calculator->SetImage(map);
+  try
+    {
+    gaussianFilter->Update();
+    calculator->Compute();
+    }
+  catch (itk::ExceptionObject &excp)
+    {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+    }
+  const double tolerance = (recursive ? 0.01 : 1e-4) * std::max(calculator->GetMaximum() - calculator->GetMinimum(), 1.0f);
+  unsigned long mismatch = 0;
+  double maximumDifference = 0;
+  itk::ImageRegionConstIterator<MapType> smoothedIte(smoothed, region);
+  itk::ImageRegionConstIterator<MapType> gaussianIte(gaussianFilter->GetOutput(), region);
+  for (; !smoothedIte.IsAtEnd(); ++smoothedIte, ++gaussianIte)
+    {
+    const double difference = std::abs(smoothedIte.Get() - gaussianIte.Get());
+    maximumDifference = std::max(maximumDifference, difference);
+    mismatch += difference > tolerance ? 1 : 0;
+    }
+  std::cout << "Difference to the discrete Gaussian: " << maximumDifference << (recursive ? " (recursive)" : "")
+            << std::endl;
+
+  // Tiles smoothed with their margin, by a single work unit, give the whole map smoothed.
+  MapType::Pointer tiled = MapType::New();
+  tiled->CopyInformation(map);
+  tiled->SetRegions(region);
+  tiled->Allocate();
+  smoother->SetNumberOfWorkUnits(1);
+  for (itk::IndexValueType y = 0; y < static_cast<itk::IndexValueType>(region.GetSize(1)); y += 37)
+    {
+    for (itk::IndexValueType x = 0; x < static_cast<itk::IndexValueType>(region.GetSize(0)); x += 53)
+      {
+      MapType::RegionType tile = region;
+      tile.SetIndex(0, region.GetIndex(0) + x);
+      tile.SetIndex(1, region.GetIndex(1) + y);
+      tile.SetSize(0, 53);
+      tile.SetSize(1, 37);
+      tile.Crop(region);
+      smoother->Smooth(map, tiled, tile);
+      }
+    }
+  itk::ImageRegionConstIterator<MapType> tiledIte(tiled, region);
+  for (smoothedIte.GoToBegin(); !smoothedIte.IsAtEnd(); ++smoothedIte, ++tiledIte)
+    {
+    mismatch += smoothedIte.Get() != tiledIte.Get() ? 1 : 0;
+    }
+
+  // In place, the map is the cast of the smoothed values.
+  DepthMapType::Pointer depthMap = DepthMapType::New();
+  depthMap->CopyInformation(map);
+  depthMap->SetRegions(region);
+  depthMap->Allocate();
+  itk::ImageRegionConstIterator<MapType> mapIte(map, region);
+  itk::ImageRegionIterator<DepthMapType> depthIte(depthMap, region);
+  for (; !mapIte.IsAtEnd(); ++mapIte, ++depthIte)
+    {
+    depthIte.Set(static_cast<unsigned short>(std::max(mapIte.Get(), 0.0f)));
+    }
+  MapType::Pointer depthValues = MapType::New();
+  depthValues->CopyInformation(map);
+  depthValues->SetRegions(region);
+  depthValues->Allocate();
+  itk::ImageRegionIterator<MapType> valueIte(depthValues, region);
+  for (depthIte.GoToBegin(); !depthIte.IsAtEnd(); ++depthIte, ++valueIte)
+    {
+    valueIte.Set(depthIte.Get());
+    }
+  smoother->SetNumberOfWorkUnits(4);
+  smoother->Smooth(depthValues, smoothed);
+  DepthMapSmootherType::Pointer depthSmoother = DepthMapSmootherType::New();
+  depthSmoother->SetVariance(variance);
+  depthSmoother->SetMaximumKernelWidth(maximumKernelWidth);
+  depthSmoother->Smooth(depthMap, depthMap);
+  for (smoothedIte.GoToBegin(), depthIte.GoToBegin(); !smoothedIte.IsAtEnd(); ++smoothedIte, ++depthIte)
+    {
+    mismatch += static_cast<unsigned short>(smoothedIte.Get()) != depthIte.Get() ? 1 : 0;
+    }
+
+  std::cout << "Mismatching pixels: " << mismatch << std::endl;
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
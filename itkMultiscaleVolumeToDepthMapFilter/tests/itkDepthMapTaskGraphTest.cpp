@@ -0,0 +1,89 @@
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "itkDepthMapTaskGraph.h"
+
+using itk::DepthMapTaskGraph;
+
+// Run a random graph, each task depending on a few earlier ones, and check that
+// every task runs once, after all its dependencies.
+unsigned long CheckRandomGraph(std::mt19937 &generator, size_t numberOfTasks, unsigned int numberOfThreads)
+{
+  DepthMapTaskGraph graph;
+  std::vector<std::vector<size_t>> dependencies(numberOfTasks);
+  std::vector<size_t> order(numberOfTasks, 0);
+  std::vector<unsigned int> runs(numberOfTasks, 0);
+  std::atomic<size_t> counter(0);
+  for (size_t task = 0; task < numberOfTasks; task++)
+    {
+    graph.AddTask([&, task]() {
+      runs[task]++;
+      order[task] = ++counter;
+    });
+    const size_t numberOfDependencies = task == 0 ? 0 : generator() % 4;
+    for (size_t d = 0; d < numberOfDependencies; d++)
+      {
+      const size_t dependency = generator() % task;
+      dependencies[task].push_back(dependency);
+      graph.AddDependency(task, dependency);
+      }
+    }
+  graph.Run(numberOfThreads);
+
+  unsigned long mismatch = 0;
+  for (size_t task = 0; task < numberOfTasks; task++)
+    {
+    bool valid = runs[task] == 1 && graph.GetStopTime(task) >= graph.GetStartTime(task);
+    for (size_t dependency : dependencies[task])
+      {
+      valid = valid && order[dependency] < order[task] && graph.GetStopTime(dependency) <= graph.GetStartTime(task);
+      }
+    if (!valid)
+      {
+      mismatch++;
+      }
+    }
+  return mismatch;
+}
+
+int main()
+{
+  std::mt19937 generator(42);
+  unsigned long mismatch = 0;
+  for (unsigned int threads = 1; threads <= 8; threads *= 2)
+    {
+    for (size_t numberOfTasks : {1, 10, 1000})
+      {
+      mismatch += CheckRandomGraph(generator, numberOfTasks, threads);
+      }
+    }
+
+  // The exception of a task is rethrown, its successors not being run.
+  DepthMapTaskGraph graph;
+  bool successorRun = false;
+  const DepthMapTaskGraph::TaskIdType failing = graph.AddTask([]() { throw std::runtime_error("task failure"); });
+  const DepthMapTaskGraph::TaskIdType successor = graph.AddTask([&]() { successorRun = true; });
+  graph.AddDependency(successor, failing);
+  bool thrown = false;
+  try
+    {
+    graph.Run(4);
+    }
+  catch (std::runtime_error &)
+    {
+    thrown = true;
+    }
+  if (!thrown || successorRun)
+    {
+    std::cerr << "Task exception not propagated" << std::endl;
+    mismatch++;
+    }
+
+  std::cout << "Mismatching tasks: " << mismatch << std::endl;
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -2,6 +2,7 @@
 
 #include "itkImageFileReader.h"
 #include "itkImageFileWriter.h"
+#include "itkImageRegionConstIterator.h"
 #include "itkMultiscaleVolumeToDepthMapFilter.h"
 
 int main(int argc, char **argv)
@@ -10,7 +11,7 @@ int main(int argc, char **argv)
     {
     std::cerr << "Missing Parameters " << std::endl;
     std::cerr << "Usage: " << argv[0];
-    std::cerr << " InputImage OutputImage NumberOfLevels [Sigma | Peak | Tolerance]" << std::endl;
+    std::cerr << " InputImage OutputImage NumberOfLevels [Sigma | Peak | Tolerance | Pyramid | MaximumMemory | Interpolation | WarmStart | AdaptiveRange | Wavefront]" << std::endl;
     return EXIT_FAILURE;
     }
 
@@ -26,21 +27,40 @@ int main(int argc, char **argv)
   auto start = std::chrono::high_resolution_clock::now();
 
   using FilterType = itk::MultiscaleVolumeToDepthMapFilter<VolumeType, ImageType>;
+  auto Configure = [&](FilterType *filter) {
+    filter->SetInput(reader->GetOutput());
+    filter->SetNumberOfLevels(std::atoi(argv[3]));
+    if (argc >= 5)
+      {
+      filter->SetSigma(std::atoi(argv[4]));
+      }
+    if (argc >= 6)
+      {
+      filter->SetPeak(std::atoi(argv[5]));
+      }
+    if (argc >= 7)
+      {
+      filter->SetTolerance(std::atoi(argv[6]));
+      }
+    if (argc >= 8)
+      {
+      filter->SetPyramid(std::atoi(argv[7]));
+      }
+    if (argc >= 9)
+      {
+      filter->SetMaximumMemory(std::atol(argv[8]));
+      }
+    if (argc >= 10)
+      {
+      filter->SetInterpolation(std::atoi(argv[9]));
+      }
+    if (argc >= 12)
+      {
+      filter->SetAdaptiveRange(std::atoi(argv[11]) != 0);
+      }
+  };
   FilterType::Pointer filter = FilterType::New();
-  filter->SetInput(reader->GetOutput());
-  filter->SetNumberOfLevels(std::atoi(argv[3]));
-  if (argc >= 5)
-    {
-    filter->SetSigma(std::atoi(argv[4]));
-    }
-  if (argc >= 6)
-    {
-    filter->SetPeak(std::atoi(argv[5]));
-    }
-  if (argc >= 7)
-    {
-    filter->SetTolerance(std::atoi(argv[6]));
-    }
+  Configure(filter);
   try
     {
     filter->Update();
@@ -54,6 +74,72 @@ int main(int argc, char **argv)
   auto finish = std::chrono::high_resolution_clock::now();
   std::chrono::duration<float> elapsed = finish - start;
 
+  // Recompute the map as a tile wavefront, which must give the same map.
+  if (argc >= 13 && std::atoi(argv[12]) != 0)
+    {
+    auto wavefrontStart = std::chrono::high_resolution_clock::now();
+    FilterType::Pointer wavefrontFilter = FilterType::New();
+    Configure(wavefrontFilter);
+    wavefrontFilter->SetWavefront(true);
+    wavefrontFilter->SetTileSize(32);
+    try
+      {
+      wavefrontFilter->Update();
+      }
+    catch (itk::ExceptionObject &excp)
+      {
+      std::cerr << excp << std::endl;
+      return EXIT_FAILURE;
+      }
+    std::chrono::duration<float> wavefrontElapsed = std::chrono::high_resolution_clock::now() - wavefrontStart;
+
+    unsigned long mismatch = 0;
+    itk::ImageRegionConstIterator<ImageType> levelIte(filter->GetOutput(), filter->GetOutput()->GetLargestPossibleRegion());
+    itk::ImageRegionConstIterator<ImageType> wavefrontIte(wavefrontFilter->GetOutput(),
+                                                          wavefrontFilter->GetOutput()->GetLargestPossibleRegion());
+    for (; !levelIte.IsAtEnd(); ++levelIte, ++wavefrontIte)
+      {
+      if (levelIte.Get() != wavefrontIte.Get())
+        {
+        mismatch++;
+        }
+      }
+    std::cout << "Wavefront time: " << wavefrontElapsed.count() << " s, ";
+    std::cout << "Mismatching pixels: " << mismatch << std::endl;
+    if (mismatch > 0)
+      {
+      return EXIT_FAILURE;
+      }
+    }
+
+  // Recompute the map warm started by the first one, as for the next timepoint.
+  if (argc >= 11 && std::atoi(argv[10]) != 0)
+    {
+    ImageType::Pointer warmStart = filter->GetOutput();
+    warmStart->DisconnectPipeline();
+
+    auto warmStartStart = std::chrono::high_resolution_clock::now();
+    filter = FilterType::New();
+    filter->SetInput(reader->GetOutput());
+    filter->SetNumberOfLevels(std::atoi(argv[3]));
+    filter->SetSigma(std::atoi(argv[4]));
+    filter->SetPeak(std::atoi(argv[5]));
+    filter->SetTolerance(std::atoi(argv[6]));
+    filter->SetWarmStart(warmStart);
+    try
+      {
+      filter->Update();
+      }
+    catch (itk::ExceptionObject &excp)
+      {
+      std::cerr << excp << std::endl;
+      return EXIT_FAILURE;
+      }
+    std::chrono::duration<float> warmStartElapsed = std::chrono::high_resolution_clock::now() - warmStartStart;
+    std::cout << "Warm start time: " << warmStartElapsed.count() << " s, ";
+    std::cout << filter->GetNumberOfFailedTiles() << " failed tiles" << std::endl;
+    }
+
   using ImageWriterType = itk::ImageFileWriter<ImageType>;
   ImageWriterType::Pointer writer = ImageWriterType::New();
   writer->SetInput(filter->GetOutput());
@@ -68,6 +154,11 @@ int main(int argc, char **argv)
     return EXIT_FAILURE;
     }
 
+  for (size_t level = 0; level < filter->GetLevelTimes().size(); level++)
+    {
+    std::cout << "Level " << level << " time: " << filter->GetLevelTimes()[level] << " s, ";
+    std::cout << "band width: " << filter->GetLevelBandWidths()[level] << std::endl;
+    }
   std::cout << "Elapsed time: " << elapsed.count() << " s" << std::endl;
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,263 @@
+#ifndef __itkDepthMapArgMax_h
+#define __itkDepthMapArgMax_h
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ITK_DEPTHMAP_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace itk
+{
+
+/** \namespace DepthMapArgMax
+ * \brief Running arg-max of a row of adjacent columns.
+ *
+ * Update the maximum value of n adjacent columns, and the depth where it is
+ * first reached, with the values of one row of a plane. For float and
+ * unsigned short pixels the compare-and-select runs 4 to 32 columns wide with
+ * SSE2, AVX2 or AVX-512, the instruction set being picked at runtime. Other
+ * pixel types use the scalar loop. All instruction sets give the same result
+ * as std::max_element on each column.
+ *
+ * \author Stephane U. Rigaud (stephane.rigaud@pasteur.fr)
+ */
+namespace DepthMapArgMax
+{
+
+using DepthType = int32_t;
+
+enum InstructionSetType
+{
+  Scalar = 0,
+  SSE2 = 1,
+  AVX2 = 2,
+  AVX512 = 3
+};
+
+/** Scalar update, used for the tail of the vector loops. */
+template <typename TPixel>
+inline void
+UpdateScalar(const TPixel *row, TPixel *maxValue, DepthType *maxDepth, DepthType depth, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    {
+    if (row[i] > maxValue[i])
+      {
+      maxValue[i] = row[i];
+      maxDepth[i] = depth;
+      }
+    }
+}
+
+#ifdef ITK_DEPTHMAP_X86_SIMD
+
+__attribute__((target("sse2"))) inline void
+UpdateSSE2(const float *row, float *maxValue, DepthType *maxDepth, DepthType depth, size_t n)
+{
+  const __m128i depthVector = _mm_set1_epi32(depth);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+    __m128 value = _mm_loadu_ps(row + i);
+    __m128 currentMax = _mm_loadu_ps(maxValue + i);
+    __m128 greater = _mm_cmpgt_ps(value, currentMax);
+    _mm_storeu_ps(maxValue + i, _mm_or_ps(_mm_and_ps(greater, value), _mm_andnot_ps(greater, currentMax)));
+    __m128i mask = _mm_castps_si128(greater);
+    __m128i currentDepth = _mm_loadu_si128(reinterpret_cast<const __m128i *>(maxDepth + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(maxDepth + i),
+                     _mm_or_si128(_mm_and_si128(mask, depthVector), _mm_andnot_si128(mask, currentDepth)));
+    }
+  UpdateScalar(row + i, maxValue + i, maxDepth + i, depth, n - i);
+}
+
+__attribute__((target("sse2"))) inline void
+UpdateSSE2(const unsigned short *row, unsigned short *maxValue, DepthType *maxDepth, DepthType depth, size_t n)
+{
+  // SSE2 only has a signed 16 bits comparison, flip the sign bit to compare unsigned values.
+  const __m128i bias = _mm_set1_epi16(static_cast<short>(0x8000));
+  const __m128i depthVector = _mm_set1_epi32(depth);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+    __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+    __m128i currentMax = _mm_loadu_si128(reinterpret_cast<const __m128i *>(maxValue + i));
+    __m128i greater = _mm_cmpgt_epi16(_mm_xor_si128(value, bias), _mm_xor_si128(currentMax, bias));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(maxValue + i),
+                     _mm_or_si128(_mm_and_si128(greater, value), _mm_andnot_si128(greater, currentMax)));
+    __m128i mask[2] = {_mm_unpacklo_epi16(greater, greater), _mm_unpackhi_epi16(greater, greater)};
+    for (size_t k = 0; k < 2; k++)
+      {
+      __m128i *depthPointer = reinterpret_cast<__m128i *>(maxDepth + i + 4 * k);
+      __m128i currentDepth = _mm_loadu_si128(depthPointer);
+      _mm_storeu_si128(depthPointer,
+                       _mm_or_si128(_mm_and_si128(mask[k], depthVector), _mm_andnot_si128(mask[k], currentDepth)));
+      }
+    }
+  UpdateScalar(row + i, maxValue + i, maxDepth + i, depth, n - i);
+}
+
+__attribute__((target("avx2"))) inline void
+UpdateAVX2(const float *row, float *maxValue, DepthType *maxDepth, DepthType depth, size_t n)
+{
+  const __m256i depthVector = _mm256_set1_epi32(depth);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+    __m256 value = _mm256_loadu_ps(row + i);
+    __m256 currentMax = _mm256_loadu_ps(maxValue + i);
+    __m256 greater = _mm256_cmp_ps(value, currentMax, _CMP_GT_OQ);
+    _mm256_storeu_ps(maxValue + i, _mm256_blendv_ps(currentMax, value, greater));
+    __m256i *depthPointer = reinterpret_cast<__m256i *>(maxDepth + i);
+    __m256i currentDepth = _mm256_loadu_si256(depthPointer);
+    _mm256_storeu_si256(depthPointer, _mm256_blendv_epi8(currentDepth, depthVector, _mm256_castps_si256(greater)));
+    }
+  UpdateScalar(row + i, maxValue + i, maxDepth + i, depth, n - i);
+}
+
+__attribute__((target("avx2"))) inline void
+UpdateAVX2(const unsigned short *row, unsigned short *maxValue, DepthType *maxDepth, DepthType depth, size_t n)
+{
+  const __m256i bias = _mm256_set1_epi16(static_cast<short>(0x8000));
+  const __m256i depthVector = _mm256_set1_epi32(depth);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    {
+    __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i));
+    __m256i currentMax = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(maxValue + i));
+    __m256i greater = _mm256_cmpgt_epi16(_mm256_xor_si256(value, bias), _mm256_xor_si256(currentMax, bias));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(maxValue + i), _mm256_blendv_epi8(currentMax, value, greater));
+    __m256i mask[2] = {_mm256_cvtepi16_epi32(_mm256_castsi256_si128(greater)),
+                       _mm256_cvtepi16_epi32(_mm256_extracti128_si256(greater, 1))};
+    for (size_t k = 0; k < 2; k++)
+      {
+      __m256i *depthPointer = reinterpret_cast<__m256i *>(maxDepth + i + 8 * k);
+      __m256i currentDepth = _mm256_loadu_si256(depthPointer);
+      _mm256_storeu_si256(depthPointer, _mm256_blendv_epi8(currentDepth, depthVector, mask[k]));
+      }
+    }
+  UpdateScalar(row + i, maxValue + i, maxDepth + i, depth, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline void
+UpdateAVX512(const float *row, float *maxValue, DepthType *maxDepth, DepthType depth, size_t n)
+{
+  const __m512i depthVector = _mm512_set1_epi32(depth);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    {
+    __m512 value = _mm512_loadu_ps(row + i);
+    __m512 currentMax = _mm512_loadu_ps(maxValue + i);
+    __mmask16 greater = _mm512_cmp_ps_mask(value, currentMax, _CMP_GT_OQ);
+    _mm512_storeu_ps(maxValue + i, _mm512_mask_mov_ps(currentMax, greater, value));
+    __m512i currentDepth = _mm512_loadu_si512(maxDepth + i);
+    _mm512_storeu_si512(maxDepth + i, _mm512_mask_mov_epi32(currentDepth, greater, depthVector));
+    }
+  UpdateScalar(row + i, maxValue + i, maxDepth + i, depth, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline void
+UpdateAVX512(const unsigned short *row, unsigned short *maxValue, DepthType *maxDepth, DepthType depth, size_t n)
+{
+  const __m512i depthVector = _mm512_set1_epi32(depth);
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32)
+    {
+    __m512i value = _mm512_loadu_si512(row + i);
+    __m512i currentMax = _mm512_loadu_si512(maxValue + i);
+    __mmask32 greater = _mm512_cmpgt_epu16_mask(value, currentMax);
+    _mm512_storeu_si512(maxValue + i, _mm512_mask_mov_epi16(currentMax, greater, value));
+    const __mmask16 mask[2] = {static_cast<__mmask16>(greater), static_cast<__mmask16>(greater >> 16)};
+    for (size_t k = 0; k < 2; k++)
+      {
+      __m512i currentDepth = _mm512_loadu_si512(maxDepth + i + 16 * k);
+      _mm512_storeu_si512(maxDepth + i + 16 * k, _mm512_mask_mov_epi32(currentDepth, mask[k], depthVector));
+      }
+    }
+  UpdateScalar(row + i, maxValue + i, maxDepth + i, depth, n - i);
+}
+
+#endif
+
+/** Widest instruction set supported by the processor. */
+inline InstructionSetType
+GetSupportedInstructionSet()
+{
+#ifdef ITK_DEPTHMAP_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+    {
+    return AVX512;
+    }
+  if (__builtin_cpu_supports("avx2"))
+    {
+    return AVX2;
+    }
+  if (__builtin_cpu_supports("sse2"))
+    {
+    return SSE2;
+    }
+#endif
+  return Scalar;
+}
+
+/** Update with a given instruction set, which must be supported by the processor. */
+template <typename TPixel>
+inline void
+Update(const TPixel *row, TPixel *maxValue, DepthType *maxDepth, DepthType depth, size_t n, InstructionSetType)
+{
+  UpdateScalar(row, maxValue, maxDepth, depth, n);
+}
+
+#ifdef ITK_DEPTHMAP_X86_SIMD
+template <typename TPixel>
+inline void
+UpdateVector(const TPixel *row, TPixel *maxValue, DepthType *maxDepth, DepthType depth, size_t n,
+             InstructionSetType instructionSet)
+{
+  switch (instructionSet)
+    {
+    case AVX512:
+      UpdateAVX512(row, maxValue, maxDepth, depth, n);
+      break;
+    case AVX2:
+      UpdateAVX2(row, maxValue, maxDepth, depth, n);
+      break;
+    case SSE2:
+      UpdateSSE2(row, maxValue, maxDepth, depth, n);
+      break;
+    default:
+      UpdateScalar(row, maxValue, maxDepth, depth, n);
+    }
+}
+
+inline void
+Update(const float *row, float *maxValue, DepthType *maxDepth, DepthType depth, size_t n,
+       InstructionSetType instructionSet)
+{
+  UpdateVector(row, maxValue, maxDepth, depth, n, instructionSet);
+}
+
+inline void
+Update(const unsigned short *row, unsigned short *maxValue, DepthType *maxDepth, DepthType depth, size_t n,
+       InstructionSetType instructionSet)
+{
+  UpdateVector(row, maxValue, maxDepth, depth, n, instructionSet);
+}
+#endif
+
+/** Update with the widest instruction set supported by the processor. */
+template <typename TPixel>
+inline void
+Update(const TPixel *row, TPixel *maxValue, DepthType *maxDepth, DepthType depth, size_t n)
+{
+  static const InstructionSetType instructionSet = GetSupportedInstructionSet();
+  Update(row, maxValue, maxDepth, depth, n, instructionSet);
+}
+
+} // namespace DepthMapArgMax
+} // namespace itk
+
+#endif // __itkDepthMapArgMax_h
@@ -0,0 +1,145 @@
+#ifndef __itkDepthMapPeakDetector_h
+#define __itkDepthMapPeakDetector_h
+
+#include <cstdint>
+
+namespace itk
+{
+
+/** \class DepthMapPeakDetector
+ * \brief Single pass peak detection along a column.
+ *
+ * Values of a column are pushed one at a time in increasing depth order,
+ * in constant memory. The detector alternates between looking for a peak,
+ * confirmed when a value drops below the current maximum minus the tolerance,
+ * and looking for a valley, confirmed when a value rises above the current
+ * minimum plus the tolerance. The detected depth is:
+ * - the depth of the maximum value (peak = 0),
+ * - the depth of the first confirmed peak (peak = 1),
+ * - the depth of the last confirmed peak (peak = 2),
+ * falling back to the maximum value if no peak is confirmed.
+ *
+ * When a peak (valley) is confirmed, every value between it and the current
+ * one lies within the tolerance of it, so the valley (peak) search restarts
+ * from the current value without going back along the column.
+ *
+ * The per-column State is kept apart from the detection parameters, so that
+ * a plane by plane search can hold one State per column in a flat array.
+ *
+ * \author Stephane U. Rigaud (stephane.rigaud@pasteur.fr)
+ */
+template <typename TPixel>
+class DepthMapPeakDetector
+{
+public:
+  using PixelType = TPixel;
+  using DepthType = int32_t;
+
+  /** Running state of one column. */
+  struct State
+  {
+    PixelType maxValue = PixelType();
+    float extremum = 0;
+    DepthType maxDepth = -1;
+    DepthType extremumDepth = -1;
+    DepthType firstPeak = -1;
+    DepthType lastPeak = -1;
+    bool lookForPeak = true;
+    bool done = false;
+  };
+
+  DepthMapPeakDetector(unsigned int peak, float tolerance)
+    : m_Peak(peak)
+    , m_Tolerance(tolerance)
+  {}
+
+  /** Push the next value of the column. Return false once the detected depth
+   * is known, the remaining values of the column can then be skipped. */
+  bool
+  Push(State &state, const PixelType value, DepthType depth) const
+  {
+    if (state.done)
+      {
+      return false;
+      }
+    if (state.maxDepth < 0)
+      {
+      state.maxValue = value;
+      state.maxDepth = depth;
+      state.extremum = value;
+      state.extremumDepth = depth;
+      return true;
+      }
+    if (value > state.maxValue)
+      {
+      state.maxValue = value;
+      state.maxDepth = depth;
+      }
+    if (m_Peak != 1 && m_Peak != 2)
+      {
+      return true;
+      }
+    if (state.lookForPeak)
+      {
+      if (value > state.extremum)
+        {
+        state.extremum = value;
+        state.extremumDepth = depth;
+        }
+      else if (value < state.extremum - m_Tolerance)
+        {
+        if (state.firstPeak < 0)
+          {
+          state.firstPeak = state.extremumDepth;
+          }
+        state.lastPeak = state.extremumDepth;
+        if (m_Peak == 1)
+          {
+          state.done = true;
+          return false;
+          }
+        state.lookForPeak = false;
+        state.extremum = value;
+        state.extremumDepth = depth;
+        }
+      }
+    else
+      {
+      if (value < state.extremum)
+        {
+        state.extremum = value;
+        state.extremumDepth = depth;
+        }
+      else if (value > state.extremum + m_Tolerance)
+        {
+        state.lookForPeak = true;
+        state.extremum = value;
+        state.extremumDepth = depth;
+        }
+      }
+    return true;
+  }
+
+  /** Detected depth of the column, -1 if no value was pushed. */
+  DepthType
+  GetDepth(const State &state) const
+  {
+    if (m_Peak == 1 && state.firstPeak >= 0)
+      {
+      return state.firstPeak;
+      }
+    if (m_Peak == 2 && state.lastPeak >= 0)
+      {
+      return state.lastPeak;
+      }
+    return state.maxDepth;
+  }
+
+private:
+  unsigned int m_Peak;
+  float m_Tolerance;
+};
+
+} // namespace itk
+
+#endif // __itkDepthMapPeakDetector_h
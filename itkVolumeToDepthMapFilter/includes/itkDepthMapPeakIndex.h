@@ -0,0 +1,223 @@
+#ifndef __itkDepthMapPeakIndex_h
+#define __itkDepthMapPeakIndex_h
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+#include "itkNumericTraits.h"
+#include "itkDepthMapPeakDetector.h"
+#include "itkDepthMapPlaneOperator.h"
+
+namespace itk
+{
+
+/** \class DepthMapPeakIndex
+ * \brief Peak candidates of the columns of a volume, to repeat a depth search without the voxels.
+ *
+ * DepthMapPeakDetector only changes its state at the turning points of a
+ * column, its local maxima and minima, a plateau counting as its first depth.
+ * Replayed on the turning points alone, alternating maxima and minima whose
+ * differences are the prominences tested against the tolerance, the detector
+ * gives the depth it gives on the whole column, for any tolerance and peak
+ * mode. The index holds the turning points of every column, with its first
+ * and last values, as 16 bits depths and float values in flat arrays. It is
+ * built by a single plane by plane sweep of the volume, optionally transformed
+ * by a plane operator, the columns being split between the threads.
+ *
+ * GetDepth() replays a whole column. A band of a column is not replayed: the
+ * values at its ends are not turning points, so they are not in the index, and
+ * the detection depends on them.
+ *
+ * With a minimum tolerance (m_MinimumTolerance, 0 by default), a maximum and a
+ * minimum differing by at most this tolerance are dropped when they lie
+ * strictly within the range of the candidates around them, as they can neither
+ * confirm a peak nor hold the maximum value. The index of a noisy volume is
+ * then smaller, and only exact for tolerances of at least this tolerance.
+ *
+ * Columns are numbered in the memory order of the plane of the indexed region
+ * (see GetColumn()) and depths are counted from its first plane. Write() and
+ * Read() save and restore the index, with the geometry of the volume, as a
+ * binary stream of the native byte order.
+ *
+ * \author Stephane U. Rigaud (stephane.rigaud@pasteur.fr)
+ */
+template <class TInputImage>
+class DepthMapPeakIndex : public Object
+{
+public:
+  ITK_DISALLOW_COPY_AND_ASSIGN(DepthMapPeakIndex);
+
+  /** Standard class typedefs. **/
+  using Self = DepthMapPeakIndex;
+  using Superclass = Object;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  /** Method for creation through the object factory. **/
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). **/
+  itkTypeMacro(DepthMapPeakIndex, Object);
+
+  static constexpr unsigned int ImageDimension = TInputImage::ImageDimension;
+
+  using InputImageType = TInputImage;
+  using InputImagePointer = typename InputImageType::Pointer;
+  using RegionType = typename InputImageType::RegionType;
+  using IndexType = typename InputImageType::IndexType;
+  using SizeType = typename InputImageType::SizeType;
+  using SpacingType = typename InputImageType::SpacingType;
+  using PointType = typename InputImageType::PointType;
+  using DirectionType = typename InputImageType::DirectionType;
+  using PlaneOperatorType = DepthMapPlaneOperator<InputImageType>;
+  using ValueType = typename PlaneOperatorType::ValueType;
+  using PeakDetectorType = DepthMapPeakDetector<ValueType>;
+  using DepthType = typename PeakDetectorType::DepthType;
+  using CandidateDepthType = uint16_t;
+
+  itkSetMacro(MinimumTolerance, float);
+  itkGetMacro(MinimumTolerance, float);
+  itkGetConstReferenceMacro(Region, RegionType);
+  itkGetConstReferenceMacro(ProjectionDimension, unsigned int);
+
+  SizeValueType
+  GetNumberOfColumns() const
+  {
+    return m_Offsets.empty() ? 0 : m_Offsets.size() - 1;
+  }
+
+  SizeValueType
+  GetNumberOfCandidates() const
+  {
+    return m_Depths.size();
+  }
+
+  /** Size of the index in bytes. **/
+  SizeValueType
+  GetNumberOfBytes() const
+  {
+    return m_Offsets.size() * sizeof(uint64_t) + m_Depths.size() * (sizeof(CandidateDepthType) + sizeof(ValueType));
+  }
+
+  /** Index the columns of a buffered volume along the projection dimension, each
+   * plane being transformed by the plane operator if not null. **/
+  void
+  Build(const InputImageType *volume, unsigned int projectionDimension, const PlaneOperatorType *planeOperator,
+        unsigned int numberOfWorkUnits);
+
+  /** Volume of the indexed geometry, without buffer, to be searched with the index. **/
+  InputImagePointer
+  CreateVolumeInformation() const;
+
+  /** Column of a pixel of the indexed region, whatever its depth. **/
+  SizeValueType
+  GetColumn(const IndexType &index) const
+  {
+    SizeValueType column = 0;
+    SizeValueType stride = 1;
+    for (unsigned int i = 0; i < ImageDimension; i++)
+      {
+      if (i != m_ProjectionDimension)
+        {
+        column += static_cast<SizeValueType>(index[i] - m_Region.GetIndex()[i]) * stride;
+        stride *= m_Region.GetSize()[i];
+        }
+      }
+    return column;
+  }
+
+  /** Depth detected in a whole column. **/
+  DepthType
+  GetDepth(SizeValueType column, const PeakDetectorType &detector) const;
+
+  /** Binary serialisation, Read() throwing on a stream that is not a valid index. **/
+  void
+  Write(std::ostream &) const;
+  void
+  Read(std::istream &);
+
+protected:
+  DepthMapPeakIndex();
+  ~DepthMapPeakIndex() override = default;
+
+  void
+  PrintSelf(std::ostream &os, Indent indent) const override;
+
+  /** Candidate of a column, and running state of its turning point search. **/
+  struct Candidate
+  {
+    CandidateDepthType depth;
+    ValueType value;
+  };
+  struct ColumnState
+  {
+    ValueType previous = 0;
+    CandidateDepthType plateau = 0;
+    int trend = 0;
+  };
+
+  /** Next value of a column, in increasing depth order from depth 0. **/
+  static void
+  PushValue(ColumnState &, std::vector<Candidate> &, ValueType, CandidateDepthType);
+
+  /** Last candidate of a column, once all its values are pushed. **/
+  static void
+  FinishColumn(const ColumnState &, std::vector<Candidate> &);
+
+  /** Drop the nested maximum and minimum pairs within the tolerance. **/
+  static void
+  PruneColumn(std::vector<Candidate> &, float);
+
+  /** Index a region of the plane, appending its columns and their candidates. **/
+  void
+  BuildRegion(const InputImageType *, const RegionType &, const PlaneOperatorType *, std::vector<SizeValueType> &,
+              std::vector<Candidate> &, std::vector<SizeValueType> &) const;
+
+  /** Header of the binary stream, and its fixed size fields. **/
+  static constexpr size_t MagicSize = 8;
+  static const char *
+  GetMagic()
+  {
+    return "DMPKIDX1";
+  }
+  template <typename T>
+  static void
+  WriteValue(std::ostream &os, const T &value)
+  {
+    os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+  template <typename T>
+  static void
+  ReadValue(std::istream &is, T &value)
+  {
+    is.read(reinterpret_cast<char *>(&value), sizeof(T));
+  }
+
+private:
+  RegionType m_Region;
+  SpacingType m_Spacing;
+  PointType m_Origin;
+  DirectionType m_Direction;
+  unsigned int m_ProjectionDimension;
+  float m_MinimumTolerance;
+
+  /** Candidates of column c at [m_Offsets[c], m_Offsets[c + 1]). **/
+  std::vector<uint64_t> m_Offsets;
+  std::vector<CandidateDepthType> m_Depths;
+  std::vector<ValueType> m_Values;
+};
+
+} // namespace itk
+
+#ifndef ITK_MANUAL_INSTANTIATION
+#include "itkDepthMapPeakIndex.hxx"
+#endif
+
+#endif // __itkDepthMapPeakIndex_h
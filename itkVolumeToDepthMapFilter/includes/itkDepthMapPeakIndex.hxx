@@ -0,0 +1,413 @@
+#ifndef __itkDepthMapPeakIndex_hxx
+#define __itkDepthMapPeakIndex_hxx
+
+#include "itkDepthMapPeakIndex.h"
+
+#include <cstring>
+#include <functional>
+
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
+#include "itkMultiThreaderBase.h"
+
+namespace itk
+{
+
+template <class TInputImage>
+DepthMapPeakIndex<TInputImage>
+::DepthMapPeakIndex()
+{
+  m_Spacing.Fill(1);
+  m_Origin.Fill(0);
+  m_Direction.SetIdentity();
+  m_ProjectionDimension = ImageDimension - 1;
+  m_MinimumTolerance = 0;
+}
+
+template <class TInputImage>
+void
+DepthMapPeakIndex<TInputImage>
+::PushValue(ColumnState &state, std::vector<Candidate> &candidates, ValueType value, CandidateDepthType depth)
+{
+  if (depth == 0)
+    {
+    candidates.push_back({0, value});
+    state.previous = value;
+    state.plateau = 0;
+    state.trend = 0;
+    return;
+    }
+  if (value == state.previous)
+    {
+    return;
+    }
+
+  // The plateau before a change of direction is a turning point.
+  const int trend = value > state.previous ? 1 : -1;
+  if (state.trend != 0 && trend != state.trend)
+    {
+    candidates.push_back({state.plateau, state.previous});
+    }
+  state.trend = trend;
+  state.plateau = depth;
+  state.previous = value;
+}
+
+template <class TInputImage>
+void
+DepthMapPeakIndex<TInputImage>
+::FinishColumn(const ColumnState &state, std::vector<Candidate> &candidates)
+{
+  if (candidates.back().depth != state.plateau)
+    {
+    candidates.push_back({state.plateau, state.previous});
+    }
+}
+
+template <class TInputImage>
+void
+DepthMapPeakIndex<TInputImage>
+::PruneColumn(std::vector<Candidate> &candidates, float tolerance)
+{
+  if (tolerance <= 0)
+    {
+    return;
+    }
+
+  // Candidates alternate between maxima and minima. A pair b, c between a and d
+  // is dropped when |b - c| <= tolerance and b, c lie strictly within a, d: the
+  // drop from b to c can not confirm a peak, the rise from c to d sets a new
+  // extremum as b would, and b is not the maximum value.
+  size_t n = 0;
+  for (size_t i = 0; i < candidates.size(); i++)
+    {
+    const Candidate candidate = candidates[i];
+    candidates[n++] = candidate;
+    while (n >= 4)
+      {
+      const ValueType a = candidates[n - 4].value;
+      const ValueType b = candidates[n - 3].value;
+      const ValueType c = candidates[n - 2].value;
+      const ValueType d = candidates[n - 1].value;
+      const bool nested = (b > c) ? (b - c <= tolerance && b < d && c > a) : (c - b <= tolerance && b > d && c < a);
+      if (!nested)
+        {
+        break;
+        }
+      candidates[n - 3] = candidates[n - 1];
+      n -= 2;
+      }
+    }
+  candidates.resize(n);
+}
+
+template <class TInputImage>
+void
+DepthMapPeakIndex<TInputImage>
+::BuildRegion(const InputImageType *volume, const RegionType &region, const PlaneOperatorType *planeOperator,
+              std::vector<SizeValueType> &columns, std::vector<Candidate> &candidates,
+              std::vector<SizeValueType> &numberOfCandidates) const
+{
+  // The region is swept by chunks of rows, bounding the candidate lists held.
+  const SizeValueType maximumChunkColumns = 16384;
+  unsigned int split = 0;
+  for (unsigned int i = 0; i < ImageDimension; i++)
+    {
+    if (i != m_ProjectionDimension)
+      {
+      split = i;
+      }
+    }
+  const SizeValueType sliceColumns = std::max<SizeValueType>(region.GetNumberOfPixels() / region.GetSize()[split], 1);
+  const SizeValueType chunkRows = std::max<SizeValueType>(maximumChunkColumns / sliceColumns, 1);
+  const SizeValueType projectionSize = m_Region.GetSize()[m_ProjectionDimension];
+  typename PlaneOperatorType::WorkspaceType workspace;
+
+  for (SizeValueType row = 0; row < region.GetSize()[split]; row += chunkRows)
+    {
+    RegionType chunk = region;
+    chunk.SetIndex(split, region.GetIndex()[split] + row);
+    chunk.SetSize(split, std::min(chunkRows, region.GetSize()[split] - row));
+    const SizeValueType numberOfColumns = chunk.GetNumberOfPixels();
+
+    // Column of each pixel of the chunk, in its memory order.
+    std::vector<SizeValueType> chunkColumns(numberOfColumns);
+    ImageRegionConstIteratorWithIndex<InputImageType> chunkIte(volume, chunk);
+    for (SizeValueType p = 0; !chunkIte.IsAtEnd(); ++chunkIte, ++p)
+      {
+      chunkColumns[p] = this->GetColumn(chunkIte.GetIndex());
+      }
+
+    // Turning points of each column, plane by plane.
+    std::vector<ColumnState> state(numberOfColumns);
+    std::vector<std::vector<Candidate>> chunkCandidates(numberOfColumns);
+    std::vector<ValueType> values(numberOfColumns);
+    for (SizeValueType depth = 0; depth < projectionSize; depth++)
+      {
+      chunk.SetIndex(m_ProjectionDimension, m_Region.GetIndex()[m_ProjectionDimension] + depth);
+      if (planeOperator != nullptr)
+        {
+        planeOperator->Apply(volume, chunk, m_ProjectionDimension, values.data(), workspace);
+        }
+      else
+        {
+        ImageRegionConstIterator<InputImageType> planeIte(volume, chunk);
+        for (SizeValueType p = 0; !planeIte.IsAtEnd(); ++planeIte, ++p)
+          {
+          values[p] = static_cast<ValueType>(planeIte.Get());
+          }
+        }
+      for (SizeValueType p = 0; p < numberOfColumns; p++)
+        {
+        PushValue(state[p], chunkCandidates[p], values[p], static_cast<CandidateDepthType>(depth));
+        }
+      }
+
+    for (SizeValueType p = 0; p < numberOfColumns; p++)
+      {
+      FinishColumn(state[p], chunkCandidates[p]);
+      PruneColumn(chunkCandidates[p], m_MinimumTolerance);
+      columns.push_back(chunkColumns[p]);
+      numberOfCandidates[chunkColumns[p]] = chunkCandidates[p].size();
+      candidates.insert(candidates.end(), chunkCandidates[p].begin(), chunkCandidates[p].end());
+      }
+    }
+}
+
+template <class TInputImage>
+void
+DepthMapPeakIndex<TInputImage>
+::Build(const InputImageType *volume, unsigned int projectionDimension, const PlaneOperatorType *planeOperator,
+        unsigned int numberOfWorkUnits)
+{
+  if (projectionDimension >= ImageDimension)
+    {
+    itkExceptionMacro(<< "Invalid ProjectionDimension " << projectionDimension << " but ImageDimension is "
+                      << ImageDimension);
+    }
+  const RegionType region = volume->GetLargestPossibleRegion();
+  if (!volume->GetBufferedRegion().IsInside(region))
+    {
+    itkExceptionMacro(<< "The volume must be buffered on its largest possible region " << region);
+    }
+  if (region.GetSize()[projectionDimension] == 0 ||
+      region.GetSize()[projectionDimension] > static_cast<SizeValueType>(NumericTraits<CandidateDepthType>::max()) + 1)
+    {
+    itkExceptionMacro(<< "Projection size " << region.GetSize()[projectionDimension] << " is out of the index depths.");
+    }
+  m_Region = region;
+  m_Spacing = volume->GetSpacing();
+  m_Origin = volume->GetOrigin();
+  m_Direction = volume->GetDirection();
+  m_ProjectionDimension = projectionDimension;
+
+  // Each piece of the plane is indexed by one work unit.
+  RegionType planeRegion = region;
+  planeRegion.SetSize(m_ProjectionDimension, 1);
+  const SizeValueType numberOfColumns = planeRegion.GetNumberOfPixels();
+  std::vector<SizeValueType> numberOfCandidates(numberOfColumns, 0);
+  struct Piece
+  {
+    std::vector<SizeValueType> columns;
+    std::vector<Candidate> candidates;
+  };
+  std::vector<Piece> pieces;
+  std::mutex piecesMutex;
+  MultiThreaderBase::Pointer threader = MultiThreaderBase::New();
+  threader->SetNumberOfWorkUnits(std::max(numberOfWorkUnits, 1u));
+  threader->ParallelizeImageRegion<ImageDimension>(
+    planeRegion,
+    [&](const RegionType &pieceRegion) {
+      Piece piece;
+      this->BuildRegion(volume, pieceRegion, planeOperator, piece.columns, piece.candidates, numberOfCandidates);
+      std::lock_guard<std::mutex> lock(piecesMutex);
+      pieces.push_back(std::move(piece));
+    },
+    nullptr);
+
+  // Flat arrays, in column order.
+  m_Offsets.assign(numberOfColumns + 1, 0);
+  for (SizeValueType c = 0; c < numberOfColumns; c++)
+    {
+    m_Offsets[c + 1] = m_Offsets[c] + numberOfCandidates[c];
+    }
+  m_Depths.resize(m_Offsets.back());
+  m_Values.resize(m_Offsets.back());
+  for (const Piece &piece : pieces)
+    {
+    SizeValueType k = 0;
+    for (SizeValueType column : piece.columns)
+      {
+      for (uint64_t offset = m_Offsets[column]; offset < m_Offsets[column + 1]; offset++, k++)
+        {
+        m_Depths[offset] = piece.candidates[k].depth;
+        m_Values[offset] = piece.candidates[k].value;
+        }
+      }
+    }
+  this->Modified();
+}
+
+template <class TInputImage>
+typename TInputImage::Pointer
+DepthMapPeakIndex<TInputImage>
+::CreateVolumeInformation() const
+{
+  InputImagePointer volume = InputImageType::New();
+  volume->SetRegions(m_Region);
+  volume->SetSpacing(m_Spacing);
+  volume->SetOrigin(m_Origin);
+  volume->SetDirection(m_Direction);
+  return volume;
+}
+
+template <class TInputImage>
+typename DepthMapPeakIndex<TInputImage>::DepthType
+DepthMapPeakIndex<TInputImage>
+::GetDepth(SizeValueType column, const PeakDetectorType &detector) const
+{
+  // Replay the candidates of the column, from its first value at depth 0, and its
+  // last value at the last depth, as the final plateau of the voxels.
+  const DepthType lastDepth = static_cast<DepthType>(m_Region.GetSize()[m_ProjectionDimension]) - 1;
+  const SizeValueType begin = m_Offsets[column];
+  const SizeValueType end = m_Offsets[column + 1];
+  typename PeakDetectorType::State state;
+  for (SizeValueType k = begin; k < end; k++)
+    {
+    if (!detector.Push(state, m_Values[k], m_Depths[k]))
+      {
+      return detector.GetDepth(state);
+      }
+    }
+  if (end > begin && m_Depths[end - 1] < lastDepth)
+    {
+    detector.Push(state, m_Values[end - 1], lastDepth);
+    }
+  return detector.GetDepth(state);
+}
+
+template <class TInputImage>
+void
+DepthMapPeakIndex<TInputImage>
+::Write(std::ostream &os) const
+{
+  os.write(Self::GetMagic(), MagicSize);
+  WriteValue(os, static_cast<uint32_t>(ImageDimension));
+  WriteValue(os, static_cast<uint32_t>(m_ProjectionDimension));
+  for (unsigned int i = 0; i < ImageDimension; i++)
+    {
+    WriteValue(os, static_cast<int64_t>(m_Region.GetIndex()[i]));
+    WriteValue(os, static_cast<uint64_t>(m_Region.GetSize()[i]));
+    WriteValue(os, static_cast<double>(m_Spacing[i]));
+    WriteValue(os, static_cast<double>(m_Origin[i]));
+    for (unsigned int j = 0; j < ImageDimension; j++)
+      {
+      WriteValue(os, static_cast<double>(m_Direction[i][j]));
+      }
+    }
+  WriteValue(os, m_MinimumTolerance);
+  WriteValue(os, static_cast<uint64_t>(m_Depths.size()));
+  os.write(reinterpret_cast<const char *>(m_Offsets.data()), m_Offsets.size() * sizeof(uint64_t));
+  os.write(reinterpret_cast<const char *>(m_Depths.data()), m_Depths.size() * sizeof(CandidateDepthType));
+  os.write(reinterpret_cast<const char *>(m_Values.data()), m_Values.size() * sizeof(ValueType));
+}
+
+template <class TInputImage>
+void
+DepthMapPeakIndex<TInputImage>
+::Read(std::istream &is)
+{
+  char magic[MagicSize];
+  uint32_t dimension = 0;
+  uint32_t projectionDimension = 0;
+  is.read(magic, sizeof(magic));
+  ReadValue(is, dimension);
+  ReadValue(is, projectionDimension);
+  if (!is || std::memcmp(magic, Self::GetMagic(), MagicSize) != 0 || dimension != ImageDimension ||
+      projectionDimension >= ImageDimension)
+    {
+    itkExceptionMacro(<< "The stream is not a peak index of dimension " << ImageDimension);
+    }
+
+  IndexType index;
+  SizeType size;
+  for (unsigned int i = 0; i < ImageDimension; i++)
+    {
+    int64_t indexValue = 0;
+    uint64_t sizeValue = 0;
+    double spacing = 0;
+    double origin = 0;
+    ReadValue(is, indexValue);
+    ReadValue(is, sizeValue);
+    ReadValue(is, spacing);
+    ReadValue(is, origin);
+    index[i] = indexValue;
+    size[i] = sizeValue;
+    m_Spacing[i] = spacing;
+    m_Origin[i] = origin;
+    for (unsigned int j = 0; j < ImageDimension; j++)
+      {
+      double direction = 0;
+      ReadValue(is, direction);
+      m_Direction[i][j] = direction;
+      }
+    }
+  m_Region.SetIndex(index);
+  m_Region.SetSize(size);
+  m_ProjectionDimension = projectionDimension;
+  uint64_t numberOfCandidates = 0;
+  ReadValue(is, m_MinimumTolerance);
+  ReadValue(is, numberOfCandidates);
+
+  const SizeValueType projectionSize = size[m_ProjectionDimension];
+  if (!is || projectionSize == 0 ||
+      projectionSize > static_cast<SizeValueType>(NumericTraits<CandidateDepthType>::max()) + 1)
+    {
+    itkExceptionMacro(<< "Truncated or corrupted peak index.");
+    }
+
+  // Candidates of each column in increasing offsets, at depths within the columns.
+  RegionType planeRegion = m_Region;
+  planeRegion.SetSize(m_ProjectionDimension, 1);
+  m_Offsets.resize(planeRegion.GetNumberOfPixels() + 1);
+  is.read(reinterpret_cast<char *>(m_Offsets.data()), m_Offsets.size() * sizeof(uint64_t));
+  if (!is || m_Offsets.front() != 0 || m_Offsets.back() != numberOfCandidates ||
+      std::adjacent_find(m_Offsets.begin(), m_Offsets.end(), std::greater<uint64_t>()) != m_Offsets.end())
+    {
+    itkExceptionMacro(<< "Truncated or corrupted peak index.");
+    }
+  m_Depths.resize(numberOfCandidates);
+  m_Values.resize(numberOfCandidates);
+  is.read(reinterpret_cast<char *>(m_Depths.data()), m_Depths.size() * sizeof(CandidateDepthType));
+  is.read(reinterpret_cast<char *>(m_Values.data()), m_Values.size() * sizeof(ValueType));
+  if (!is)
+    {
+    itkExceptionMacro(<< "Truncated peak index.");
+    }
+  for (CandidateDepthType depth : m_Depths)
+    {
+    if (depth >= projectionSize)
+      {
+      itkExceptionMacro(<< "Corrupted peak index, candidate depth " << depth << " is beyond the projection size "
+                        << projectionSize);
+      }
+    }
+  this->Modified();
+}
+
+template <class TInputImage>
+void
+DepthMapPeakIndex<TInputImage>
+::PrintSelf(std::ostream &os, Indent indent) const
+{
+  Superclass::PrintSelf(os, indent);
+  os << indent << "Region: " << m_Region << std::endl;
+  os << indent << "ProjectionDimension: " << m_ProjectionDimension << std::endl;
+  os << indent << "MinimumTolerance: " << m_MinimumTolerance << std::endl;
+  os << indent << "NumberOfColumns: " << this->GetNumberOfColumns() << std::endl;
+  os << indent << "NumberOfCandidates: " << this->GetNumberOfCandidates() << std::endl;
+}
+
+} // namespace itk
+
+#endif // __itkDepthMapPeakIndex_hxx
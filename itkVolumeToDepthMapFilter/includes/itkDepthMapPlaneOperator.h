@@ -0,0 +1,69 @@
+#ifndef __itkDepthMapPlaneOperator_h
+#define __itkDepthMapPlaneOperator_h
+
+#include <vector>
+
+#include "itkObject.h"
+#include "itkObjectFactory.h"
+
+namespace itk
+{
+
+/** \class DepthMapPlaneOperator
+ * \brief Preprocessing of a volume, plane by plane, during the depth search.
+ *
+ * The depth search of VolumeToDepthMapFilter can run on a preprocessed volume,
+ * e.g. its local variance, without the preprocessed volume being allocated:
+ * the planes orthogonal to the projection dimension are transformed one at a
+ * time, as the search reads them. The value of a pixel can only depend on a
+ * neighbourhood of the pixel within its plane.
+ *
+ * A subclass gives the radius of the neighbourhood it reads, computes the
+ * values of a region of one plane, and gives the operator to use on the
+ * volume shrunk by a level of a multiscale pyramid. The operator is shared by
+ * the threads, each one giving its own workspace, reused from plane to plane.
+ *
+ * \author Stephane U. Rigaud (stephane.rigaud@pasteur.fr)
+ */
+template <class TInputImage>
+class DepthMapPlaneOperator : public Object
+{
+public:
+  ITK_DISALLOW_COPY_AND_ASSIGN(DepthMapPlaneOperator);
+
+  /** Standard class typedefs. **/
+  using Self = DepthMapPlaneOperator;
+  using Superclass = Object;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  /** Run-time type information (and related methods). **/
+  itkTypeMacro(DepthMapPlaneOperator, Object);
+
+  using InputImageType = TInputImage;
+  using RegionType = typename InputImageType::RegionType;
+  using SizeType = typename InputImageType::SizeType;
+  using ValueType = float;
+  using WorkspaceType = std::vector<double>;
+
+  /** Radius of the neighbourhood read around each pixel, 0 along the projection dimension. **/
+  virtual SizeType GetNeighborhoodRadius(unsigned int projectionDimension) const = 0;
+
+  /** Values of the pixels of a region of one plane, in the memory order of the
+   * region. The input must be buffered on the region padded by the radius,
+   * within its largest possible region. The workspace is only grown, so that
+   * the planes of a region are computed without allocation. **/
+  virtual void Apply(const InputImageType *input, const RegionType &region, unsigned int projectionDimension,
+                     ValueType *values, WorkspaceType &workspace) const = 0;
+
+  /** Operator giving the same preprocessing on the volume shrunk by the given factors. **/
+  virtual Pointer Shrink(const SizeType &factors) const = 0;
+
+protected:
+  DepthMapPlaneOperator() = default;
+  ~DepthMapPlaneOperator() override = default;
+};
+
+} // namespace itk
+
+#endif // __itkDepthMapPlaneOperator_h
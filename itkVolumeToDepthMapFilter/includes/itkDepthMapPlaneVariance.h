@@ -0,0 +1,203 @@
+#ifndef __itkDepthMapPlaneVariance_h
+#define __itkDepthMapPlaneVariance_h
+
+#include <vector>
+#include <algorithm>
+
+#include "itkDepthMapPlaneOperator.h"
+#include "itkImageRegionConstIterator.h"
+
+namespace itk
+{
+
+/** \class DepthMapPlaneVariance
+ * \brief Local variance of each plane, computed during the depth search.
+ *
+ * Variance of the pixels of the plane in a box of radius m_Radius around each
+ * pixel, the radius along the projection dimension being ignored. Outside of
+ * the buffered region, the plane is extended with its edge values, as by
+ * VarianceImageFilter with a radius of 0 along the projection dimension.
+ *
+ * The sum and the sum of squares of the box are computed with running sums
+ * along each dimension of the plane, accumulated in double, so that the cost
+ * per pixel does not depend on the radius. Both sums and the line being summed
+ * are held in the workspace of the calling thread.
+ *
+ * \author Stephane U. Rigaud (stephane.rigaud@pasteur.fr)
+ */
+template <class TInputImage>
+class DepthMapPlaneVariance : public DepthMapPlaneOperator<TInputImage>
+{
+public:
+  ITK_DISALLOW_COPY_AND_ASSIGN(DepthMapPlaneVariance);
+
+  /** Standard class typedefs. **/
+  using Self = DepthMapPlaneVariance;
+  using Superclass = DepthMapPlaneOperator<TInputImage>;
+  using Pointer = SmartPointer<Self>;
+  using ConstPointer = SmartPointer<const Self>;
+
+  /** Method for creation through the object factory. **/
+  itkNewMacro(Self);
+
+  /** Run-time type information (and related methods). **/
+  itkTypeMacro(DepthMapPlaneVariance, DepthMapPlaneOperator);
+
+  static constexpr unsigned int ImageDimension = TInputImage::ImageDimension;
+
+  using InputImageType = typename Superclass::InputImageType;
+  using RegionType = typename Superclass::RegionType;
+  using SizeType = typename Superclass::SizeType;
+  using ValueType = typename Superclass::ValueType;
+  using WorkspaceType = typename Superclass::WorkspaceType;
+  using SuperclassPointer = typename Superclass::Pointer;
+
+  itkSetMacro(Radius, SizeType);
+  itkGetConstReferenceMacro(Radius, SizeType);
+
+  SizeType
+  GetNeighborhoodRadius(unsigned int projectionDimension) const override
+  {
+    SizeType radius = m_Radius;
+    radius[projectionDimension] = 0;
+    return radius;
+  }
+
+  void
+  Apply(const InputImageType *input, const RegionType &region, unsigned int projectionDimension,
+        ValueType *values, WorkspaceType &workspace) const override
+  {
+    // Plane around the region, within the buffer.
+    RegionType planeRegion = region;
+    planeRegion.PadByRadius(this->GetNeighborhoodRadius(projectionDimension));
+    planeRegion.Crop(input->GetBufferedRegion());
+    const SizeType planeSize = planeRegion.GetSize();
+
+    // Sum and sum of squares of the box around each pixel of the plane, followed
+    // by the line being summed.
+    const SizeValueType planePixels = planeRegion.GetNumberOfPixels();
+    SizeValueType maximumLength = 0;
+    for (unsigned int d = 0; d < ImageDimension; d++)
+      {
+      maximumLength = std::max(maximumLength, planeSize[d]);
+      }
+    if (workspace.size() < 2 * planePixels + maximumLength)
+      {
+      workspace.resize(2 * planePixels + maximumLength);
+      }
+    double *sum = workspace.data();
+    double *sumOfSquares = sum + planePixels;
+    double *line = sumOfSquares + planePixels;
+    ImageRegionConstIterator<InputImageType> inputIte(input, planeRegion);
+    for (SizeValueType i = 0; !inputIte.IsAtEnd(); ++inputIte, ++i)
+      {
+      const double value = static_cast<double>(inputIte.Get());
+      sum[i] = value;
+      sumOfSquares[i] = value * value;
+      }
+    double numberOfPixels = 1;
+    for (unsigned int d = 0; d < ImageDimension; d++)
+      {
+      if (d != projectionDimension)
+        {
+        this->BoxSum(sum, planeSize, d, line);
+        this->BoxSum(sumOfSquares, planeSize, d, line);
+        numberOfPixels *= 2 * m_Radius[d] + 1;
+        }
+      }
+
+    // Variance of the pixels of the region, in its memory order.
+    const SizeValueType numberOfValues = region.GetNumberOfPixels();
+    for (SizeValueType j = 0; j < numberOfValues; j++)
+      {
+      SizeValueType remainder = j;
+      SizeValueType offset = 0;
+      SizeValueType stride = 1;
+      for (unsigned int d = 0; d < ImageDimension; d++)
+        {
+        const SizeValueType position = remainder % region.GetSize(d);
+        remainder /= region.GetSize(d);
+        offset += (region.GetIndex(d) + position - planeRegion.GetIndex(d)) * stride;
+        stride *= planeSize[d];
+        }
+      const double mean = sum[offset] / numberOfPixels;
+      values[j] = static_cast<ValueType>(std::max(sumOfSquares[offset] / numberOfPixels - mean * mean, 0.0));
+      }
+  }
+
+  SuperclassPointer
+  Shrink(const SizeType &factors) const override
+  {
+    // Same box size in physical units, of at least one pixel of radius.
+    Pointer shrunk = Self::New();
+    SizeType radius;
+    for (unsigned int d = 0; d < ImageDimension; d++)
+      {
+      radius[d] = (m_Radius[d] + factors[d] / 2) / factors[d];
+      if (m_Radius[d] > 0 && radius[d] == 0)
+        {
+        radius[d] = 1;
+        }
+      }
+    shrunk->SetRadius(radius);
+    return shrunk.GetPointer();
+  }
+
+protected:
+  DepthMapPlaneVariance() { m_Radius.Fill(1); }
+  ~DepthMapPlaneVariance() override = default;
+
+  /** Box sum, in place, along dimension d of a buffer of the given size, the
+   * lines being extended with their edge values. The line holds one line of
+   * the buffer along d. **/
+  void
+  BoxSum(double *buffer, const SizeType &size, unsigned int d, double *line) const
+  {
+    const long radius = static_cast<long>(m_Radius[d]);
+    const long length = static_cast<long>(size[d]);
+    if (radius == 0 || length == 0)
+      {
+      return;
+      }
+    SizeValueType stride = 1;
+    SizeValueType numberOfLines = 1;
+    for (unsigned int j = 0; j < ImageDimension; j++)
+      {
+      if (j < d)
+        {
+        stride *= size[j];
+        }
+      if (j != d)
+        {
+        numberOfLines *= size[j];
+        }
+      }
+    for (SizeValueType l = 0; l < numberOfLines; l++)
+      {
+      const SizeValueType start = (l / stride) * stride * length + l % stride;
+      for (long i = 0; i < length; i++)
+        {
+        line[i] = buffer[start + i * stride];
+        }
+      auto value = [&](long i) { return line[std::min(std::max(i, 0L), length - 1)]; };
+      double boxSum = 0;
+      for (long i = -radius; i <= radius; i++)
+        {
+        boxSum += value(i);
+        }
+      buffer[start] = boxSum;
+      for (long i = 1; i < length; i++)
+        {
+        boxSum += value(i + radius) - value(i - radius - 1);
+        buffer[start + i * stride] = boxSum;
+        }
+      }
+  }
+
+private:
+  SizeType m_Radius;
+};
+
+} // namespace itk
+
+#endif // __itkDepthMapPlaneVariance_h
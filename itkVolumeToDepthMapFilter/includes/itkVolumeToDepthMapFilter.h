@@ -1,8 +1,13 @@
 #ifndef __itkVolumeToDepthMapFilter_h
 #define __itkVolumeToDepthMapFilter_h
 
+#include <atomic>
+
 #include "itkImageToImageFilter.h"
 #include "itkArray2D.h"
+#include "itkDepthMapPeakDetector.h"
+#include "itkDepthMapPeakIndex.h"
+#include "itkDepthMapPlaneOperator.h"
 
 namespace itk
 {
@@ -14,6 +19,53 @@ namespace itk
  * return the corresponding depth map of the signal in the volume.
  * An initialisation map can be provided to speed up and restrict the computation.
  *
+ * Two search engines are available (m_Engine):
+ * - column (value = 0) iterates each column along the projection dimension,
+ * - plane sweep (value = 1) streams the volume in memory order, plane by plane,
+ *   and keeps a running peak detection state for every column in flat arrays.
+ * Both engines produce the same depth map, using the single pass
+ * DepthMapPeakDetector, which stops a column as soon as its depth is known.
+ * With an initialisation map, the column engine only reads the band
+ * [init - m_Range[0], init + m_Range[1]] of each column, directly in the buffer.
+ * In maximum intensity mode (m_Peak = 0) without initialisation, the plane
+ * sweep engine updates whole rows of columns at once with SIMD instructions
+ * (see DepthMapArgMax).
+ *
+ * The initialisation map can be coarser than the output, as the depth map of
+ * the previous level of a multiscale pyramid. Each column then reads it at the
+ * matching position, pixel centres being aligned, with nearest neighbour
+ * (m_Interpolation = 0) or linear (value = 1, default) interpolation, so that
+ * no upsampled copy of the map is needed. The band is centred on the truncated
+ * depth, so that a map of the output size is read as before, pixel by pixel.
+ *
+ * A range map (m_RangeMap), of the grid of the initialisation map, can adapt
+ * the band column by column: each column is searched within the range map
+ * width on each side, narrower or wider than m_Range, the largest width of the
+ * range map pixels around the column being used. GetAverageBandWidth() returns the mean
+ * band width, in pixels, of the columns of the last update searched around an
+ * initialisation.
+ *
+ * A plane operator (m_PlaneOperator, see DepthMapPlaneOperator) can preprocess
+ * the volume, e.g. with its local variance (DepthMapPlaneVariance). The search
+ * then runs plane by plane, whatever the engine, each plane being transformed
+ * as it is read, so that no preprocessed volume is allocated. The input is
+ * requested with a margin of the operator radius around the output region.
+ *
+ * A peak index of the input (m_PeakIndex, see DepthMapPeakIndex) answers the
+ * search of the whole columns instead of the voxels, which are then not read:
+ * the input only gives the geometry and can be unallocated. Any peak mode and
+ * tolerance of at least the minimum tolerance of the index can be searched, e.g.
+ * to tune the peak parameters without reading the volume again. The plane
+ * operator is the one the index was built with, m_PlaneOperator is ignored.
+ * The index can not be used with an initialisation, as it does not hold the
+ * values at the ends of the bands.
+ *
+ * For a caller scheduling the work itself, BeginRegions() allocates the whole
+ * output without running the search, and GenerateRegion() then searches any
+ * output region, from any thread, the regions being disjoint. The input, and
+ * the initialisation and range maps, must be allocated beforehand, their
+ * pixels being read by GenerateRegion() only.
+ *
  * \author Stephane U. Rigaud (stephane.rigaud@pasteur.fr)
  */
 template <class TInputImage, class TOutputImage>
@@ -61,16 +113,29 @@ public:
   using OutputIndexValueType = typename OutputImageType::IndexValueType;
 
   using ArrayType = FixedArray<InputIndexValueType, 2>;
+  using PeakDetectorType = DepthMapPeakDetector<InputPixelType>;
+  using PeakStateType = typename PeakDetectorType::State;
+  using PlaneOperatorType = DepthMapPlaneOperator<InputImageType>;
+  using PlaneOperatorPointer = typename PlaneOperatorType::Pointer;
+  using PlaneValueType = typename PlaneOperatorType::ValueType;
+  using PlanePeakDetectorType = DepthMapPeakDetector<PlaneValueType>;
+  using PlanePeakStateType = typename PlanePeakDetectorType::State;
+  using PeakIndexType = DepthMapPeakIndex<InputImageType>;
+  using PeakIndexPointer = typename PeakIndexType::Pointer;
 
   itkSetMacro(ProjectionDimension, unsigned int);
   itkSetMacro(Range, ArrayType);
   itkSetMacro(Tolerance, float);
   itkSetMacro(Peak, unsigned int);
+  itkSetMacro(Engine, unsigned int);
+  itkSetMacro(Interpolation, unsigned int);
 
   itkGetConstReferenceMacro(ProjectionDimension, unsigned int);
   itkGetMacro(Range, ArrayType);
   itkGetMacro(Tolerance, float);
   itkGetMacro(Peak, unsigned int);
+  itkGetMacro(Engine, unsigned int);
+  itkGetMacro(Interpolation, unsigned int);
 
   // itkSetInputMacro(Input, InputImageType);
   // itkGetInputMacro(Input, InputImageType);
@@ -80,6 +145,21 @@ public:
   itkSetMacro(Initialisation, OutputImagePointer);
   itkGetMacro(Initialisation, OutputImagePointer);
 
+  itkSetMacro(RangeMap, OutputImagePointer);
+  itkGetMacro(RangeMap, OutputImagePointer);
+
+  double GetAverageBandWidth() const;
+
+  /** Region by region update, see the class documentation. **/
+  void BeginRegions();
+  void GenerateRegion(const OutputRegionType &);
+
+  itkSetMacro(PlaneOperator, PlaneOperatorPointer);
+  itkGetMacro(PlaneOperator, PlaneOperatorPointer);
+
+  itkSetMacro(PeakIndex, PeakIndexPointer);
+  itkGetMacro(PeakIndex, PeakIndexPointer);
+
 #ifdef ITK_USE_CONCEPT_CHECKING
   // Begin concept checking
   itkConceptMacro(ImageDimensionCheck, (Concept::SameDimensionOrMinusOne<
@@ -97,17 +177,38 @@ protected:
   void GenerateInputRequestedRegion() override;
 
   /** Does the real work. **/
+  void BeforeThreadedGenerateData() override;
   void DynamicThreadedGenerateData(const OutputRegionType &) override;
 
+  /** Search engines, called by DynamicThreadedGenerateData. **/
+  void ColumnGenerateData(const OutputRegionType &);
+  void BandGenerateData(const OutputRegionType &);
+  void ArgMaxGenerateData(const OutputRegionType &);
+  void PlaneSweepGenerateData(const OutputRegionType &);
+  void PlaneOperatorGenerateData(const OutputRegionType &);
+  void IndexGenerateData(const OutputRegionType &);
+
   /** Internal methods. **/
   InputIndexValueType GetPeak(std::vector<InputPixelType> &, std::vector<InputIndexValueType> &);
+  InputRegionType GetInputRegionForThread(const OutputRegionType &) const;
+  void GetInitialisationBand(const OutputRegionType &, std::vector<InputIndexValueType> &,
+                             std::vector<InputIndexValueType> &) const;
 
 private:
   float m_Tolerance;
   ArrayType m_Range;
   unsigned int m_Peak;
+  unsigned int m_Engine;
+  unsigned int m_Interpolation;
   unsigned int m_ProjectionDimension;
   OutputImagePointer m_Initialisation;
+  OutputImagePointer m_RangeMap;
+  PlaneOperatorPointer m_PlaneOperator;
+  PeakIndexPointer m_PeakIndex;
+
+  /** Band statistics, accumulated by the threads. */
+  mutable std::atomic<SizeValueType> m_NumberOfBandPixels;
+  mutable std::atomic<SizeValueType> m_NumberOfBandColumns;
 };
 
 } // namespace itk
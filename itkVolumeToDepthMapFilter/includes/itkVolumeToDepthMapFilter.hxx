@@ -3,11 +3,18 @@
 
 #include "itkVolumeToDepthMapFilter.h"
 
+#include <cmath>
 #include <vector>
 #include <algorithm>
 
 #include "itkImageLinearConstIteratorWithIndex.h"
+#include "itkImageScanlineConstIterator.h"
+#include "itkImageRegionIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkImageRegionConstIteratorWithIndex.h"
 #include "itkProgressReporter.h"
+#include "itkDepthMapArgMax.h"
+#include "itkDepthMapPeakDetector.h"
 
 namespace itk
 {
@@ -17,10 +24,17 @@ VolumeToDepthMapFilter<TInputImage, TOutputImage>
 ::VolumeToDepthMapFilter()
 {
   m_Initialisation = nullptr;
+  m_RangeMap = nullptr;
+  m_PlaneOperator = nullptr;
+  m_PeakIndex = nullptr;
+  m_NumberOfBandPixels = 0;
+  m_NumberOfBandColumns = 0;
   m_ProjectionDimension = InputImageDimension - 1;
   m_Range.Fill(0);
   m_Tolerance = 0.0;
   m_Peak = 0;
+  m_Engine = 0;
+  m_Interpolation = 1;
 }
 
 template <class TInputImage, class TOutputImage>
@@ -168,6 +182,14 @@ VolumeToDepthMapFilter<TInputImage, TOutputImage>
     InputRegionType RequestedRegion;
     RequestedRegion.SetSize(inputSize);
     RequestedRegion.SetIndex(inputIndex);
+
+    // The plane operator reads a neighbourhood of each pixel within its plane.
+    if (m_PlaneOperator.IsNotNull())
+      {
+      RequestedRegion.PadByRadius(m_PlaneOperator->GetNeighborhoodRadius(m_ProjectionDimension));
+      RequestedRegion.Crop(this->GetInput()->GetLargestPossibleRegion());
+      }
+
     InputImagePointer input = const_cast<InputImageType *>(this->GetInput());
     input->SetRequestedRegion(RequestedRegion);
     }
@@ -178,63 +200,226 @@ typename TInputImage::IndexValueType
 VolumeToDepthMapFilter<TInputImage, TOutputImage>
 ::GetPeak(std::vector<typename TInputImage::PixelType> &A, std::vector<typename TInputImage::IndexValueType> &B)
 {
-  InputIndexValueType result = -1;
-  if (m_Peak > 0)
-    {
-    int mx_pos = 0;
-    int mn_pos = 0;
-    float mx = A[0];
-    float mn = A[0];
-    bool emi_first = true;
-    std::vector<InputIndexValueType> peakList;
-    std::vector<InputIndexValueType> negPeakList;
-    for (size_t i = 1; i < A.size(); i++)
+  PeakDetectorType detector(m_Peak, m_Tolerance);
+  PeakStateType state;
+  for (size_t i = 0; i < A.size(); i++)
+    {
+    if (!detector.Push(state, A[i], i))
+      {
+      break;
+      }
+    }
+  return B[detector.GetDepth(state)];
+}
+
+template <class TInputImage, class TOutputImage>
+typename TInputImage::RegionType
+VolumeToDepthMapFilter<TInputImage, TOutputImage>
+::GetInputRegionForThread(const OutputRegionType &outputRegionForThread) const
+{
+  InputRegionType inputRegion = this->GetInput()->GetLargestPossibleRegion();
+  InputSizeType inputSize = inputRegion.GetSize();
+  InputIndexType inputIndex = inputRegion.GetIndex();
+  OutputSizeType outputSizeForThread = outputRegionForThread.GetSize();
+  OutputIndexType outputIndexForThread = outputRegionForThread.GetIndex();
+
+  // Compute the input region for this thread.
+  InputRegionType inputRegionForThread = inputRegion;
+  InputSizeType inputSizeForThread = inputSize;
+  InputIndexType inputIndexForThread = inputIndex;
+  if (static_cast<unsigned int>(InputImageDimension) == static_cast<unsigned int>(OutputImageDimension))
+    {
+    for (size_t i = 0; i < InputImageDimension; i++)
       {
-      if (A[i] > mx)
+      if (i != m_ProjectionDimension)
         {
-        mx_pos = i;
-        mx = A[i];
+        inputSizeForThread[i] = outputSizeForThread[i];
+        inputIndexForThread[i] = outputIndexForThread[i];
         }
-      if (A[i] < mn)
+      }
+    }
+  else
+    {
+    for (size_t i = 0; i < OutputImageDimension; i++)
+      {
+      if (i != m_ProjectionDimension)
         {
-        mn_pos = i;
-        mn = A[i];
+        inputSizeForThread[i] = outputSizeForThread[i];
+        inputIndexForThread[i] = outputIndexForThread[i];
         }
-      if (emi_first && A[i] < mx - m_Tolerance)
+      else
         {
-        peakList.push_back(mx_pos);
-        emi_first = false;
-        i = mx_pos - 1;
-        mn = A[mx_pos];
-        mn_pos = mx_pos;
+        inputSizeForThread[InputImageDimension - 1] = outputSizeForThread[i];
+        inputIndexForThread[InputImageDimension - 1] = outputIndexForThread[i];
         }
-      else if ((!emi_first) && A[i] > mn + m_Tolerance)
+      }
+      inputSizeForThread[m_ProjectionDimension] = inputSize[m_ProjectionDimension];
+      inputIndexForThread[m_ProjectionDimension] = inputIndex[m_ProjectionDimension];
+    }
+  inputRegionForThread.SetSize(inputSizeForThread);
+  inputRegionForThread.SetIndex(inputIndexForThread);
+  return inputRegionForThread;
+}
+
+template <class TInputImage, class TOutputImage>
+void
+VolumeToDepthMapFilter<TInputImage, TOutputImage>
+::GetInitialisationBand(const OutputRegionType &outputRegionForThread,
+                        std::vector<InputIndexValueType> &highDepth,
+                        std::vector<InputIndexValueType> &lowDepth) const
+{
+  const InputIndexValueType projectionSize = this->GetInput()->GetLargestPossibleRegion().GetSize()[m_ProjectionDimension];
+  const OutputRegionType outputRegion = this->GetOutput()->GetLargestPossibleRegion();
+  const OutputRegionType initialisationRegion = m_Initialisation->GetBufferedRegion();
+  const OutputPixelType *buffer = m_Initialisation->GetBufferPointer();
+  const OutputPixelType *rangeBuffer = m_RangeMap.IsNotNull() ? m_RangeMap->GetBufferPointer() : nullptr;
+  const OffsetValueType *offsetTable = m_Initialisation->GetOffsetTable();
+
+  // Position of each output row in the initialisation map, for each dimension,
+  // as the buffer offsets of the two neighbours and the weight of the second one.
+  std::vector<OffsetValueType> lowerOffset[OutputImageDimension];
+  std::vector<OffsetValueType> upperOffset[OutputImageDimension];
+  std::vector<double> weight[OutputImageDimension];
+  for (size_t i = 0; i < OutputImageDimension; i++)
+    {
+    const SizeValueType size = outputRegionForThread.GetSize()[i];
+    const SizeValueType initialisationSize = initialisationRegion.GetSize()[i];
+    const double scale = static_cast<double>(initialisationSize) / outputRegion.GetSize()[i];
+    lowerOffset[i].resize(size);
+    upperOffset[i].resize(size);
+    weight[i].resize(size);
+    for (SizeValueType k = 0; k < size; k++)
+      {
+      const OffsetValueType index = outputRegionForThread.GetIndex()[i] - outputRegion.GetIndex()[i] + static_cast<OffsetValueType>(k);
+      double position = (index + 0.5) * scale - 0.5;
+      position = std::min(std::max(position, 0.0), static_cast<double>(initialisationSize - 1));
+      if (m_Interpolation == 0)
         {
-        negPeakList.push_back(mn_pos);
-        emi_first = true;
-        i = mn_pos - 1;
-        mx = A[mn_pos];
-        mx_pos = mn_pos;
+        position = std::floor(position + 0.5);
         }
+      const OffsetValueType lower = static_cast<OffsetValueType>(std::floor(position));
+      const OffsetValueType upper = std::min<OffsetValueType>(lower + 1, initialisationSize - 1);
+      lowerOffset[i][k] = lower * offsetTable[i];
+      upperOffset[i][k] = upper * offsetTable[i];
+      weight[i][k] = position - lower;
       }
-      if (!peakList.empty())
+    }
+
+  // Interpolate the previous depth of each column from the corners around it.
+  const SizeValueType numberOfColumns = outputRegionForThread.GetNumberOfPixels();
+  highDepth.resize(numberOfColumns);
+  lowDepth.resize(numberOfColumns);
+  OffsetValueType k[OutputImageDimension] = {0};
+  SizeValueType numberOfBandPixels = 0;
+  for (SizeValueType c = 0; c < numberOfColumns; c++)
+    {
+    double previousDepth = 0;
+    double width = 0;
+    for (unsigned int corner = 0; corner < (1u << OutputImageDimension); corner++)
+      {
+      double cornerWeight = 1;
+      OffsetValueType offset = 0;
+      for (size_t i = 0; i < OutputImageDimension && cornerWeight > 0; i++)
         {
-        if (m_Peak == 1)
-          {
-          result = B[peakList.front()];
-          }
-        else if (m_Peak == 2)
+        const bool upper = (corner >> i) & 1;
+        cornerWeight *= upper ? weight[i][k[i]] : 1 - weight[i][k[i]];
+        offset += upper ? upperOffset[i][k[i]] : lowerOffset[i][k[i]];
+        }
+      if (cornerWeight > 0)
+        {
+        previousDepth += cornerWeight * buffer[offset];
+        if (rangeBuffer != nullptr)
           {
-          result = B[peakList.back()];
+          width = std::max(width, static_cast<double>(rangeBuffer[offset]));
           }
         }
+      }
+    InputIndexValueType highRange = m_Range[0];
+    InputIndexValueType lowRange = m_Range[1];
+    if (rangeBuffer != nullptr)
+      {
+      highRange = static_cast<InputIndexValueType>(std::ceil(width));
+      lowRange = highRange;
+      }
+    const InputIndexValueType depth = static_cast<InputIndexValueType>(previousDepth);
+    highDepth[c] = std::min<InputIndexValueType>(std::max<InputIndexValueType>(depth - highRange, 0), projectionSize - 1);
+    lowDepth[c] = std::min<InputIndexValueType>(std::max<InputIndexValueType>(depth + lowRange, 0), projectionSize - 1);
+    numberOfBandPixels += lowDepth[c] - highDepth[c] + 1;
+
+    // Next column, in the memory order of the output region.
+    for (size_t i = 0; i < OutputImageDimension; i++)
+      {
+      if (++k[i] < static_cast<OffsetValueType>(outputRegionForThread.GetSize()[i]))
+        {
+        break;
+        }
+      k[i] = 0;
+      }
     }
-  if (m_Peak == 0 || result == -1)
+  m_NumberOfBandPixels += numberOfBandPixels;
+  m_NumberOfBandColumns += numberOfColumns;
+}
+
+template <class TInputImage, class TOutputImage>
+double
+VolumeToDepthMapFilter<TInputImage, TOutputImage>
+::GetAverageBandWidth() const
+{
+  const SizeValueType numberOfColumns = m_NumberOfBandColumns;
+  return numberOfColumns > 0 ? static_cast<double>(m_NumberOfBandPixels) / numberOfColumns : 0.0;
+}
+
+template <class TInputImage, class TOutputImage>
+void
+VolumeToDepthMapFilter<TInputImage, TOutputImage>
+::BeforeThreadedGenerateData()
+{
+  if (m_RangeMap.IsNotNull() &&
+      (m_Initialisation.IsNull() || m_RangeMap->GetBufferedRegion() != m_Initialisation->GetBufferedRegion()))
     {
-    auto ite = std::max_element(A.begin(), A.end());
-    result = B[ite - A.begin()];
+    itkExceptionMacro(<< "RangeMap must have the buffered region of the Initialisation map.");
     }
-  return result;
+  if (m_PeakIndex.IsNotNull())
+    {
+    if (m_Initialisation.IsNotNull())
+      {
+      itkExceptionMacro(<< "PeakIndex only answers the search of whole columns, without Initialisation.");
+      }
+    if (m_PeakIndex->GetRegion() != this->GetInput()->GetLargestPossibleRegion() ||
+        m_PeakIndex->GetProjectionDimension() != m_ProjectionDimension)
+      {
+      itkExceptionMacro(<< "PeakIndex must index the input region " << this->GetInput()->GetLargestPossibleRegion()
+                        << " along the ProjectionDimension.");
+      }
+    if ((m_Peak == 1 || m_Peak == 2) && m_Tolerance < m_PeakIndex->GetMinimumTolerance())
+      {
+      itkExceptionMacro(<< "Tolerance " << m_Tolerance << " is below the MinimumTolerance "
+                        << m_PeakIndex->GetMinimumTolerance() << " of the PeakIndex.");
+      }
+    }
+  m_NumberOfBandPixels = 0;
+  m_NumberOfBandColumns = 0;
+}
+
+template <class TInputImage, class TOutputImage>
+void
+VolumeToDepthMapFilter<TInputImage, TOutputImage>
+::BeginRegions()
+{
+  this->UpdateOutputInformation();
+  OutputImagePointer output = this->GetOutput();
+  output->SetRequestedRegionToLargestPossibleRegion();
+  output->SetBufferedRegion(output->GetLargestPossibleRegion());
+  output->Allocate();
+  this->BeforeThreadedGenerateData();
+}
+
+template <class TInputImage, class TOutputImage>
+void
+VolumeToDepthMapFilter<TInputImage, TOutputImage>
+::GenerateRegion(const OutputRegionType &outputRegion)
+{
+  this->DynamicThreadedGenerateData(outputRegion);
 }
 
 template <class TInputImage, class TOutputImage>
@@ -250,133 +435,502 @@ VolumeToDepthMapFilter<TInputImage, TOutputImage>
                       << InputImageDimension);
     }
 
+  if (m_PeakIndex.IsNotNull())
+    {
+    this->IndexGenerateData(outputRegionForThread);
+    }
+  else if (m_PlaneOperator.IsNotNull())
+    {
+    this->PlaneOperatorGenerateData(outputRegionForThread);
+    }
+  else if (m_Engine == 1 && m_Peak == 0 && m_Initialisation.IsNull() && m_ProjectionDimension != 0)
+    {
+    this->ArgMaxGenerateData(outputRegionForThread);
+    }
+  else if (m_Engine == 1)
+    {
+    this->PlaneSweepGenerateData(outputRegionForThread);
+    }
+  else if (m_Initialisation.IsNotNull())
+    {
+    this->BandGenerateData(outputRegionForThread);
+    }
+  else
+    {
+    this->ColumnGenerateData(outputRegionForThread);
+    }
+}
+
+template <class TInputImage, class TOutputImage>
+void 
+VolumeToDepthMapFilter<TInputImage, TOutputImage>
+::ColumnGenerateData(const OutputRegionType &outputRegionForThread)
+{
   // Use the output image to report the progress. 
   ProgressReporter progress(this, this->GetNumberOfWorkUnits(), outputRegionForThread.GetNumberOfPixels());
 
   // Get some values, to simplify future manipulation of input. 
   InputImagePointer input = InputImageType::New();
   input->Graft(this->GetInput());
-  InputRegionType inputRegion = input->GetLargestPossibleRegion();
-  InputSizeType inputSize = inputRegion.GetSize();
-  InputIndexType inputIndex = inputRegion.GetIndex();
+  InputSizeType inputSize = input->GetLargestPossibleRegion().GetSize();
 
   // Get some values, to simplify future manipulation of output. 
   OutputImagePointer output = OutputImageType::New();
   output->Graft(this->GetOutput());
-  OutputRegionType outputRegion = output->GetLargestPossibleRegion();
-  OutputSizeType outputSizeForThread = outputRegionForThread.GetSize();
-  OutputIndexType outputIndexForThread = outputRegionForThread.GetIndex();
-
-  // Manage initialisation map if provided.
-  OutputImagePointer initialisationMap = nullptr;
-  if (this->GetInitialisation())
-    {
-    initialisationMap = OutputImageType::New();
-    initialisationMap->Graft(this->GetInitialisation());
-    }
 
   // Compute the input region for this thread.
-  InputRegionType inputRegionForThread = inputRegion;
-  InputSizeType inputSizeForThread = inputSize;
-  InputIndexType inputIndexForThread = inputIndex;
-  if (static_cast<unsigned int>(InputImageDimension) == static_cast<unsigned int>(OutputImageDimension))
+  InputRegionType inputRegionForThread = this->GetInputRegionForThread(outputRegionForThread);
+  SizeValueType projectionSize = inputSize[m_ProjectionDimension];
+
+  // we define an iterator.
+  using InputIteratorType = ImageLinearConstIteratorWithIndex<InputImageType>;
+  InputIteratorType inputIte(input, inputRegionForThread);
+  inputIte.SetDirection(m_ProjectionDimension);
+  inputIte.GoToBegin();
+
+  PeakDetectorType detector(m_Peak, m_Tolerance);
+
+  // for each (x,y) coordinate of input.
+  while (!inputIte.IsAtEnd())
     {
+    // Get current index for both Input and Output.
+    OutputIndexType outputIndex;
+    outputIndex.Fill(0);
+    InputIndexType inputIndex = inputIte.GetIndex();
     for (size_t i = 0; i < InputImageDimension; i++)
       {
       if (i != m_ProjectionDimension)
         {
-        inputSizeForThread[i] = outputSizeForThread[i];
-        inputIndexForThread[i] = outputIndexForThread[i];
+        outputIndex[i] = inputIndex[i];
         }
       }
+
+    // Push the values of the column to the peak detector, until the depth is known.
+    PeakStateType state;
+    while (!inputIte.IsAtEndOfLine())
+      {
+      const InputIndexValueType depth = inputIte.GetIndex()[m_ProjectionDimension];
+      if (depth >= 0 && depth < static_cast<InputIndexValueType>(projectionSize) && !detector.Push(state, inputIte.Get(), depth))
+        {
+        break;
+        }
+      ++inputIte;
+      }
+
+    // Get peak depth position.
+    InputIndexValueType depthValue = detector.GetDepth(state);
+
+    // Set output index value with detected depth value.
+    output->SetPixel(outputIndex, static_cast<OutputPixelType>(depthValue));
+
+    // Update progress.
+    progress.CompletedPixel();
+
+    // Go to the next (x,y) coordinate.
+    inputIte.NextLine();
     }
-  else
+}
+
+template <class TInputImage, class TOutputImage>
+void 
+VolumeToDepthMapFilter<TInputImage, TOutputImage>
+::BandGenerateData(const OutputRegionType &outputRegionForThread)
+{
+  // Use the output image to report the progress. 
+  ProgressReporter progress(this, this->GetNumberOfWorkUnits(), outputRegionForThread.GetNumberOfPixels());
+
+  InputImageConstPointer input = this->GetInput();
+  OutputImagePointer output = this->GetOutput();
+  const InputIndexValueType projectionSize = input->GetLargestPossibleRegion().GetSize()[m_ProjectionDimension];
+
+  // Depth limits of the buffer along the projection dimension.
+  const InputRegionType bufferedRegion = input->GetBufferedRegion();
+  const InputIndexValueType firstDepth = std::max<InputIndexValueType>(bufferedRegion.GetIndex()[m_ProjectionDimension], 0);
+  const InputIndexValueType lastDepth = std::min<InputIndexValueType>(
+    bufferedRegion.GetIndex()[m_ProjectionDimension] + bufferedRegion.GetSize()[m_ProjectionDimension] - 1, projectionSize - 1);
+
+  // Walk the column directly in the buffer.
+  const InputPixelType *buffer = input->GetBufferPointer();
+  const OffsetValueType depthStride = input->GetOffsetTable()[m_ProjectionDimension];
+
+  PeakDetectorType detector(m_Peak, m_Tolerance);
+
+  // Depth range to search for each column, read from the initialisation map.
+  std::vector<InputIndexValueType> highDepthOfColumn;
+  std::vector<InputIndexValueType> lowDepthOfColumn;
+  this->GetInitialisationBand(outputRegionForThread, highDepthOfColumn, lowDepthOfColumn);
+
+  ImageRegionIteratorWithIndex<OutputImageType> outputIte(output, outputRegionForThread);
+  for (SizeValueType c = 0; !outputIte.IsAtEnd(); ++outputIte, ++c)
     {
+    // Define the depth range to process to search.
+    const InputIndexValueType highDepth = std::max(highDepthOfColumn[c], firstDepth);
+    const InputIndexValueType lowDepth = std::min(lowDepthOfColumn[c], lastDepth);
+
+    // Index of the first voxel of the band.
+    OutputIndexType outputIndex = outputIte.GetIndex();
+    InputIndexType inputIndex;
     for (size_t i = 0; i < OutputImageDimension; i++)
       {
       if (i != m_ProjectionDimension)
         {
-        inputSizeForThread[i] = outputSizeForThread[i];
-        inputIndexForThread[i] = outputIndexForThread[i];
+        inputIndex[i] = outputIndex[i];
         }
-      else
+      else if (static_cast<unsigned int>(InputImageDimension) != static_cast<unsigned int>(OutputImageDimension))
         {
-        inputSizeForThread[InputImageDimension - 1] = outputSizeForThread[i];
-        inputIndexForThread[InputImageDimension - 1] = outputIndexForThread[i];
+        inputIndex[InputImageDimension - 1] = outputIndex[i];
         }
       }
-      inputSizeForThread[m_ProjectionDimension] = inputSize[m_ProjectionDimension];
-      inputIndexForThread[m_ProjectionDimension] = inputIndex[m_ProjectionDimension];
+    inputIndex[m_ProjectionDimension] = highDepth;
+
+    // Push the values of the band to the peak detector, until the depth is known.
+    PeakStateType state;
+    const InputPixelType *value = buffer + input->ComputeOffset(inputIndex);
+    for (InputIndexValueType depth = highDepth; depth <= lowDepth; depth++, value += depthStride)
+      {
+      if (!detector.Push(state, *value, depth))
+        {
+        break;
+        }
+      }
+
+    // Get peak depth position.
+    InputIndexValueType depthValue = detector.GetDepth(state);
+    if (depthValue < 0)
+      {
+      depthValue = highDepth;
+      }
+    outputIte.Set(static_cast<OutputPixelType>(depthValue));
+
+    // Update progress.
+    progress.CompletedPixel();
     }
-  inputRegionForThread.SetSize(inputSizeForThread);
-  inputRegionForThread.SetIndex(inputIndexForThread);
-  SizeValueType projectionSize = inputSize[m_ProjectionDimension];
+}
 
-  // we define an iterator.
-  using InputIteratorType = ImageLinearConstIteratorWithIndex<InputImageType>;
-  InputIteratorType inputIte(input, inputRegionForThread);
-  inputIte.SetDirection(m_ProjectionDimension);
+template <class TInputImage, class TOutputImage>
+void 
+VolumeToDepthMapFilter<TInputImage, TOutputImage>
+::ArgMaxGenerateData(const OutputRegionType &outputRegionForThread)
+{
+  // Use the output image to report the progress. 
+  ProgressReporter progress(this, this->GetNumberOfWorkUnits(), outputRegionForThread.GetNumberOfPixels());
+
+  InputImageConstPointer input = this->GetInput();
+  OutputImagePointer output = this->GetOutput();
+  InputRegionType inputRegionForThread = this->GetInputRegionForThread(outputRegionForThread);
+  const InputIndexValueType projectionSize = input->GetLargestPossibleRegion().GetSize()[m_ProjectionDimension];
+  const InputIndexValueType firstDepth = std::max<InputIndexValueType>(inputRegionForThread.GetIndex()[m_ProjectionDimension], 0);
+  const SizeValueType lineLength = inputRegionForThread.GetSize()[0];
+  const InputPixelType *buffer = input->GetBufferPointer();
+
+  // Columns are numbered in the memory order of the output region.
+  OutputSizeType outputSizeForThread = outputRegionForThread.GetSize();
+  OutputIndexType outputIndexForThread = outputRegionForThread.GetIndex();
+  OffsetValueType columnStride[OutputImageDimension];
+  columnStride[0] = 1;
+  for (size_t i = 1; i < OutputImageDimension; i++)
+    {
+    columnStride[i] = columnStride[i - 1] * static_cast<OffsetValueType>(outputSizeForThread[i - 1]);
+    }
+  const SizeValueType numberOfColumns = outputRegionForThread.GetNumberOfPixels();
+
+  // Running maximum value and depth of each column.
+  std::vector<InputPixelType> maxValue(numberOfColumns);
+  std::vector<DepthMapArgMax::DepthType> maxDepth(numberOfColumns, -1);
+
+  // Each scanline is a row of adjacent columns at the same depth.
+  ImageScanlineConstIterator<InputImageType> inputIte(input, inputRegionForThread);
   inputIte.GoToBegin();
+  while (!inputIte.IsAtEnd())
+    {
+    InputIndexType inputIndex = inputIte.GetIndex();
+    const InputIndexValueType depth = inputIndex[m_ProjectionDimension];
+    if (depth >= firstDepth && depth <= projectionSize - 1)
+      {
+      OffsetValueType column = 0;
+      for (size_t i = 0; i < OutputImageDimension; i++)
+        {
+        OffsetValueType index = 0;
+        if (i != m_ProjectionDimension)
+          {
+          index = inputIndex[i];
+          }
+        else if (static_cast<unsigned int>(InputImageDimension) != static_cast<unsigned int>(OutputImageDimension))
+          {
+          index = inputIndex[InputImageDimension - 1];
+          }
+        else
+          {
+          continue;
+          }
+        column += (index - outputIndexForThread[i]) * columnStride[i];
+        }
 
-  // for each (x,y) coordinate of input.
+      const InputPixelType *row = buffer + input->ComputeOffset(inputIndex);
+      if (depth == firstDepth)
+        {
+        std::copy(row, row + lineLength, maxValue.begin() + column);
+        std::fill(maxDepth.begin() + column, maxDepth.begin() + column + lineLength, static_cast<DepthMapArgMax::DepthType>(depth));
+        }
+      else
+        {
+        DepthMapArgMax::Update(row, &maxValue[column], &maxDepth[column], depth, lineLength);
+        }
+      }
+    inputIte.NextLine();
+    }
+
+  // Write the detected depth of each column.
+  ImageRegionIterator<OutputImageType> outputIte(output, outputRegionForThread);
+  for (SizeValueType c = 0; !outputIte.IsAtEnd(); ++outputIte, ++c)
+    {
+    outputIte.Set(static_cast<OutputPixelType>(maxDepth[c]));
+    progress.CompletedPixel();
+    }
+}
+
+template <class TInputImage, class TOutputImage>
+void 
+VolumeToDepthMapFilter<TInputImage, TOutputImage>
+::PlaneSweepGenerateData(const OutputRegionType &outputRegionForThread)
+{
+  // Use the output image to report the progress. 
+  ProgressReporter progress(this, this->GetNumberOfWorkUnits(), outputRegionForThread.GetNumberOfPixels());
+
+  InputImageConstPointer input = this->GetInput();
+  OutputImagePointer output = this->GetOutput();
+  InputRegionType inputRegionForThread = this->GetInputRegionForThread(outputRegionForThread);
+  const InputIndexValueType projectionSize = input->GetLargestPossibleRegion().GetSize()[m_ProjectionDimension];
+
+  // Columns are numbered in the memory order of the output region.
+  OutputSizeType outputSizeForThread = outputRegionForThread.GetSize();
+  OutputIndexType outputIndexForThread = outputRegionForThread.GetIndex();
+  OffsetValueType columnStride[OutputImageDimension];
+  columnStride[0] = 1;
+  for (size_t i = 1; i < OutputImageDimension; i++)
+    {
+    columnStride[i] = columnStride[i - 1] * static_cast<OffsetValueType>(outputSizeForThread[i - 1]);
+    }
+  const SizeValueType numberOfColumns = outputRegionForThread.GetNumberOfPixels();
+
+  // Define the depth range to search for each column.
+  std::vector<InputIndexValueType> highDepth(numberOfColumns, 0);
+  std::vector<InputIndexValueType> lowDepth(numberOfColumns, projectionSize - 1);
+  if (m_Initialisation.IsNotNull())
+    {
+    this->GetInitialisationBand(outputRegionForThread, highDepth, lowDepth);
+    }
+
+  // Running peak detection state of each column.
+  PeakDetectorType detector(m_Peak, m_Tolerance);
+  std::vector<PeakStateType> state(numberOfColumns);
+  SizeValueType numberOfDoneColumns = 0;
+  auto update = [&](SizeValueType c, const InputPixelType value, InputIndexValueType depth)
+    {
+    if (depth >= highDepth[c] && depth <= lowDepth[c] && !state[c].done && !detector.Push(state[c], value, depth))
+      {
+      numberOfDoneColumns++;
+      }
+    };
+
+  // Stream the input in memory order, one scanline at a time.
+  ImageScanlineConstIterator<InputImageType> inputIte(input, inputRegionForThread);
+  inputIte.GoToBegin();
   while (!inputIte.IsAtEnd())
     {
-    // Get current index for both Input and Output.
-    OutputIndexType outputIndex;
-    outputIndex.Fill(0);
+    // Find the column and depth of the first voxel of the line.
     InputIndexType inputIndex = inputIte.GetIndex();
-    for (size_t i = 0; i < InputImageDimension; i++)
+    OffsetValueType column = 0;
+    for (size_t i = 0; i < OutputImageDimension; i++)
       {
+      OffsetValueType index = 0;
       if (i != m_ProjectionDimension)
         {
-        outputIndex[i] = inputIndex[i];
+        index = inputIndex[i];
         }
+      else if (static_cast<unsigned int>(InputImageDimension) != static_cast<unsigned int>(OutputImageDimension))
+        {
+        index = inputIndex[InputImageDimension - 1];
+        }
+      else
+        {
+        continue;
+        }
+      column += (index - outputIndexForThread[i]) * columnStride[i];
       }
+    InputIndexValueType depth = inputIndex[m_ProjectionDimension];
 
-    // Define the depth range to process to search. 
-    unsigned int highDepth;
-    unsigned int lowDepth;
-    if (initialisationMap.IsNotNull())
+    // Along the line, either the column or the depth moves.
+    if (m_ProjectionDimension != 0)
       {
-      int previousDepth = static_cast<int>(initialisationMap->GetPixel(outputIndex));
-      highDepth = static_cast<int>(previousDepth - m_Range[0]);
-      highDepth = std::max<int>(highDepth, 0);
-      highDepth = std::min<int>(highDepth, projectionSize - 1);
-      lowDepth = static_cast<int>(previousDepth + m_Range[1]);
-      lowDepth = std::max<int>(lowDepth, 0);
-      lowDepth = std::min<int>(lowDepth, projectionSize - 1);
+      while (!inputIte.IsAtEndOfLine())
+        {
+        update(column++, inputIte.Get(), depth);
+        ++inputIte;
+        }
       }
     else
       {
-      highDepth = 0;
-      lowDepth = projectionSize - 1;
+      while (!inputIte.IsAtEndOfLine())
+        {
+        update(column, inputIte.Get(), depth++);
+        ++inputIte;
+        }
       }
 
-    // Accumulate the values and corresponding depth in vectors.
-    std::vector<InputPixelType> valueList;
-    std::vector<InputIndexValueType> depthList;
-    while (!inputIte.IsAtEndOfLine())
+    // Stop as soon as the depth of every column is known.
+    if (numberOfDoneColumns == numberOfColumns)
+      {
+      break;
+      }
+    inputIte.NextLine();
+    }
+
+  // Write the detected depth of each column.
+  ImageRegionIterator<OutputImageType> outputIte(output, outputRegionForThread);
+  for (SizeValueType c = 0; !outputIte.IsAtEnd(); ++outputIte, ++c)
+    {
+    outputIte.Set(static_cast<OutputPixelType>(detector.GetDepth(state[c])));
+    progress.CompletedPixel();
+    }
+}
+
+template <class TInputImage, class TOutputImage>
+void 
+VolumeToDepthMapFilter<TInputImage, TOutputImage>
+::PlaneOperatorGenerateData(const OutputRegionType &outputRegionForThread)
+{
+  // Use the output image to report the progress. 
+  ProgressReporter progress(this, this->GetNumberOfWorkUnits(), outputRegionForThread.GetNumberOfPixels());
+
+  InputImageConstPointer input = this->GetInput();
+  OutputImagePointer output = this->GetOutput();
+  InputRegionType inputRegionForThread = this->GetInputRegionForThread(outputRegionForThread);
+  const InputIndexValueType projectionSize = input->GetLargestPossibleRegion().GetSize()[m_ProjectionDimension];
+
+  // Columns are numbered in the memory order of the output region.
+  OutputSizeType outputSizeForThread = outputRegionForThread.GetSize();
+  OutputIndexType outputIndexForThread = outputRegionForThread.GetIndex();
+  OffsetValueType columnStride[OutputImageDimension];
+  columnStride[0] = 1;
+  for (size_t i = 1; i < OutputImageDimension; i++)
+    {
+    columnStride[i] = columnStride[i - 1] * static_cast<OffsetValueType>(outputSizeForThread[i - 1]);
+    }
+  const SizeValueType numberOfColumns = outputRegionForThread.GetNumberOfPixels();
+
+  // Column of each pixel of a plane, the plane being in the memory order of the input.
+  InputRegionType planeRegion = inputRegionForThread;
+  planeRegion.SetSize(m_ProjectionDimension, 1);
+  std::vector<SizeValueType> columnOfPixel(numberOfColumns);
+  ImageRegionConstIteratorWithIndex<InputImageType> planeIte(input, planeRegion);
+  for (SizeValueType p = 0; !planeIte.IsAtEnd(); ++planeIte, ++p)
+    {
+    InputIndexType inputIndex = planeIte.GetIndex();
+    OffsetValueType column = 0;
+    for (size_t i = 0; i < OutputImageDimension; i++)
       {
-      if (inputIte.GetIndex()[m_ProjectionDimension] >= highDepth &&
-          inputIte.GetIndex()[m_ProjectionDimension] <= lowDepth)
+      OffsetValueType index = 0;
+      if (i != m_ProjectionDimension)
         {
-        valueList.push_back(inputIte.Get());
-        depthList.push_back(inputIte.GetIndex()[m_ProjectionDimension]);
+        index = inputIndex[i];
         }
-      ++inputIte;
+      else if (static_cast<unsigned int>(InputImageDimension) != static_cast<unsigned int>(OutputImageDimension))
+        {
+        index = inputIndex[InputImageDimension - 1];
+        }
+      else
+        {
+        continue;
+        }
+      column += (index - outputIndexForThread[i]) * columnStride[i];
       }
+    columnOfPixel[p] = column;
+    }
 
-    // Get peak depth position.
-    InputIndexValueType depthValue = GetPeak(valueList, depthList);
+  // Define the depth range to search for each column, and the planes to read.
+  std::vector<InputIndexValueType> highDepth(numberOfColumns, 0);
+  std::vector<InputIndexValueType> lowDepth(numberOfColumns, projectionSize - 1);
+  if (m_Initialisation.IsNotNull())
+    {
+    this->GetInitialisationBand(outputRegionForThread, highDepth, lowDepth);
+    }
+  InputIndexValueType firstDepth = std::max<InputIndexValueType>(inputRegionForThread.GetIndex()[m_ProjectionDimension], 0);
+  InputIndexValueType lastDepth = std::min<InputIndexValueType>(
+    inputRegionForThread.GetIndex()[m_ProjectionDimension] + inputRegionForThread.GetSize()[m_ProjectionDimension] - 1,
+    projectionSize - 1);
+  if (numberOfColumns > 0)
+    {
+    firstDepth = std::max(firstDepth, *std::min_element(highDepth.begin(), highDepth.end()));
+    lastDepth = std::min(lastDepth, *std::max_element(lowDepth.begin(), lowDepth.end()));
+    }
 
-    // Set output index value with detected depth value.
-    output->SetPixel(outputIndex, static_cast<OutputPixelType>(depthValue));
+  // Transform the planes one at a time, and push their values to the running
+  // peak detection state of each column.
+  PlanePeakDetectorType detector(m_Peak, m_Tolerance);
+  std::vector<PlanePeakStateType> state(numberOfColumns);
+  std::vector<PlaneValueType> values(numberOfColumns);
+  typename PlaneOperatorType::WorkspaceType workspace;
+  SizeValueType numberOfDoneColumns = 0;
+  for (InputIndexValueType depth = firstDepth; depth <= lastDepth && numberOfDoneColumns < numberOfColumns; depth++)
+    {
+    planeRegion.SetIndex(m_ProjectionDimension, depth);
+    m_PlaneOperator->Apply(input, planeRegion, m_ProjectionDimension, values.data(), workspace);
+    for (SizeValueType p = 0; p < numberOfColumns; p++)
+      {
+      const SizeValueType c = columnOfPixel[p];
+      if (depth >= highDepth[c] && depth <= lowDepth[c] && !state[c].done && !detector.Push(state[c], values[p], depth))
+        {
+        numberOfDoneColumns++;
+        }
+      }
+    }
 
-    // Update progress.
+  // Write the detected depth of each column.
+  ImageRegionIterator<OutputImageType> outputIte(output, outputRegionForThread);
+  for (SizeValueType c = 0; !outputIte.IsAtEnd(); ++outputIte, ++c)
+    {
+    InputIndexValueType depthValue = detector.GetDepth(state[c]);
+    if (depthValue < 0)
+      {
+      depthValue = highDepth[c];
+      }
+    outputIte.Set(static_cast<OutputPixelType>(depthValue));
     progress.CompletedPixel();
+    }
+}
 
-    // Go to the next (x,y) coordinate.
-    inputIte.NextLine();
+template <class TInputImage, class TOutputImage>
+void
+VolumeToDepthMapFilter<TInputImage, TOutputImage>
+::IndexGenerateData(const OutputRegionType &outputRegionForThread)
+{
+  // Use the output image to report the progress. 
+  ProgressReporter progress(this, this->GetNumberOfWorkUnits(), outputRegionForThread.GetNumberOfPixels());
+
+  OutputImagePointer output = this->GetOutput();
+
+  // Replay the peak candidates of each whole column.
+  typename PeakIndexType::PeakDetectorType detector(m_Peak, m_Tolerance);
+  ImageRegionIteratorWithIndex<OutputImageType> outputIte(output, outputRegionForThread);
+  for (; !outputIte.IsAtEnd(); ++outputIte)
+    {
+    const OutputIndexType outputIndex = outputIte.GetIndex();
+    InputIndexType inputIndex = m_PeakIndex->GetRegion().GetIndex();
+    for (size_t i = 0; i < OutputImageDimension; i++)
+      {
+      if (i != m_ProjectionDimension)
+        {
+        inputIndex[i] = outputIndex[i];
+        }
+      else if (static_cast<unsigned int>(InputImageDimension) != static_cast<unsigned int>(OutputImageDimension))
+        {
+        inputIndex[InputImageDimension - 1] = outputIndex[i];
+        }
+      }
+    const InputIndexValueType depthValue = m_PeakIndex->GetDepth(m_PeakIndex->GetColumn(inputIndex), detector);
+    outputIte.Set(static_cast<OutputPixelType>(depthValue));
+    progress.CompletedPixel();
     }
 }
 
@@ -0,0 +1,69 @@
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "itkDepthMapArgMax.h"
+
+using namespace itk::DepthMapArgMax;
+
+// Compare every supported instruction set with std::max_element along each column
+// of a random volume, with ties, for row lengths that exercise the vector tails.
+template <class TPixel>
+unsigned long CompareInstructionSets(std::mt19937 &generator, unsigned int levels)
+{
+  unsigned long mismatch = 0;
+  const InstructionSetType supported = GetSupportedInstructionSet();
+  for (size_t n = 1; n <= 70; n++)
+    {
+    const DepthType depthSize = 1 + generator() % 40;
+    std::vector<TPixel> volume(n * depthSize);
+    for (auto &value : volume)
+      {
+      value = static_cast<TPixel>(65000 - generator() % levels);
+      }
+
+    // Reference depth of each column.
+    std::vector<DepthType> reference(n);
+    for (size_t c = 0; c < n; c++)
+      {
+      std::vector<TPixel> column(depthSize);
+      for (DepthType z = 0; z < depthSize; z++)
+        {
+        column[z] = volume[z * n + c];
+        }
+      reference[c] = std::max_element(column.begin(), column.end()) - column.begin();
+      }
+
+    for (int isa = Scalar; isa <= supported; isa++)
+      {
+      std::vector<TPixel> maxValue(volume.begin(), volume.begin() + n);
+      std::vector<DepthType> maxDepth(n, 0);
+      for (DepthType z = 1; z < depthSize; z++)
+        {
+        Update(&volume[z * n], maxValue.data(), maxDepth.data(), z, n, static_cast<InstructionSetType>(isa));
+        }
+      if (maxDepth != reference)
+        {
+        std::cerr << "Mismatch for instruction set " << isa << " and row length " << n << std::endl;
+        mismatch++;
+        }
+      }
+    }
+  return mismatch;
+}
+
+int main()
+{
+  std::mt19937 generator(42);
+  std::cout << "Supported instruction set: " << GetSupportedInstructionSet() << std::endl;
+
+  unsigned long mismatch = 0;
+  mismatch += CompareInstructionSets<float>(generator, 16);
+  mismatch += CompareInstructionSets<unsigned short>(generator, 16);
+  mismatch += CompareInstructionSets<unsigned char>(generator, 16);
+
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,117 @@
+
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+#include "itkDepthMapPeakDetector.h"
+
+// Reference peak detection, rewinding the column each time a peak or a valley is confirmed.
+template <class TPixel>
+long ReferencePeak(const std::vector<TPixel> &A, unsigned int peak, float tolerance)
+{
+  long result = -1;
+  if (peak > 0)
+    {
+    int mx_pos = 0;
+    int mn_pos = 0;
+    float mx = A[0];
+    float mn = A[0];
+    bool emi_first = true;
+    std::vector<long> peakList;
+    for (size_t i = 1; i < A.size(); i++)
+      {
+      if (A[i] > mx)
+        {
+        mx_pos = i;
+        mx = A[i];
+        }
+      if (A[i] < mn)
+        {
+        mn_pos = i;
+        mn = A[i];
+        }
+      if (emi_first && A[i] < mx - tolerance)
+        {
+        peakList.push_back(mx_pos);
+        emi_first = false;
+        i = mx_pos - 1;
+        mn = A[mx_pos];
+        mn_pos = mx_pos;
+        }
+      else if ((!emi_first) && A[i] > mn + tolerance)
+        {
+        emi_first = true;
+        i = mn_pos - 1;
+        mx = A[mn_pos];
+        mx_pos = mn_pos;
+        }
+      }
+    if (!peakList.empty())
+      {
+      if (peak == 1)
+        {
+        result = peakList.front();
+        }
+      else if (peak == 2)
+        {
+        result = peakList.back();
+        }
+      }
+    }
+  if (peak == 0 || result == -1)
+    {
+    result = std::max_element(A.begin(), A.end()) - A.begin();
+    }
+  return result;
+}
+
+// Compare the single pass detector with the reference on random noisy columns.
+template <class TPixel>
+unsigned long CompareDetector(std::mt19937 &generator, unsigned int levels, float maxTolerance)
+{
+  using DetectorType = itk::DepthMapPeakDetector<TPixel>;
+  std::uniform_real_distribution<float> toleranceDistribution(0, maxTolerance);
+  unsigned long mismatch = 0;
+  for (size_t t = 0; t < 20000; t++)
+    {
+    std::vector<TPixel> column(1 + generator() % 60);
+    for (auto &value : column)
+      {
+      value = static_cast<TPixel>(generator() % levels);
+      }
+    for (unsigned int peak = 0; peak <= 3; peak++)
+      {
+      const float tolerance = std::floor(toleranceDistribution(generator));
+      DetectorType detector(peak, tolerance);
+      typename DetectorType::State state;
+      for (size_t i = 0; i < column.size(); i++)
+        {
+        if (!detector.Push(state, column[i], i))
+          {
+          break;
+          }
+        }
+      if (detector.GetDepth(state) != ReferencePeak(column, peak, tolerance))
+        {
+        mismatch++;
+        }
+      }
+    }
+  return mismatch;
+}
+
+int main()
+{
+  std::mt19937 generator(42);
+
+  unsigned long mismatch = 0;
+  mismatch += CompareDetector<unsigned char>(generator, 256, 30);
+  mismatch += CompareDetector<unsigned short>(generator, 16, 4);
+  mismatch += CompareDetector<float>(generator, 1000, 100);
+
+  std::cout << "Mismatching columns: " << mismatch << std::endl;
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
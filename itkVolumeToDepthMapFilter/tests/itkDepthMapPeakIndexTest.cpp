@@ -0,0 +1,157 @@
+
+#include <sstream>
+#include <string>
+
+#include "itkImageFileReader.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkVolumeToDepthMapFilter.h"
+#include "itkDepthMapPeakIndex.h"
+#include "itkDepthMapPlaneVariance.h"
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+    {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " InputImage [MinimumTolerance | VarianceRadius]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  using VolumeType = itk::Image<unsigned char, 3>;
+  using MapType = itk::Image<float, 2>;
+  using VolumeReaderType = itk::ImageFileReader<VolumeType>;
+  using FilterType = itk::VolumeToDepthMapFilter<VolumeType, MapType>;
+  using PeakIndexType = FilterType::PeakIndexType;
+  using PlaneVarianceType = itk::DepthMapPlaneVariance<VolumeType>;
+
+  VolumeReaderType::Pointer reader = VolumeReaderType::New();
+  reader->SetFileName(argv[1]);
+  try
+    {
+    reader->Update();
+    }
+  catch (itk::ExceptionObject &excp)
+    {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+    }
+  VolumeType::Pointer volume = reader->GetOutput();
+
+  float minimumTolerance = 0;
+  if (argc >= 3)
+    {
+    minimumTolerance = std::atof(argv[2]);
+    }
+  PlaneVarianceType::Pointer planeVariance = nullptr;
+  if (argc >= 4 && std::atoi(argv[3]) > 0)
+    {
+    PlaneVarianceType::SizeType radius;
+    radius.Fill(std::atoi(argv[3]));
+    radius[2] = 0;
+    planeVariance = PlaneVarianceType::New();
+    planeVariance->SetRadius(radius);
+    }
+
+  // Index of the volume, restored from its serialisation.
+  PeakIndexType::Pointer peakIndex = PeakIndexType::New();
+  std::string serialisation;
+  try
+    {
+    PeakIndexType::Pointer builtIndex = PeakIndexType::New();
+    builtIndex->SetMinimumTolerance(minimumTolerance);
+    builtIndex->Build(volume, 2, planeVariance.GetPointer(), 4);
+    std::stringstream stream;
+    builtIndex->Write(stream);
+    serialisation = stream.str();
+    peakIndex->Read(stream);
+    }
+  catch (itk::ExceptionObject &excp)
+    {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Serialisations with decreasing offsets, or a depth beyond the columns, are
+  // rejected. The offsets, depths and values end the stream.
+  const size_t numberOfCandidates = peakIndex->GetNumberOfCandidates();
+  using CandidateDepthType = PeakIndexType::CandidateDepthType;
+  const size_t depthsPosition =
+    serialisation.size() - numberOfCandidates * (sizeof(PeakIndexType::ValueType) + sizeof(CandidateDepthType));
+  const size_t numberOfColumns = volume->GetLargestPossibleRegion().GetNumberOfPixels() /
+                                 volume->GetLargestPossibleRegion().GetSize(2);
+  const size_t offsetsPosition = depthsPosition - (numberOfColumns + 1) * sizeof(uint64_t);
+  if (numberOfCandidates > 0)
+    {
+    std::string decreasingOffsets = serialisation;
+    const uint64_t offset = numberOfCandidates + 1;
+    decreasingOffsets.replace(offsetsPosition + sizeof(uint64_t), sizeof(offset),
+                              reinterpret_cast<const char *>(&offset), sizeof(offset));
+    std::string outOfColumn = serialisation;
+    const CandidateDepthType depth = static_cast<CandidateDepthType>(volume->GetLargestPossibleRegion().GetSize(2));
+    outOfColumn.replace(depthsPosition, sizeof(depth), reinterpret_cast<const char *>(&depth), sizeof(depth));
+    for (const std::string &corrupted : {decreasingOffsets, outOfColumn})
+      {
+      std::stringstream stream(corrupted);
+      PeakIndexType::Pointer corruptedIndex = PeakIndexType::New();
+      try
+        {
+        corruptedIndex->Read(stream);
+        std::cerr << "A corrupted peak index has been read." << std::endl;
+        return EXIT_FAILURE;
+        }
+      catch (itk::ExceptionObject &excp)
+        {
+        std::cout << "Rejected: " << excp.GetDescription() << std::endl;
+        }
+      }
+    }
+  std::cout << "Candidates: " << peakIndex->GetNumberOfCandidates() << " for "
+            << volume->GetLargestPossibleRegion().GetNumberOfPixels() << " voxels, "
+            << peakIndex->GetNumberOfBytes() << " bytes" << std::endl;
+
+  // The search of the index, on a volume without buffer, gives the map of the
+  // search of the voxels, for any peak mode and tolerance within the index.
+  unsigned long mismatch = 0;
+  for (unsigned int peak = 0; peak <= 2; peak++)
+    {
+    for (float tolerance : {0.0f, 5.0f, 25.0f})
+      {
+      FilterType::Pointer filter = FilterType::New();
+      filter->SetInput(volume);
+      filter->SetPeak(peak);
+      filter->SetTolerance(minimumTolerance + tolerance);
+      filter->SetPlaneOperator(planeVariance.GetPointer());
+
+      FilterType::Pointer indexFilter = FilterType::New();
+      indexFilter->SetInput(peakIndex->CreateVolumeInformation());
+      indexFilter->SetPeak(peak);
+      indexFilter->SetTolerance(minimumTolerance + tolerance);
+      indexFilter->SetPeakIndex(peakIndex);
+      try
+        {
+        filter->Update();
+        indexFilter->Update();
+        }
+      catch (itk::ExceptionObject &excp)
+        {
+        std::cerr << excp << std::endl;
+        return EXIT_FAILURE;
+        }
+
+      itk::ImageRegionConstIterator<MapType> mapIte(filter->GetOutput(), filter->GetOutput()->GetLargestPossibleRegion());
+      itk::ImageRegionConstIterator<MapType> indexIte(indexFilter->GetOutput(),
+                                                      indexFilter->GetOutput()->GetLargestPossibleRegion());
+      for (; !mapIte.IsAtEnd(); ++mapIte, ++indexIte)
+        {
+        if (mapIte.Get() != indexIte.Get())
+          {
+          mismatch++;
+          }
+        }
+      }
+    }
+
+  std::cout << "Mismatching pixels: " << mismatch << std::endl;
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,145 @@
+
+#include <algorithm>
+
+#include "itkImageFileReader.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkImageRegionIteratorWithIndex.h"
+#include "itkVolumeToDepthMapFilter.h"
+#include "itkDepthMapPlaneVariance.h"
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+    {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " InputImage [Radius | Peak | Tolerance | initialisation]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  using VolumeType = itk::Image<unsigned char, 3>;
+  using VarianceType = itk::Image<float, 3>;
+  using MapType = itk::Image<float, 2>;
+  using VolumeReaderType = itk::ImageFileReader<VolumeType>;
+  using FusedFilterType = itk::VolumeToDepthMapFilter<VolumeType, MapType>;
+  using ReferenceFilterType = itk::VolumeToDepthMapFilter<VarianceType, MapType>;
+  using PlaneVarianceType = itk::DepthMapPlaneVariance<VolumeType>;
+
+  VolumeReaderType::Pointer reader = VolumeReaderType::New();
+  reader->SetFileName(argv[1]);
+  try
+    {
+    reader->Update();
+    }
+  catch (itk::ExceptionObject &excp)
+    {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+    }
+  VolumeType::Pointer volume = reader->GetOutput();
+  const VolumeType::RegionType region = volume->GetLargestPossibleRegion();
+  const VolumeType::SizeType size = region.GetSize();
+
+  unsigned int radius = 3;
+  if (argc >= 3)
+    {
+    radius = std::atoi(argv[2]);
+    }
+
+  // Reference local variance volume, summing every neighbourhood of each plane,
+  // the plane being extended with its edge values.
+  VarianceType::Pointer variance = VarianceType::New();
+  variance->CopyInformation(volume);
+  variance->SetRegions(region);
+  variance->Allocate();
+  const long r = static_cast<long>(radius);
+  itk::ImageRegionIteratorWithIndex<VarianceType> varianceIte(variance, region);
+  for (; !varianceIte.IsAtEnd(); ++varianceIte)
+    {
+    const VarianceType::IndexType index = varianceIte.GetIndex();
+    double sum = 0;
+    double sumOfSquares = 0;
+    for (long y = index[1] - r; y <= index[1] + r; y++)
+      {
+      for (long x = index[0] - r; x <= index[0] + r; x++)
+        {
+        VolumeType::IndexType neighbour = index;
+        neighbour[0] = std::min(std::max(x, 0L), static_cast<long>(size[0]) - 1);
+        neighbour[1] = std::min(std::max(y, 0L), static_cast<long>(size[1]) - 1);
+        const double value = volume->GetPixel(neighbour);
+        sum += value;
+        sumOfSquares += value * value;
+        }
+      }
+    const double numberOfPixels = (2 * r + 1) * (2 * r + 1);
+    const double mean = sum / numberOfPixels;
+    varianceIte.Set(static_cast<float>(std::max(sumOfSquares / numberOfPixels - mean * mean, 0.0)));
+    }
+
+  MapType::Pointer Initialisation = nullptr;
+  if (argc >= 6 && std::atoi(argv[5]) == 1)
+    {
+    Initialisation = MapType::New();
+    MapType::RegionType mapRegion;
+    mapRegion.SetSize(0, size[0]);
+    mapRegion.SetSize(1, size[1]);
+    Initialisation->SetRegions(mapRegion);
+    Initialisation->Allocate();
+    Initialisation->FillBuffer(static_cast<float>(size[2] / 2));
+    }
+
+  // Depth map of the variance volume, and of the volume transformed plane by plane.
+  ReferenceFilterType::Pointer referenceFilter = ReferenceFilterType::New();
+  referenceFilter->SetInput(variance);
+  FusedFilterType::Pointer fusedFilter = FusedFilterType::New();
+  fusedFilter->SetInput(volume);
+  PlaneVarianceType::Pointer planeVariance = PlaneVarianceType::New();
+  PlaneVarianceType::SizeType kernel;
+  kernel.Fill(radius);
+  planeVariance->SetRadius(kernel);
+  fusedFilter->SetPlaneOperator(planeVariance.GetPointer());
+  if (argc >= 4)
+    {
+    referenceFilter->SetPeak(std::atoi(argv[3]));
+    fusedFilter->SetPeak(std::atoi(argv[3]));
+    }
+  if (argc >= 5)
+    {
+    referenceFilter->SetTolerance(std::atoi(argv[4]));
+    fusedFilter->SetTolerance(std::atoi(argv[4]));
+    }
+  if (Initialisation.IsNotNull())
+    {
+    ReferenceFilterType::ArrayType range;
+    range.Fill(5);
+    referenceFilter->SetRange(range);
+    referenceFilter->SetInitialisation(Initialisation);
+    fusedFilter->SetRange(range);
+    fusedFilter->SetInitialisation(Initialisation);
+    }
+  try
+    {
+    referenceFilter->Update();
+    fusedFilter->Update();
+    }
+  catch (itk::ExceptionObject &excp)
+    {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Both must give the same depth map.
+  itk::ImageRegionConstIterator<MapType> referenceIte(referenceFilter->GetOutput(), referenceFilter->GetOutput()->GetLargestPossibleRegion());
+  itk::ImageRegionConstIterator<MapType> testIte(fusedFilter->GetOutput(), fusedFilter->GetOutput()->GetLargestPossibleRegion());
+  unsigned long mismatch = 0;
+  for (; !referenceIte.IsAtEnd(); ++referenceIte, ++testIte)
+    {
+    if (referenceIte.Get() != testIte.Get())
+      {
+      mismatch++;
+      }
+    }
+
+  std::cout << "Mismatching pixels: " << mismatch << std::endl;
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
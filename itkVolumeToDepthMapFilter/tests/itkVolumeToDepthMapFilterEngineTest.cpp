@@ -0,0 +1,145 @@
+
+#include "itkImageFileReader.h"
+#include "itkImageRegionConstIterator.h"
+#include "itkVolumeToDepthMapFilter.h"
+
+template <class TPixel>
+int CompareEngines(int argc, char **argv)
+{
+  using PixelType = TPixel;
+  using VolumeType = itk::Image<PixelType, 3>;
+  using VolumeReaderType = itk::ImageFileReader<VolumeType>;
+  using VolumeToDepthMapFilterType = itk::VolumeToDepthMapFilter<VolumeType, VolumeType>;
+
+  typename VolumeReaderType::Pointer reader = VolumeReaderType::New();
+  reader->SetFileName(argv[1]);
+  try
+    {
+    reader->Update();
+    }
+  catch (itk::ExceptionObject &excp)
+    {
+    std::cerr << excp << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  unsigned int dimension = 2;
+  if (argc >= 3)
+    {
+    dimension = std::atoi(argv[2]);
+    }
+
+  // Initialisation 1 is a flat map of the output size. With initialisation 2,
+  // the tested engine gets the same map plus a fraction of plane, which the
+  // band centre truncates.
+  const unsigned int initialisationMode = argc >= 6 ? std::atoi(argv[5]) : 0;
+  typename VolumeType::Pointer Initialisation = nullptr;
+  typename VolumeType::Pointer FractionalInitialisation = nullptr;
+  if (initialisationMode == 1 || initialisationMode == 2)
+    {
+    Initialisation = VolumeType::New();
+    typename VolumeType::IndexType start = {{0, 0, 0}};
+    typename VolumeType::SizeType size = reader->GetOutput()->GetLargestPossibleRegion().GetSize();
+    PixelType value = static_cast<PixelType>(static_cast<unsigned int>(size[dimension] * 0.5));
+    size[dimension] = 1;
+    typename VolumeType::RegionType region;
+    region.SetSize(size);
+    region.SetIndex(start);
+    Initialisation->SetRegions(region);
+    Initialisation->Allocate();
+    Initialisation->FillBuffer(value);
+    FractionalInitialisation = Initialisation;
+    if (initialisationMode == 2)
+      {
+      FractionalInitialisation = VolumeType::New();
+      FractionalInitialisation->SetRegions(region);
+      FractionalInitialisation->Allocate();
+      FractionalInitialisation->FillBuffer(static_cast<PixelType>(value + 0.7));
+      }
+    }
+
+  unsigned int engine = 1;
+  if (argc >= 7)
+    {
+    engine = std::atoi(argv[6]);
+    }
+
+  // Compute the depth map with the reference column engine and the tested engine.
+  typename VolumeType::Pointer depthMaps[2];
+  const unsigned int engines[2] = {0, engine};
+  for (unsigned int e = 0; e < 2; e++)
+    {
+    typename VolumeToDepthMapFilterType::Pointer filter = VolumeToDepthMapFilterType::New();
+    filter->SetInput(reader->GetOutput());
+    filter->SetProjectionDimension(dimension);
+    filter->SetEngine(engines[e]);
+    if (argc >= 4)
+      {
+      filter->SetPeak(std::atoi(argv[3]));
+      }
+    if (argc >= 5)
+      {
+      filter->SetTolerance(std::atoi(argv[4]));
+      }
+    if (Initialisation.IsNotNull())
+      {
+      typename VolumeToDepthMapFilterType::ArrayType range;
+      range.Fill(5);
+      filter->SetRange(range);
+      filter->SetInitialisation(e == 0 ? Initialisation : FractionalInitialisation);
+      }
+    try
+      {
+      filter->Update();
+      }
+    catch (itk::ExceptionObject &excp)
+      {
+      std::cerr << excp << std::endl;
+      return EXIT_FAILURE;
+      }
+    depthMaps[e] = filter->GetOutput();
+    depthMaps[e]->DisconnectPipeline();
+    }
+
+  // Both engines must give the same depth map.
+  itk::ImageRegionConstIterator<VolumeType> referenceIte(depthMaps[0], depthMaps[0]->GetLargestPossibleRegion());
+  itk::ImageRegionConstIterator<VolumeType> testIte(depthMaps[1], depthMaps[1]->GetLargestPossibleRegion());
+  unsigned long mismatch = 0;
+  for (; !referenceIte.IsAtEnd(); ++referenceIte, ++testIte)
+    {
+    if (referenceIte.Get() != testIte.Get())
+      {
+      mismatch++;
+      }
+    }
+
+  std::cout << "Mismatching pixels: " << mismatch << std::endl;
+  return mismatch == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 2)
+    {
+    std::cerr << "Missing Parameters " << std::endl;
+    std::cerr << "Usage: " << argv[0];
+    std::cerr << " InputImage [Dimension | Peak | Tolerance | Initialisation | Engine | PixelType]" << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  // Pixel type of the volume, uchar (default), ushort or float.
+  std::string pixelType = "uchar";
+  if (argc >= 8)
+    {
+    pixelType = argv[7];
+    }
+  if (pixelType.compare("ushort") == 0)
+    {
+    return CompareEngines<unsigned short>(argc, argv);
+    }
+  else if (pixelType.compare("float") == 0)
+    {
+    return CompareEngines<float>(argc, argv);
+    }
+  return CompareEngines<unsigned char>(argc, argv);
+}
@@ -10,7 +10,7 @@ int main(int argc, char **argv)
     {
     std::cerr << "Missing Parameters " << std::endl;
     std::cerr << "Usage: " << argv[0];
-    std::cerr << " InputImage OutputImage [Dimension | Peak | Tolerance | initialisation | Workers]" << std::endl;
+    std::cerr << " InputImage OutputImage [Dimension | Peak | Tolerance | initialisation | Workers | Engine]" << std::endl;
     return EXIT_FAILURE;
     }
 
@@ -70,6 +70,10 @@ int main(int argc, char **argv)
     {
     filter->SetNumberOfWorkUnits(std::atoi(argv[7]));
     }
+  if (argc >= 9)
+    {
+    filter->SetEngine(std::atoi(argv[8]));
+    }
   try
     {
     filter->Update();